@@ -0,0 +1,110 @@
+#ifndef ACQUISITION_H
+#define ACQUISITION_H
+
+/*
+ * Acquisition - TX Master ESP32
+ *
+ * Everything between the radio and the log records: requests and reply
+ * matching, the poll cycles (one servant at a time, fan-out, sync beacon),
+ * streaming frames and servant liveness. Runs in the acquisition task on
+ * the target and in the simulation loop of the native build; hardware is
+ * reached only through hal.h.
+ *
+ * The application provides the settings and the three output hooks declared
+ * below (log records, display updates, connection state).
+ */
+
+#include <stdint.h>
+#include "config.h"
+#include "protocol.h"
+#include "rx_ring.h"
+#include "request_tracker.h"
+#include "liveness_tracker.h"
+#include "rtt_estimator.h"
+#include "peer_registry.h"
+
+typedef struct temp {
+    int count;                              // Sensors reported by the servant (0..MAX_SENSORS)
+    float sens[MAX_SENSORS];                // Degrees Celsius, -999.0 for sensor errors
+} temp;
+
+// One record per servant per cycle, passed from the acquisition task to the storage task
+typedef struct log_record {
+    uint32_t epoch;         // RTC time of the cycle, formatted by the storage task
+    int16_t millis;         // Sub-second part of epoch, -1 if only seconds are known
+    int servantID;
+    bool valid;             // false -> logged as the NAN sentinel row
+    temp data;
+    uint32_t journalSeq;    // Sample journal entry (sample_journal.h), released once on the card; 0 = none
+} log_record;
+
+// ===== SETTINGS (defined by the application, user variables in main.cpp) =====
+extern int sendTimeout;
+extern bool fanOutPolling;
+extern bool acceptLegacyReplies;
+extern bool streamingMode;
+extern int streamPeriodMs;
+extern bool syncSampling;
+extern volatile bool logState;
+
+// ===== OUTPUT (implemented by the application) =====
+void queueLogRecord(uint32_t epoch, int servantID, const temp *t, int millis = -1);
+void postTemp(int targetID, const temp &t, bool isConnected);
+void postConnections(const bool connections[]);
+
+// ===== STATE =====
+// Servant table, loaded once before acquisition starts and read-only afterwards
+extern PeerRegistry peers;
+
+// Receive ring: the radio callback only enqueues, the acquisition task drains it
+extern RxRing<RX_RING_SLOTS> rxRing;
+
+// Per-servant reply slots, matched by (sender MAC, seq); owned by the acquisition task (see drainRxRing)
+extern RequestTracker requestTracker;
+extern temp servantData[MAX_SERVANTS];
+extern uint32_t servantDataSeq[MAX_SERVANTS];
+extern uint32_t connectionReplySeq[MAX_SERVANTS];
+extern uint32_t servantRttUs[MAX_SERVANTS];
+extern RttEstimator rttEstimator;       // Reply timeouts per servant from the measured round trip times
+extern uint32_t unknownPackets;
+
+// Streaming mode statistics
+extern uint32_t streamFrames;
+extern uint32_t streamLostFrames;
+extern uint32_t streamDuplicateFrames;
+extern uint32_t streamStrayFrames;
+
+// Synchronized sampling: the beacon goes to the ESP-NOW broadcast address
+extern uint8_t syncBeaconAddress[6];
+extern uint32_t syncCycles;
+extern int32_t lastSyncSkewMs;
+extern uint32_t maxSyncSkewMs;
+
+// Connection state, read by the UI
+extern LivenessTracker liveness;
+extern volatile int numConnections;
+extern volatile bool acquisitionBusy;       // Set while a poll cycle is running
+extern volatile bool servantOnline[MAX_SERVANTS];
+
+// ===== RADIO CALLBACKS =====
+// Call from the hal_receive_cb / hal_sent_cb registered with halRadioSetCallbacks
+void acquisitionReceive(const uint8_t *mac, const uint8_t *data, int len);
+void acquisitionSent(const uint8_t *mac, bool delivered);
+
+// ===== ACQUISITION TASK =====
+int servantIndexFromMac(const uint8_t *mac_addr);
+
+// Returns the request's sequence number, or 0 if it couldn't be queued for sending
+uint32_t sendRequest(int servantIndex, int actionID, int replyActionID = 0, float value = 0);
+
+bool isStreaming();
+void sendLogState(bool logState);
+void drainRxRing();
+
+// One poll cycle in the configured mode (syncSampling, fanOutPolling or one servant at a time)
+void getAllTemps(bool save = true);
+
+// Passive liveness check, probes servants that went quiet
+void refreshConnections();
+
+#endif // ACQUISITION_H
@@ -0,0 +1,47 @@
+#ifndef BACKLOG_RING_H
+#define BACKLOG_RING_H
+
+/*
+ * Backlog Ring - TX Master ESP32
+ *
+ * Byte FIFO over a large block of memory (PSRAM on the target, see
+ * halAllocLarge). The SD logger parks log data here while the card is
+ * missing or busy and writes it out in bulk once the card takes data again.
+ * Data is accepted whole or not at all, so a full backlog drops complete
+ * records only.
+ *
+ * Not thread safe: the storage task is its only user.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+class BacklogRing {
+public:
+    BacklogRing();
+
+    // Use size bytes at memory; the ring starts empty
+    void begin(uint8_t *memory, size_t size);
+
+    // Queue len bytes at the end; false (nothing queued) if they don't fit
+    bool push(const uint8_t *data, size_t len);
+
+    // The oldest bytes that are contiguous in memory; returns their number (0 = empty)
+    size_t peek(const uint8_t **data) const;
+
+    // Remove len bytes from the front (at most used())
+    void pop(size_t len);
+
+    size_t used() const { return count; }
+    size_t capacity() const { return size; }
+    size_t peak() const { return highWater; }  // Highest fill level since begin()
+
+private:
+    uint8_t *memory;
+    size_t size;
+    size_t start;                           // Offset of the oldest byte
+    size_t count;
+    size_t highWater;
+};
+
+#endif // BACKLOG_RING_H
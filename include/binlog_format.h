@@ -0,0 +1,75 @@
+#ifndef BINLOG_FORMAT_H
+#define BINLOG_FORMAT_H
+
+/*
+ * Binary Log Format - TX Master ESP32
+ *
+ * Layout of /data_master.bin, written by the master when binaryLogging is
+ * enabled and read back by tools/binlog2csv. Plain C types only, so the
+ * header builds both for the ESP32 and for the host.
+ *
+ * File = one binlog_header followed by binlog_record entries, one per servant
+ * per cycle. All fields are little-endian. Readers must use headerSize and
+ * recordSize from the file header rather than the compiled sizes, so older
+ * decoders can skip fields added later.
+ *
+ * Version 2 (current): each record is the fixed binlog_record part
+ * (recordSize bytes) followed by its own sensorCount float readings, so
+ * servants with different probe counts share one file. header.sensorCount
+ * is the largest count a record may have.
+ *
+ * Version 1: fixed records of recordSize bytes with header.sensorCount float
+ * readings each (binlog_record_v1). Still read by tools/binlog2csv.
+ *
+ * The epoch counts seconds of the RTC clock as displayed (local time, the
+ * same wall clock as the CSV timestamp), not UTC.
+ */
+
+#include <stdint.h>
+
+#define BINLOG_MAGIC            "TXGB"      // Thermal GCT Binary
+#define BINLOG_VERSION          2
+#define BINLOG_MAX_SENSORS      32          // Largest sensorCount of a record (MAX_SENSORS of the protocol)
+#define BINLOG_V1_SENSOR_COUNT  9
+#define BINLOG_VALUE_FLOAT32    1           // Readings stored as IEEE-754 float in degrees Celsius
+
+// Record flags
+#define BINLOG_FLAG_NO_DATA     0x01        // Servant did not answer (CSV: 123456789,NAN sentinel row)
+#define BINLOG_FLAG_HAS_MILLIS  0x02        // millis is valid (synchronized sampling), CSV timestamp gets ".mmm"
+
+#pragma pack(push, 1)
+
+typedef struct binlog_header {
+    char magic[4];                          // BINLOG_MAGIC, not NUL terminated
+    uint16_t version;                       // BINLOG_VERSION
+    uint16_t headerSize;                    // sizeof(binlog_header) of the writer
+    uint16_t recordSize;                    // sizeof(binlog_record) of the writer
+    uint8_t sensorCount;                    // v2: max readings per record, v1: readings per record
+    uint8_t valueType;                      // BINLOG_VALUE_FLOAT32
+    uint32_t createdEpoch;                  // RTC time the file was created
+    char deviceId[16];                      // MASTER_DEVICE_ID, NUL padded
+    char firmware[8];                       // FIRMWARE_VERSION, NUL padded
+    uint8_t reserved[24];
+} binlog_header;                            // 64 bytes
+
+typedef struct binlog_record {
+    uint32_t epoch;                         // RTC seconds of the cycle
+    uint16_t millis;                        // Sub-second part, 0 if unknown
+    uint8_t servantID;                      // 1-based target number
+    uint8_t flags;                          // BINLOG_FLAG_*
+    uint8_t sensorCount;                    // Readings that follow, 0 if BINLOG_FLAG_NO_DATA
+    uint8_t reserved;
+    // sensorCount float readings follow (degrees Celsius, -999.0 for sensor errors)
+} binlog_record;                            // 10 bytes + 4 per reading
+
+typedef struct binlog_record_v1 {
+    uint32_t epoch;
+    uint16_t millis;
+    uint8_t servantID;
+    uint8_t flags;
+    float readings[BINLOG_V1_SENSOR_COUNT]; // Sensor 1..9, NAN if BINLOG_FLAG_NO_DATA
+} binlog_record_v1;                         // 44 bytes
+
+#pragma pack(pop)
+
+#endif // BINLOG_FORMAT_H
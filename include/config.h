@@ -16,32 +16,69 @@
 #define BUILD_DATE              __DATE__ " " __TIME__
 
 // ===== TIMING CONFIGURATION =====
-#define SEND_TIMEOUT_MS         1000        // Timeout for servant response
+#define SEND_TIMEOUT_MS         1000        // Longest wait for a servant response (adaptive below it, see rtt_estimator.h)
 #define LOG_INTERVAL_MS         10000       // Log interval (>=10000ms)
 #define PING_CHECK_INTERVAL_MS  1000        // Connection check interval
 #define TEMP_UPDATE_INTERVAL_MS 10000       // Temperature display update
+#define TIMEBASE_ANCHOR_MS      60000       // Re-anchor the ms timebase on an RTC second this often (see timebase.h)
+#define TIMEBASE_DRIFT_MIN_MS   600000      // Shortest baseline for measuring the timer's rate against the RTC
+#define TIMEBASE_SEARCH_GAP_US  20000       // Without SQW: max gap of the two RTC reads that bracket a second edge
 
 // ===== WIFI & NTP CONFIGURATION =====
-#define WIFI_SSID               "VodafoneMobileWiFi-A8E1"
+#define WIFI_SSID               "VodafoneMobileWiFi-A8E1"   // Access point joined for the time sync
 #define WIFI_PASSWORD           "I5IJ4ij4"
-#define NTP_SERVER              "pool.ntp.org"
-#define GMT_OFFSET_SEC          7200        // GMT+2 for Amsterdam summer time
-#define DAYLIGHT_OFFSET_SEC     0           // Already included in GMT offset
-#define WIFI_CONNECTION_TIMEOUT 20          // WiFi connection attempts
-#define NTP_SYNC_TIMEOUT        10          // NTP sync attempts
+#define NTP_SERVER              "time.google.com"   // Or the address of tools/ntp_responder (port: ntpPort in main.cpp)
+#define GMT_OFFSET_SEC          3600        // GMT+1 for Amsterdam (CET)
+#define DAYLIGHT_OFFSET_SEC     3600        // +1 hour for summer time (CEST)
+#define ESPNOW_CHANNEL          1           // WiFi channel of the ESP-NOW network; the radio returns here after a time sync
+#define NTP_SYNC_INTERVAL_MS    3600000     // Time sync period after a success (see time_sync.h)
+#define NTP_RETRY_MS            600000      // Next time sync after a failed one
+#define NTP_JOIN_TIMEOUT_MS     10000       // WiFi association for a time sync
+#define NTP_DNS_TIMEOUT_MS      5000        // NTP server name lookup
+#define NTP_REPLY_TIMEOUT_MS    1500        // Wait for one NTP reply
+#define NTP_REQUESTS            3           // NTP requests per time sync before it fails
 
 // ===== HARDWARE CONFIGURATION =====
 #define CS_PIN                  5           // SD Card Chip Select
 #define LED_PIN                 4           // Status LED
 #define BUTTON_PIN              0           // Button input
+#define RTC_SQW_PIN             -1          // DS3231 SQW/INT wired to a GPIO (e.g. 27) for 1 Hz second edges, -1 = not wired
+#define SD_SPI_FREQUENCY        20000000    // SD card SPI clock in Hz (library default is 4 MHz)
+#define SD_MOUNT_POINT          "/sd"       // VFS path of the card (SD library default)
 #define LCD_ADDRESS             0x27        // I2C LCD address
 #define LCD_COLS                20          // LCD columns
 #define LCD_ROWS                4           // LCD rows
+#define SERVANTS_PER_PAGE       4           // Servants shown at once on rows 1 and 2 (5 columns each)
+#define LCD_PAGE_INTERVAL_MS    4000        // Page flip period when more servants are registered
+#define LCD_FLUSH_INTERVAL_MS   100         // Min time between two LCD updates (changed cells only)
+
+// ===== TASK CONFIGURATION =====
+// Radio work runs alone on core 0 (next to the WiFi stack); SD and UI share core 1
+#define ACQ_TASK_CORE           0           // ESP-NOW acquisition task
+#define STORAGE_TASK_CORE       1           // SD card writer task
+#define UI_TASK_CORE            1           // LCD, LED and button task
+#define ACQ_TASK_PRIORITY       3
+#define STORAGE_TASK_PRIORITY   2
+#define UI_TASK_PRIORITY        1
+#define ACQ_TASK_STACK          8192        // Stack sizes in bytes
+#define STORAGE_TASK_STACK      8192
+#define UI_TASK_STACK           4096
+#define LOG_QUEUE_LENGTH        32          // Records buffered between acquisition and SD writer
+#define UI_QUEUE_LENGTH         16          // Pending display updates
+#define UI_REFRESH_MS           50          // Clock, LED and button refresh period
+#define UI_ERROR_HOLD_MS        10000       // An error screen stays up at least this long before the rows return
+#define RX_RING_SLOTS           32          // ESP-NOW receive ring slots (power of two, ~260 bytes each)
+#define CONSOLE_TASK_CORE       1           // Console task: formats and prints the queued console messages
+#define CONSOLE_TASK_PRIORITY   0           // Below every other task, Serial output only uses idle time
+#define CONSOLE_TASK_STACK      4096
+#define CONSOLE_SLOTS           64          // Queued console messages (power of two, ~200 bytes each, see console_log.h)
+#define CONSOLE_DRAIN_MS        20          // Console task period
 
 // ===== WATCHDOG CONFIGURATION =====
 #define WATCHDOG_TIMEOUT_SEC    30          // Watchdog timeout
 
 // ===== SERVANT ESP32 MAC ADDRESSES =====
+// Defaults, used only if neither PEER_FILENAME on the SD card nor the NVS copy holds a peer table.
 // Update these with your actual servant device MAC addresses
 #define SERVANT_1_MAC           {0x48, 0xE7, 0x29, 0x8C, 0x79, 0x68}
 #define SERVANT_2_MAC           {0x48, 0xE7, 0x29, 0x8C, 0x73, 0x18}
@@ -50,16 +87,62 @@
 
 // ===== FILE CONFIGURATION =====
 #define SD_FILENAME             "/data_master.csv"
+#define PEER_FILENAME           "/peers.txt"         // Servant MAC addresses, one per line (see peer_registry.h)
+#define PEER_FILE_MAX_SIZE      1024        // Bytes of PEER_FILENAME that are read
+#define PEER_NVS_NAMESPACE      "gct-peers" // NVS copy of the last peer table read from the SD card
 #define CSV_HEADER              "timestamp,target_no,sensor_no,temperature"
+#define BIN_FILENAME            "/data_master.bin"   // Used instead of SD_FILENAME when binaryLogging is on
+#define LOG_DIR                 "/log"      // Segment files when segmentedLogging is on (see log_segments.h)
+#define LOG_MANIFEST_FILENAME   "/log/manifest.csv"  // Segment list with time ranges and data lengths
+#define LOG_SEGMENT_SIZE        (16UL * 1024 * 1024) // Pre-allocated segment size; a new segment starts each day or when full
+#define SD_BUFFER_SIZE          4096        // Write buffer, multiple of the 512-byte SD block
+#define SD_SYNC_INTERVAL_MS     10000       // Max age of buffered data before it is synced to the card
+#define SD_RETRY_INTERVAL_MS    2000        // Min time between remount attempts after a card error
+#define SD_BACKLOG_SIZE         (2UL * 1024 * 1024) // PSRAM store-and-forward buffer while the card is missing or busy
+#define SD_BACKLOG_DRAIN_SIZE   32768       // Max backlog bytes written per storage task pass once the card is back
+#define SD_STATS_INTERVAL_MS    60000       // Write latency report interval on Serial
+#define METRICS_FILENAME        "/metrics.log"       // Periodic metrics dump (metricsLogMinutes in main.cpp)
+#define METRICS_TEXT_SIZE       4096        // Formatted metrics registry, see metrics.h
+#define JOURNAL_SIZE            4096        // Write-ahead journal in RTC memory, power of two (see sample_journal.h)
+#define JOURNAL_SYNC_PERCENT    75          // Sync the log early once the journal is this full
+#define JOURNAL_SYNC_MIN_MS     2000        // But not sooner than this after the last sync (see log_storage.h)
+#define LOG_DEADLINE_SLACK_MS   1000        // A log cycle starting later than this after its due time is a missed deadline
 
 // ===== ESP-NOW ACTION IDs =====
 #define ACTION_CONNECTION_TEST  1001
 #define ACTION_START_LOGGING    1002
 #define ACTION_STOP_LOGGING     1003
+#define ACTION_STREAM_START     1004        // Value: push period in ms
+#define ACTION_STREAM_STOP      1005
+#define ACTION_SYNC_BEACON      1006        // Broadcast, servants latch their sensors at beacon + delay
 #define ACTION_TEMP_REQUEST     3001
 #define ACTION_TEMP_RESPONSE    2001
+#define ACTION_STREAM_FRAME     2002        // Pushed by servants in streaming mode
+#define ACTION_SYNC_SAMPLE      2003        // Reply to 1006 with the latch time in ms
+
+// ===== PROTOCOL CONFIGURATION =====
+#define MAX_SERVANTS            19          // ESP-NOW peer limit (20) minus the sync beacon broadcast peer
+#define PROTOCOL_MAX_IN_FLIGHT  4           // Requests awaiting a reply per servant, oldest is dropped beyond this
+#define SYNC_SAMPLE_DELAY_MS    200         // Beacon to sensor latch; leaves servants time to finish radio work
+#define STREAM_MIN_PERIOD_MS    100         // Shortest push period the master asks servants for
+#define PROBE_AFTER_MS          3000        // Silence before a servant gets an explicit 1001 probe
+#define PROBE_INTERVAL_MS       1000        // Min time between two probes to the same servant
+#define LIVENESS_TIMEOUT_MS     7000        // Silence after which a servant counts as offline
+#define RTT_MIN_TIMEOUT_MS      50          // Shortest adaptive reply timeout (see rtt_estimator.h)
+#define RTT_GRANULARITY_MS      10          // Least margin of the reply timeout over the smoothed round trip time
+#define RTT_MAX_BACKOFF         4           // Timeout doublings after consecutive timeouts (sendTimeout caps them)
+#define RTT_REPORT_WINDOW_MS    20          // Longest wait for a frame's OnDataSent report, radio retries included
 
 // ===== DEBUG CONFIGURATION =====
+// Console messages below this level are compiled out (0 debug, 1 info, 2 warning, 3 error, see console_log.h)
+#ifndef CONSOLE_LEVEL
+    #ifdef DEBUG
+        #define CONSOLE_LEVEL   0
+    #else
+        #define CONSOLE_LEVEL   1
+    #endif
+#endif
+
 #ifdef DEBUG
     #define DEBUG_PRINT(x)      Serial.print(x)
     #define DEBUG_PRINTLN(x)    Serial.println(x)
@@ -0,0 +1,169 @@
+#ifndef CONSOLE_LOG_H
+#define CONSOLE_LOG_H
+
+/*
+ * Console Log - TX Master ESP32
+ *
+ * Leveled status messages for the Serial console that never block the
+ * caller. A CONSOLE_*() call stores the format string pointer and the
+ * arguments in binary form in a slot of a lock-free ring, which takes a few
+ * microseconds. Formatting and the slow Serial write happen later in the
+ * console task (drain()), at the lowest priority. Callbacks, the acquisition
+ * loop and the storage task therefore only enqueue.
+ *
+ * Levels are fixed at compile time (CONSOLE_LEVEL in config.h). Calls below
+ * it compile to nothing: their arguments are type-checked but not evaluated.
+ *
+ * The format must be a string literal; it is read when the message is
+ * drained. String arguments are copied, as far as they fit into the slot.
+ * When the ring is full, messages are dropped and counted, and the console
+ * says how many. Before setDirect(false), setup() and the native tools get
+ * each message printed at once, in order with their direct Serial output.
+ *
+ * Several producers (any task or callback) and one consumer; a bounded
+ * queue with a sequence number per slot.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include "config.h"
+
+#define CONSOLE_LEVEL_DEBUG     0
+#define CONSOLE_LEVEL_INFO      1
+#define CONSOLE_LEVEL_WARN      2
+#define CONSOLE_LEVEL_ERROR     3
+
+#define CONSOLE_MAX_ARGS        16
+#define CONSOLE_ARG_BYTES       160         // Binary arguments per message: 4 or 8 bytes per number, strings inline
+#define CONSOLE_LINE_SIZE       256         // Formatted message; longer ones are cut off
+
+typedef enum console_arg_type {
+    CONSOLE_ARG_INT,                        // 4 bytes
+    CONSOLE_ARG_UINT,                       // 4 bytes
+    CONSOLE_ARG_INT64,
+    CONSOLE_ARG_UINT64,
+    CONSOLE_ARG_DOUBLE,
+    CONSOLE_ARG_POINTER,                    // 8 bytes
+    CONSOLE_ARG_STRING                      // Length byte and the characters, no terminator
+} console_arg_type;
+
+typedef struct console_message {
+    uint32_t timeMs;                        // halMillis() of the call
+    const char *format;
+    uint8_t level;
+    uint8_t argCount;
+    uint8_t used;                           // Bytes of data
+    uint8_t types[CONSOLE_MAX_ARGS];        // console_arg_type per argument
+    uint8_t data[CONSOLE_ARG_BYTES];
+} console_message;
+
+typedef struct console_slot {
+    std::atomic<uint32_t> sequence;         // Position it can be written at, or that position + 1 once written
+    console_message message;
+} console_slot;
+
+class ConsoleLog {
+    static_assert(CONSOLE_SLOTS >= 2 && (CONSOLE_SLOTS & (CONSOLE_SLOTS - 1)) == 0,
+                  "CONSOLE_SLOTS must be a power of two");
+
+public:
+    ConsoleLog();
+
+    // Any task or callback
+    template <typename... Args>
+    void push(uint8_t level, const char *format, Args... args) {
+        console_message local;
+        uint32_t position = 0;
+        bool queued = !direct.load(std::memory_order_relaxed);
+        console_message *message = queued ? reserve(&position) : &local;
+        if (message == NULL) {
+            return;
+        }
+        begin(message, level, format);
+        int expand[] = {0, (add(message, args), 0)...};
+        (void)expand;
+        if (queued) {
+            publish(position);
+        } else {
+            print(*message);
+        }
+    }
+
+    // Console task: format and print up to max messages; returns how many were printed
+    size_t drain(size_t max = CONSOLE_SLOTS);
+
+    // false once the console task runs; until then messages are printed by the caller
+    void setDirect(bool direct) { this->direct.store(direct, std::memory_order_relaxed); }
+
+    size_t depth() const;
+    size_t maxDepth() const { return peakDepth.load(std::memory_order_relaxed); }
+    uint32_t dropped() const { return dropCount.load(std::memory_order_relaxed); }
+    uint32_t printed() const { return printCount; }
+
+    // Text of a message as drain() prints it, without the line end; returns its length
+    static size_t format(const console_message &message, char *out, size_t size);
+
+private:
+    console_message *reserve(uint32_t *position);
+    void publish(uint32_t position);
+    void print(const console_message &message);
+
+    static void begin(console_message *message, uint8_t level, const char *format);
+    static void addNumber(console_message *message, console_arg_type type, const void *value, size_t len);
+    static void add(console_message *message, int value) { addNumber(message, CONSOLE_ARG_INT, &value, 4); }
+    static void add(console_message *message, unsigned value) { addNumber(message, CONSOLE_ARG_UINT, &value, 4); }
+    static void add(console_message *message, long value) { add(message, (long long)value); }
+    static void add(console_message *message, unsigned long value) { add(message, (unsigned long long)value); }
+    static void add(console_message *message, long long value) { addNumber(message, CONSOLE_ARG_INT64, &value, 8); }
+    static void add(console_message *message, unsigned long long value) {
+        addNumber(message, CONSOLE_ARG_UINT64, &value, 8);
+    }
+    static void add(console_message *message, double value) { addNumber(message, CONSOLE_ARG_DOUBLE, &value, 8); }
+    static void add(console_message *message, const void *value) {
+        uint64_t address = (uintptr_t)value;
+        addNumber(message, CONSOLE_ARG_POINTER, &address, 8);
+    }
+    static void add(console_message *message, const char *value);
+    static void add(console_message *message, char *value) { add(message, (const char *)value); }
+
+    console_slot slots[CONSOLE_SLOTS];
+    std::atomic<uint32_t> head;             // Next position to reserve (producers)
+    std::atomic<uint32_t> tail;             // Next position to print (console task)
+    std::atomic<uint32_t> dropCount;
+    std::atomic<uint32_t> peakDepth;
+    std::atomic<bool> direct;
+    uint32_t reportedDrops;                 // Console task only
+    uint32_t printCount;
+};
+
+extern ConsoleLog consoleLog;
+
+// Never called: lets the compiler check the arguments against the format
+static inline void consoleFormatCheck(const char *format, ...) __attribute__((format(printf, 1, 2)));
+static inline void consoleFormatCheck(const char *format, ...) {
+    (void)format;
+}
+
+#define CONSOLE_AT(level, ...)  do { if (false) consoleFormatCheck(__VA_ARGS__); \
+                                     consoleLog.push(level, __VA_ARGS__); } while (0)
+#define CONSOLE_OFF(...)        do { if (false) consoleFormatCheck(__VA_ARGS__); } while (0)
+
+#if CONSOLE_LEVEL <= CONSOLE_LEVEL_DEBUG
+#define CONSOLE_DEBUG(...)      CONSOLE_AT(CONSOLE_LEVEL_DEBUG, __VA_ARGS__)
+#else
+#define CONSOLE_DEBUG(...)      CONSOLE_OFF(__VA_ARGS__)
+#endif
+#if CONSOLE_LEVEL <= CONSOLE_LEVEL_INFO
+#define CONSOLE_INFO(...)       CONSOLE_AT(CONSOLE_LEVEL_INFO, __VA_ARGS__)
+#else
+#define CONSOLE_INFO(...)       CONSOLE_OFF(__VA_ARGS__)
+#endif
+#if CONSOLE_LEVEL <= CONSOLE_LEVEL_WARN
+#define CONSOLE_WARN(...)       CONSOLE_AT(CONSOLE_LEVEL_WARN, __VA_ARGS__)
+#else
+#define CONSOLE_WARN(...)       CONSOLE_OFF(__VA_ARGS__)
+#endif
+#define CONSOLE_ERROR(...)      CONSOLE_AT(CONSOLE_LEVEL_ERROR, __VA_ARGS__)
+
+#endif // CONSOLE_LOG_H
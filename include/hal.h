@@ -0,0 +1,126 @@
+#ifndef HAL_H
+#define HAL_H
+
+/*
+ * Hardware Abstraction Layer - TX Master ESP32
+ *
+ * The few hardware services the acquisition and logging code needs: time,
+ * the RTC, the ESP-NOW radio, the network for the time sync, the LCD, the SD
+ * card and the console. The
+ * implementation is picked at link time, there is no runtime indirection:
+ *
+ *   src/hal_esp32.cpp          esp_timer, DS3231, esp_now, LiquidCrystal_I2C, SD (firmware builds)
+ *   src/native/hal_native.cpp  virtual clock, simulated servants, directory-backed SD and a
+ *                              text-buffer LCD (native build, see hal_native.h)
+ *
+ * Code using only this header, protocol.h and the portable modules builds
+ * for both. Setup-only and UI code in main.cpp keeps using the Arduino
+ * libraries directly (see hal_esp32.h).
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef ARDUINO
+#include <FS.h>
+#else
+#include <stdio.h>
+#endif
+
+// ===== TIME =====
+uint32_t halMillis();
+uint32_t halMicros();                       // Wraps after ~71 min
+void halDelay(uint32_t ms);                 // Yields to other tasks (the simulation advances its clock)
+uint64_t halUptimeUs();                     // Same timer as halMicros(), never wraps
+
+// ===== RTC =====
+// One I2C transfer each on the target: use the timebase (timebase.h) for timestamps
+uint32_t halRtcEpoch();                     // Wall-clock seconds (Unix time, no time zone)
+void halRtcSetEpoch(uint32_t epoch);        // Restarts the RTC's second at the call
+uint64_t halRtcEdgeUs();                    // halUptimeUs() of the latest RTC second edge, 0 without SQW
+
+// ===== RADIO (ESP-NOW) =====
+typedef void (*hal_receive_cb)(const uint8_t *mac, const uint8_t *data, int len);
+typedef void (*hal_sent_cb)(const uint8_t *mac, bool delivered);
+
+// Register the receive and send-status callbacks; both may run in another task than the sender
+void halRadioSetCallbacks(hal_receive_cb onReceive, hal_sent_cb onSent);
+
+// Queue one packet for mac (a registered peer or the broadcast address); false if it couldn't be queued
+bool halRadioSend(const uint8_t *mac, const uint8_t *data, size_t len);
+
+// Sleep until the receive callback delivered a packet, the radio reported a frame as not delivered
+// or timeoutMs passed; true if woken before the timeout. For the one task that consumes the received
+// packets (acquisition), may return early spuriously.
+bool halRadioWait(uint32_t timeoutMs);
+
+// ===== NETWORK (time sync) =====
+// Joining an access point takes the radio off ESPNOW_CHANNEL: from halNetConnect() until
+// halNetRestore() returned, the caller must not send over ESP-NOW. None of these calls waits
+// for the network; the results are polled.
+#define HAL_NET_PENDING         0
+#define HAL_NET_READY           1
+#define HAL_NET_FAILED          2
+
+void halNetConnect(const char *ssid, const char *password); // Start joining the access point
+int halNetStatus();                         // Of the connection
+void halNetResolve(const char *host);       // Start a DNS lookup; a dotted address resolves at once
+int halNetResolveStatus(uint32_t *ip);      // Of the lookup; ip in network byte order once ready
+bool halNetSendUdp(uint32_t ip, uint16_t port, const uint8_t *data, size_t len);
+size_t halNetReceiveUdp(uint8_t *data, size_t len);        // One datagram that arrived, 0 = none
+void halNetRestore();                       // Leave the access point, radio back on ESPNOW_CHANNEL
+
+// ===== LCD =====
+// Drawing only changes a shadow framebuffer (lcd_frame.h); halLcdFlush() sends the changed cells
+void halLcdWrite(uint8_t col, uint8_t row, const char *text);   // Clipped at the end of the row
+void halLcdWriteField(uint8_t col, uint8_t row, uint8_t width, const char *text);  // Padded to width
+void halLcdClear();
+void halLcdInvalidate();                    // Redraw every cell on the next flush
+void halLcdFlush(bool immediate = false);   // At most every LCD_FLUSH_INTERVAL_MS unless immediate
+
+// ===== SD CARD =====
+#define HAL_FILE_READ           0
+#define HAL_FILE_APPEND         1
+#define HAL_FILE_UPDATE         2           // Read and write at any position; creates the file, never truncates
+
+bool halStorageRemount();                   // Unmount and mount the card again after an error
+bool halFileExists(const char *path);
+bool halFileRename(const char *from, const char *to);
+bool halFileTruncate(const char *path, uint32_t size);     // The file must not be open
+bool halMakeDir(const char *path);          // true if the directory exists afterwards
+
+class HalFile {
+public:
+    HalFile();
+
+    bool open(const char *path, int mode);  // HAL_FILE_READ, HAL_FILE_APPEND or HAL_FILE_UPDATE
+    void close();
+    bool isOpen() const;
+
+    size_t read(uint8_t *data, size_t len);
+    size_t write(const uint8_t *data, size_t len);
+    void flush();                           // Data and directory entry reach the card
+    uint32_t size();
+    bool seek(uint32_t position);           // HAL_FILE_READ and HAL_FILE_UPDATE only
+    // Grow the file to length bytes now, so writes below length allocate no clusters later.
+    // The new space holds undefined data (old card content on the target).
+    bool preallocate(uint32_t length);
+
+private:
+#ifdef ARDUINO
+    fs::File file;
+#else
+    FILE *file;
+#endif
+};
+
+// ===== SYSTEM =====
+uint32_t halFreeHeap();                     // Bytes, 0 where the platform doesn't track it
+uint32_t halMinFreeHeap();                  // Lowest free heap since boot
+void *halAllocLarge(size_t size);           // Long-lived buffer in PSRAM, NULL if the board has none to spare
+
+// ===== CONSOLE =====
+void halPrintf(const char *format, ...) __attribute__((format(printf, 1, 2)));
+void halPrint(const char *text);            // Any length, for multi-line reports
+
+#endif // HAL_H
@@ -0,0 +1,30 @@
+#ifndef HAL_ESP32_H
+#define HAL_ESP32_H
+
+/*
+ * ESP32 Hardware Abstraction Layer - TX Master ESP32
+ *
+ * Firmware side of hal.h. The devices behind the portable HAL calls are
+ * also used directly by setup(), the time sync and the UI code in main.cpp;
+ * they are defined in src/hal_esp32.cpp and shared through this header.
+ */
+
+#include <RTClib.h>
+#include <LiquidCrystal_I2C.h>
+#include "hal.h"
+
+extern RTC_DS3231 rtc;
+extern LiquidCrystal_I2C lcd;
+
+// Create the I2C bus lock; call first in setup(), before any task starts
+void halBegin();
+
+// Route the DS3231's 1 Hz square wave to RTC_SQW_PIN (halRtcEdgeUs); after rtc.begin().
+// False if the pin is not configured; the timebase then brackets the edge with RTC reads.
+bool halRtcBeginSquareWave();
+
+// LCD and DS3231 share the I2C bus; every access after setup() goes through this lock
+void lockI2C();
+void unlockI2C();
+
+#endif // HAL_ESP32_H
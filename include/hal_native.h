@@ -0,0 +1,69 @@
+#ifndef HAL_NATIVE_H
+#define HAL_NATIVE_H
+
+/*
+ * Native Hardware Abstraction Layer - TX Master ESP32
+ *
+ * Host side of hal.h for the native build (pio run -e native). Nothing runs
+ * in real time: a virtual clock only moves in halDelay() and halRadioWait(),
+ * which deliver every simulated radio event that falls due on the way
+ * (halRadioWait() stops at the first packet for the master). That keeps runs
+ * deterministic for a given seed and lets hours of cycles finish in seconds.
+ *
+ *   Radio    simulated servants answering 1001, 3001, 1006 and streaming
+ *            (1004/1005), with configurable latency, jitter and loss; send
+ *            status reports in send order, failed for lost frames
+ *   SD card  a directory on the host (storageRoot + path)
+ *   RTC      startEpoch + virtual time, rtcDriftPpm fast, until the time sync sets
+ *            it; a 1 Hz square wave edge (halRtcEdgeUs) if rtcSquareWave is on
+ *   Network  an access point and an NTP server whose clock is ntpOffsetMs
+ *            ahead of the RTC, answering with ntp_packet.h (if network is on)
+ *   LCD      LCD_COLS x LCD_ROWS text buffer behind the same shadow frame as
+ *            the target, see halNativePrintLcd()
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include "hal.h"
+
+typedef struct hal_native_config {
+    int servants;                           // Simulated servants, MAC 02:00:00:00:00:01 and up
+    uint32_t latencyMs;                     // One-way latency of every packet
+    uint32_t jitterMs;                      // Extra latency, uniform 0..jitterMs per packet
+    uint32_t processingMs;                  // Servant time from a 3001 request to its reply (sensor read)
+    float lossPercent;                      // Chance that a packet is lost, each direction
+    int deadServants;                       // The last N servants are switched off: frames to them fail
+    int sensorCount;                        // Readings per servant: 9 = fixed floats, else a sensor_block
+    uint32_t startEpoch;                    // RTC time at simulated boot
+    uint32_t seed;                          // Random number seed (latency, loss, readings)
+    const char *storageRoot;                // Directory that stands in for the SD card
+    bool network;                           // Access point and NTP server in range
+    int32_t ntpOffsetMs;                    // NTP time minus RTC time at boot
+    int32_t rtcDriftPpm;                    // RTC rate minus timer rate
+    bool rtcSquareWave;                     // SQW wired: halRtcEdgeUs() reports the second edges
+} hal_native_config;
+
+typedef struct hal_native_stats {
+    uint32_t packetsToServants;
+    uint32_t packetsToMaster;
+    uint32_t packetsLost;
+    uint32_t streamFrames;                  // 2002 frames sent by the simulated servants
+    uint32_t lcdRuns;                       // Cursor moves sent to the display
+    uint32_t lcdCells;                      // Characters sent to the display
+    uint32_t ntpRequests;                   // Requests that reached the NTP server
+    uint32_t offChannelSends;               // ESP-NOW sends while the time sync had the radio (lost)
+} hal_native_stats;
+
+// Set up the simulated servants and reset the statistics; call before anything else.
+// Can be called again to change the setup, the virtual clock keeps running.
+void halNativeBegin(const hal_native_config &config);
+
+void halNativeServantMac(int index, uint8_t mac[6]);
+void halNativeSetQuiet(bool quiet);         // Swallow halPrintf output (the firmware's Serial log)
+void halNativeSetCardPresent(bool present); // Pull the simulated SD card (opens and writes fail) or insert it
+void halNativeLimitWrites(int64_t bytes);   // Writes fall short once the card took this many more bytes, -1 = no limit
+void halNativePrintLcd(FILE *out);
+uint64_t halNativeRtcUnixUs();              // Exact simulated RTC time, to check the timebase against
+const hal_native_stats &halNativeStats();
+
+#endif // HAL_NATIVE_H
@@ -0,0 +1,61 @@
+#ifndef LCD_FRAME_H
+#define LCD_FRAME_H
+
+/*
+ * LCD Frame - TX Master ESP32
+ *
+ * Shadow framebuffer for the character LCD. Drawing only changes the RAM
+ * copy of the screen; flush() compares it with what the display currently
+ * shows and sends just the changed cells, one cursor move per run of
+ * changes. Every cell written to a PCF8574 backpack costs a slow I2C
+ * transfer on the bus shared with the DS3231, so a clock that ticks one
+ * second rewrites one or two digits instead of the whole row.
+ *
+ * Fields are drawn at their full width (padded with spaces), so a shorter
+ * value can't leave digits of the previous one behind.
+ *
+ * Not thread safe: one task draws and flushes (the UI task after setup()).
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include "config.h"
+
+#define LCD_CHAR_TICK           '\x08'      // Custom character 0 (tick mark); CGRAM 0-7 repeat at 8-15
+
+// Sends len characters to the display at (col, row)
+typedef void (*lcd_run_writer)(uint8_t col, uint8_t row, const char *text, size_t len);
+
+typedef struct lcd_frame_stats {
+    uint32_t flushes;                       // flush() calls that sent anything
+    uint32_t runs;                          // Cursor moves
+    uint32_t cells;                         // Characters sent
+} lcd_frame_stats;
+
+class LcdFrame {
+public:
+    LcdFrame();
+
+    // Draw text at (col, row), clipped at the end of the row
+    void write(uint8_t col, uint8_t row, const char *text);
+    // Like write(), padded with spaces to width cells
+    void writeField(uint8_t col, uint8_t row, uint8_t width, const char *text);
+    void clear();
+
+    // The display content is unknown (after init or a glitch): the next flush redraws every cell
+    void invalidate();
+
+    bool dirty() const;
+    // Send the changed cells through writer; returns the number of characters sent
+    size_t flush(lcd_run_writer writer);
+
+    const char *row(uint8_t row) const { return frame[row]; }   // Drawn content, NUL-terminated
+    const lcd_frame_stats &stats() const { return statistics; }
+
+private:
+    char frame[LCD_ROWS][LCD_COLS + 1];     // What should be shown
+    char shown[LCD_ROWS][LCD_COLS];         // What the display shows, 0 = unknown
+    lcd_frame_stats statistics;
+};
+
+#endif // LCD_FRAME_H
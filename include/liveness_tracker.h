@@ -0,0 +1,45 @@
+#ifndef LIVENESS_TRACKER_H
+#define LIVENESS_TRACKER_H
+
+/*
+ * Liveness Tracker - TX Master ESP32
+ *
+ * Passive connection state per servant. Any valid packet received from a
+ * servant and any successful delivery reported by OnDataSent (the servant's
+ * radio acknowledged the frame) count as proof of life. Only a servant that
+ * stayed silent for PROBE_AFTER_MS needs an explicit 1001 probe, and
+ * it is shown offline after LIVENESS_TIMEOUT_MS without any sign of life.
+ *
+ * heard() and the probe functions are called from the acquisition task,
+ * delivered() from the WiFi task (OnDataSent).
+ */
+
+#include <stdint.h>
+#include <atomic>
+#include "config.h"
+
+class LivenessTracker {
+public:
+    LivenessTracker();
+
+    void heard(int servant, uint32_t nowMs);        // Valid packet received from the servant
+    void delivered(int servant, uint32_t nowMs);    // Frame to the servant was acknowledged
+
+    bool online(int servant, uint32_t nowMs) const;
+    uint32_t silenceMs(int servant, uint32_t nowMs) const;  // Time since the last sign of life
+
+    // True if the servant was silent long enough and wasn't probed within PROBE_INTERVAL_MS
+    bool needsProbe(int servant, uint32_t nowMs) const;
+    void probed(int servant, uint32_t nowMs);
+
+    uint32_t probes() const { return probeCount; }
+
+private:
+    std::atomic<uint32_t> lastSeenMs[MAX_SERVANTS];
+    std::atomic<bool> seen[MAX_SERVANTS];
+    uint32_t lastProbeMs[MAX_SERVANTS];
+    bool probedOnce[MAX_SERVANTS];
+    uint32_t probeCount;
+};
+
+#endif // LIVENESS_TRACKER_H
@@ -0,0 +1,78 @@
+#ifndef LOG_SEGMENTS_H
+#define LOG_SEGMENTS_H
+
+/*
+ * Log Segments - TX Master ESP32
+ *
+ * Splits the master log into segment files in LOG_DIR, one per day and
+ * LOG_SEGMENT_SIZE at most, named after the day they start:
+ *
+ *   /log/20250729-001.csv, /log/20250729-002.csv, /log/20250730-001.csv, ...
+ *
+ * Each segment is pre-allocated to LOG_SEGMENT_SIZE when it is opened
+ * (SdLogger capacity), so appends cost the same at the start and the end of
+ * a deployment, and one flight's data can be copied without the rest. Once a
+ * segment is finished, and whenever logging stops (closeLogFile), it is
+ * truncated to its data; a segment continued after a reboot is cut to its
+ * manifest length first.
+ *
+ * LOG_MANIFEST_FILENAME lists the segments, one fixed-width row each, so the
+ * row of the open segment is rewritten in place after every log sync:
+ *
+ *   segment,file,first_epoch,last_epoch,bytes
+ *   0001,/log/20250729-001.csv,1753799415,1753802995,0000184320
+ *
+ * first_epoch and last_epoch are the RTC times of the first and last record
+ * (0 = none yet). bytes is the data length at the last sync: the open
+ * segment is longer on the card, the space after bytes is unused.
+ *
+ * Storage task only.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include "config.h"
+
+#define LOG_SEGMENT_PATH_SIZE   (sizeof(LOG_DIR) + 17)  // "/log/20250729-001.csv" and terminator
+
+typedef struct log_segment {
+    uint16_t number;                        // Row in the manifest, 1 = first
+    char path[LOG_SEGMENT_PATH_SIZE];
+    uint32_t firstEpoch;
+    uint32_t lastEpoch;
+    uint32_t bytes;                         // Data length at the last manifest update
+} log_segment;
+
+class LogSegments {
+public:
+    LogSegments();
+
+    // Read the manifest (creating LOG_DIR and the manifest if needed). The last listed
+    // segment becomes the current one if its file still exists. extension is ".csv" or ".bin".
+    bool begin(const char *extension);
+
+    bool hasCurrent() const { return current.number > 0; }
+    const log_segment &segment() const { return current; }
+
+    // A record of len bytes at epoch belongs in a new segment: another day than the
+    // segment's first record, or it doesn't fit into LOG_SEGMENT_SIZE after length bytes
+    bool needsNew(uint32_t epoch, uint32_t length, size_t len) const;
+
+    // Name a new segment for the records from epoch on and append its row to the manifest
+    bool add(uint32_t epoch);
+
+    // Extend the current segment's time range (written with the next update)
+    void noteRecord(uint32_t epoch);
+
+    // Rewrite the current segment's manifest row with its synced data length
+    bool update(uint32_t bytes);
+
+private:
+    bool writeRow();                        // Current segment's row; re-lists it if the manifest lost rows
+
+    char extension[5];
+    log_segment current;                    // number 0 = none
+    uint16_t rows;                          // Complete rows in the manifest
+};
+
+#endif // LOG_SEGMENTS_H
@@ -0,0 +1,58 @@
+#ifndef LOG_STORAGE_H
+#define LOG_STORAGE_H
+
+/*
+ * Log Storage - TX Master ESP32
+ *
+ * Turns log records into CSV rows or binary records (binlog_format.h) and
+ * hands them to the SdLogger, either into one log file or into day/size
+ * segments (log_segments.h). Used by the storage task on the target and by
+ * the simulation loop of the native build.
+ */
+
+#include <stdint.h>
+#include "acquisition.h"
+#include "sd_logger.h"
+#include "log_segments.h"
+#include "sample_journal.h"
+
+extern SdLogger sdLogger;                   // Persistent, block-buffered log file writer (storage task only)
+extern volatile bool storageError;          // Set while the SD card can't be written
+extern LogSegments logSegments;             // Segment manifest, see openSegmentedLog
+extern SampleJournal sampleJournal;         // Records not yet synced to the card (sample_journal.h)
+
+// Open path as CSV or binary log, writing the matching header if the file is new.
+// A binary log of another format version is renamed aside first (see retireOldBinaryLog).
+bool openLogFile(const char *path, bool binary, uint32_t createdEpoch);
+
+// Log into pre-allocated segments in LOG_DIR instead: continues the last segment of the
+// manifest, or starts one for createdEpoch. Later segments start as the records require.
+bool openSegmentedLog(bool binary, uint32_t createdEpoch);
+
+void writeLogRecord(const log_record &record);
+
+// Let the logger sync its tail (SD_SYNC_INTERVAL_MS, or earlier once the journal is
+// JOURNAL_SYNC_PERCENT full and JOURNAL_SYNC_MIN_MS have passed), record the synced
+// length in the manifest and release the synced records from the journal
+void pollLogFile();
+
+// The same, syncing now
+bool syncLogFile();
+
+// Logging stopped: sync, close the log file and cut a pre-allocated segment to its data, so a
+// card pulled now holds no stale bytes after the last row. The next record opens it again.
+// False while the data can't be written yet (card missing, backlog not written out); call again.
+bool closeLogFile();
+
+// Boot, after the log file is open and before acquisition starts: write the records the
+// journal kept through the reset. Returns their number.
+uint32_t replayLogJournal();
+void printStorageStats();
+
+// Append the metrics registry (metrics.h) under a timestamp line to METRICS_FILENAME
+bool writeMetricsLog(uint32_t epoch);
+
+// Implemented by the application: show a storage error to the user
+void reportError(const char *errorMessage, int errorNr);
+
+#endif // LOG_STORAGE_H
@@ -0,0 +1,88 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+/*
+ * Metrics - TX Master ESP32
+ *
+ * Always-on performance counters for field diagnosis. An update is one
+ * relaxed atomic add (histograms: plus a count-leading-zeros and a compare),
+ * so the registry stays enabled in release builds. Every metric has a single
+ * writer task; the readers (the "metrics" serial command and the periodic
+ * METRICS_FILENAME dump) may see a histogram in the middle of an update,
+ * which is good enough for statistics.
+ *
+ * Histograms have power-of-two buckets: bucket 0 counts zeros, bucket i the
+ * values from 2^(i-1) to 2^i - 1. Percentiles are reported as the upper bound
+ * of their bucket ("p95<=2047"), so they are at most a factor 2 high.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include "config.h"
+
+#define METRICS_BUCKETS         24          // Up to 2^23 - 1 (8.4 s in us), larger values land in the last bucket
+
+class Counter {
+public:
+    Counter() : value(0) {}
+
+    void add(uint32_t n = 1) { value.fetch_add(n, std::memory_order_relaxed); }
+    uint32_t get() const { return value.load(std::memory_order_relaxed); }
+    void reset() { value.store(0, std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint32_t> value;
+};
+
+class Histogram {
+public:
+    Histogram();
+
+    void record(uint32_t value);
+    void reset();
+
+    uint32_t count() const { return samples.load(std::memory_order_relaxed); }
+    uint32_t maximum() const { return largest.load(std::memory_order_relaxed); }
+    uint32_t percentile(uint32_t percent) const;    // Upper bound of the bucket holding the percentile
+
+    // "n=120 p50<=1023 p95<=4095 p99<=4095 max=3120", or "n=0"
+    size_t format(char *out, size_t size) const;
+
+private:
+    std::atomic<uint32_t> buckets[METRICS_BUCKETS];
+    std::atomic<uint32_t> samples;
+    std::atomic<uint32_t> largest;
+};
+
+typedef struct metrics_registry {
+    // Acquisition task
+    Histogram rttUs[MAX_SERVANTS];          // Request sent to reply received, minus the sync latch delay
+    Counter timeouts[MAX_SERVANTS];         // Data requests without a reply within their timeout
+    Counter fastFails[MAX_SERVANTS];        // Data requests given up at once because they weren't delivered
+    Counter latePackets[MAX_SERVANTS];      // Replies to requests that were already given up
+    Counter sendErrors;                     // Frames the radio refused to queue
+    Histogram loopUs;                       // One acquisition task iteration, without its idle delay
+    Histogram logLatenessMs;                // Start of a log cycle after its due time
+    Counter missedDeadlines;                // Log cycles more than LOG_DEADLINE_SLACK_MS late
+    Counter droppedLogRecords;              // Log queue full, record lost
+
+    // WiFi task (send status callback)
+    Counter sendDelivered;                  // Frames acknowledged by the servant's radio
+    Counter sendFailed;                     // Frames without acknowledgement
+
+    // Storage task
+    Histogram sdWriteUs;                    // Block writes of the SD logger
+    Counter journalReplayed;                // Records written again from the sample journal at boot
+} metrics_registry;
+
+extern metrics_registry metrics;
+
+// Clear the registry (the request tracker, RX ring and SD logger keep their own totals)
+void resetMetrics();
+
+// The registry plus the related totals of the other modules as "name value ..." lines;
+// returns the length, cut at size - 1 (METRICS_TEXT_SIZE fits MAX_SERVANTS servants)
+size_t formatMetrics(char *out, size_t size);
+
+#endif // METRICS_H
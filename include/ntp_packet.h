@@ -0,0 +1,54 @@
+#ifndef NTP_PACKET_H
+#define NTP_PACKET_H
+
+/*
+ * NTP Packet - TX Master ESP32
+ *
+ * The 48-byte SNTP packet (RFC 4330) as the master's time sync sends and
+ * reads it, and as tools/ntp_responder answers it. Plain C types only, so
+ * the header builds both for the ESP32 and for the host.
+ *
+ * All fields are big-endian on the wire. Timestamps count seconds since
+ * 1900-01-01 UTC plus 1/2^32 fractions; ntpToUnixMs() reads the era after
+ * 2036 too (seconds below 2^31 are taken as era 1).
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define NTP_PORT                123
+#define NTP_PACKET_SIZE         48
+#define NTP_UNIX_OFFSET         2208988800UL    // Seconds from 1900-01-01 to 1970-01-01
+#define NTP_VERSION             4
+#define NTP_MODE_CLIENT         3
+#define NTP_MODE_SERVER         4
+#define NTP_LEAP_UNSYNCED       3           // Leap indicator of a server without time
+
+typedef struct ntp_timestamp {
+    uint32_t seconds;                       // Since 1900-01-01 UTC
+    uint32_t fraction;                      // 1/2^32 s
+} ntp_timestamp;
+
+typedef struct ntp_reply {
+    uint8_t stratum;                        // 1 = reference clock, 2.. = synchronised to one
+    ntp_timestamp receive;                  // Request arrived at the server
+    ntp_timestamp transmit;                 // Reply left the server
+} ntp_reply;
+
+ntp_timestamp ntpFromUnixMs(uint64_t unixMs);
+uint64_t ntpToUnixMs(ntp_timestamp timestamp);
+
+// Client request; transmit comes back as the reply's origin timestamp
+void ntpBuildRequest(uint8_t packet[NTP_PACKET_SIZE], ntp_timestamp transmit);
+
+// Server side: read a client request and build the reply to it
+bool ntpParseRequest(const uint8_t *packet, size_t len, ntp_timestamp *transmit);
+void ntpBuildReply(uint8_t packet[NTP_PACKET_SIZE], ntp_timestamp origin, ntp_timestamp receive,
+                   ntp_timestamp transmit, uint8_t stratum);
+
+// Check a reply against the request it answers (origin) and read its timestamps. False for
+// anything else: wrong mode, a server without time (leap 3, stratum 0 "kiss-o'-death")
+// or a reply to another request.
+bool ntpParseReply(const uint8_t *packet, size_t len, ntp_timestamp origin, ntp_reply *reply);
+
+#endif // NTP_PACKET_H
@@ -0,0 +1,50 @@
+#ifndef PEER_REGISTRY_H
+#define PEER_REGISTRY_H
+
+/*
+ * Peer Registry - TX Master ESP32
+ *
+ * Runtime table of servant MAC addresses. The master loads it at boot from
+ * the SD card (PEER_FILENAME), from the copy kept in NVS, or from the
+ * SERVANT_n_MAC defaults in config.h, in that order. A servant's number
+ * (S1, S2, ... on the LCD and in the log) is its position in the table.
+ *
+ * Text format, one servant per line, '#' starts a comment:
+ *
+ *   # GCT grid, north field
+ *   48:E7:29:8C:79:68
+ *   48-E7-29-8C-73-18   # '-' works as separator too
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include "config.h"
+
+#define PEER_MAC_TEXT_SIZE      18          // "AA:BB:CC:DD:EE:FF" + terminator
+
+class PeerRegistry {
+public:
+    PeerRegistry();
+
+    void clear();
+    bool add(const uint8_t mac[6]);                     // false if the table is full or mac is already listed
+    int count() const { return entries; }
+    const uint8_t *mac(int index) const { return macs[index]; }
+    int indexOf(const uint8_t *mac) const;              // -1 for unknown senders
+
+    // Replace the table with the servants listed in text; returns the number of entries,
+    // or -1 if a line isn't a valid MAC address (the table is left empty then)
+    int loadFromText(const char *text, size_t len);
+
+    // Write the table in the text format above; returns the length, 0 if size is too small
+    size_t toText(char *out, size_t size) const;
+
+private:
+    uint8_t macs[MAX_SERVANTS][6];
+    int entries;
+};
+
+bool parseMac(const char *text, size_t len, uint8_t mac[6]);
+void formatMac(const uint8_t mac[6], char *out);      // out needs PEER_MAC_TEXT_SIZE bytes
+
+#endif // PEER_REGISTRY_H
@@ -0,0 +1,227 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+/*
+ * ESP-NOW Protocol - TX Master ESP32
+ *
+ * Packet layout shared by master and servants (see doc/Action_IDs.txt).
+ *
+ * Version 2 puts a small header in front of every packet. The action ID stays
+ * the first field, exactly where protocol v1 had it, so v1 servants still
+ * recognise requests. A servant answering a v2 request copies the request's
+ * header into its reply (with its own action ID), which lets the master match
+ * the reply to the request by (MAC, seq). v1 replies carry no header; the
+ * master can still accept them by MAC alone (PROTOCOL_ACCEPT_LEGACY).
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define PROTOCOL_MAGIC          0x4754      // "TG" in little-endian byte order
+#define PROTOCOL_VERSION        2
+
+// Header flags
+#define PACKET_FLAG_SENSOR_BLOCK 0x01       // Readings are a sensor_block instead of 9 floats
+
+// Sensor readings in 2001/2002/2003 replies. Without PACKET_FLAG_SENSOR_BLOCK (and in
+// protocol v1) they are 9 floats. With the flag they are a sensor_block: a count and an
+// encoding, followed by count values, so a servant can report up to MAX_SENSORS probes.
+#define MAX_SENSORS             32          // Sensors per servant (32 x int16 fits any reply easily)
+#define LEGACY_SENSOR_COUNT     9           // Fixed float layout of v1 and flag-less v2 replies
+#define SENSOR_ENCODING_FLOAT32 1           // float, degrees Celsius
+#define SENSOR_ENCODING_CENTI   2           // int16, hundredths of a degree Celsius
+#define SENSOR_CENTI_INVALID    INT16_MIN   // Sensor error in SENSOR_ENCODING_CENTI
+#define SENSOR_VALUE_INVALID    -999.0f     // Decoded value of a sensor error
+
+#pragma pack(push, 1)
+
+typedef struct packet_header {
+    int32_t actionID;                       // Action ID, first field as in protocol v1
+    uint16_t magic;                         // PROTOCOL_MAGIC
+    uint8_t version;                        // PROTOCOL_VERSION
+    uint8_t flags;                          // PACKET_FLAG_*
+    uint32_t seq;                           // Request sequence number, echoed by the reply
+} packet_header;                            // 12 bytes
+
+// Master -> servant (1001, 1002, 1003, 1004, 1005, 3001)
+typedef struct request_packet {
+    packet_header header;
+    float value;                            // Action specific argument
+} request_packet;                           // 16 bytes
+
+// Start of the readings when PACKET_FLAG_SENSOR_BLOCK is set
+typedef struct sensor_block {
+    uint8_t sensorCount;                    // 0..MAX_SENSORS
+    uint8_t encoding;                       // SENSOR_ENCODING_*
+    // sensorCount values follow (4 bytes each for FLOAT32, 2 for CENTI)
+} sensor_block;
+
+// Servant -> master reply to 3001: header (actionID 2001, seq of the 3001 request) + readings.
+// Fixed layout without PACKET_FLAG_SENSOR_BLOCK:
+typedef struct temp_reply_packet {
+    packet_header header;
+    float sens[LEGACY_SENSOR_COUNT];        // Sensor 1..9 in degrees Celsius, -999.0 for sensor errors
+} temp_reply_packet;                        // 48 bytes; with a CENTI sensor_block: 14 + 2 per sensor
+
+// Servant -> master in streaming mode: same layout with actionID 2002, where
+// header.seq is the servant's own frame counter (starting at 1) instead of a request seq
+typedef temp_reply_packet stream_frame_packet;
+
+// Master -> all servants (ESP-NOW broadcast): latch the sensors sampleDelayMs after receiving this
+typedef struct sync_beacon_packet {
+    packet_header header;                   // actionID 1006, seq identifies the sampling instant
+    uint32_t epoch;                         // Master RTC time when the beacon was sent
+    uint16_t epochMs;                       // Sub-second part from the master's timebase (timebase.h)
+    uint16_t sampleDelayMs;                 // Delay from beacon reception to the sensor latch
+} sync_beacon_packet;                       // 20 bytes
+
+// Servant -> master reply to 1006: header (actionID 2003, seq of the beacon) + latch time + readings
+typedef struct sync_sample_time {
+    uint32_t sampleEpoch;                   // Servant time of the latch (beacon time + measured delay)
+    uint16_t sampleMs;                      // Sub-second part of the latch time
+    uint16_t latchDelayMs;                  // Measured delay from beacon reception to the latch
+} sync_sample_time;                         // 8 bytes
+
+typedef struct sync_sample_packet {
+    packet_header header;
+    sync_sample_time time;
+    float sens[LEGACY_SENSOR_COUNT];        // Fixed layout without PACKET_FLAG_SENSOR_BLOCK
+} sync_sample_packet;                       // 56 bytes
+
+#pragma pack(pop)
+
+// Result of parsing the start of a received packet
+typedef struct packet_info {
+    int32_t actionID;
+    uint32_t seq;                           // 0 for v1 packets
+    uint8_t flags;                          // PACKET_FLAG_*, 0 for v1 packets
+    bool legacy;                            // true if the packet has no v2 header
+    const uint8_t *payload;                 // Data after the header (v2) or after the action ID (v1)
+    size_t payloadLen;
+} packet_info;
+
+
+inline void buildRequest(request_packet *packet, int32_t actionID, uint32_t seq, float value) {
+    packet->header.actionID = actionID;
+    packet->header.magic = PROTOCOL_MAGIC;
+    packet->header.version = PROTOCOL_VERSION;
+    packet->header.flags = 0;
+    packet->header.seq = seq;
+    packet->value = value;
+}
+
+
+inline void buildSyncBeacon(sync_beacon_packet *packet, uint32_t seq, uint32_t epoch, uint16_t epochMs,
+                            uint16_t sampleDelayMs) {
+    packet->header.actionID = 1006;
+    packet->header.magic = PROTOCOL_MAGIC;
+    packet->header.version = PROTOCOL_VERSION;
+    packet->header.flags = 0;
+    packet->header.seq = seq;
+    packet->epoch = epoch;
+    packet->epochMs = epochMs;
+    packet->sampleDelayMs = sampleDelayMs;
+}
+
+
+inline bool parsePacket(const uint8_t *data, size_t len, packet_info *info) {
+    if (len < sizeof(int32_t)) {
+        return false;
+    }
+    memcpy(&info->actionID, data, sizeof(int32_t));
+
+    packet_header header;
+    if (len >= sizeof(header)) {
+        memcpy(&header, data, sizeof(header));
+        if (header.magic == PROTOCOL_MAGIC && header.version == PROTOCOL_VERSION) {
+            info->seq = header.seq;
+            info->flags = header.flags;
+            info->legacy = false;
+            info->payload = data + sizeof(header);
+            info->payloadLen = len - sizeof(header);
+            return true;
+        }
+    }
+
+    // Protocol v1: bare action ID followed by the payload
+    info->seq = 0;
+    info->flags = 0;
+    info->legacy = true;
+    info->payload = data + sizeof(int32_t);
+    info->payloadLen = len - sizeof(int32_t);
+    return true;
+}
+
+
+// Decode the readings at data (see sensor_block) into values in degrees Celsius.
+// Returns the sensor count, or -1 if the readings are truncated or use an unknown encoding.
+inline int decodeSensorValues(const uint8_t *data, size_t len, uint8_t flags, float *values, int maxCount) {
+    if (!(flags & PACKET_FLAG_SENSOR_BLOCK)) {
+        if (len < LEGACY_SENSOR_COUNT * sizeof(float) || maxCount < LEGACY_SENSOR_COUNT) {
+            return -1;
+        }
+        memcpy(values, data, LEGACY_SENSOR_COUNT * sizeof(float));
+        return LEGACY_SENSOR_COUNT;
+    }
+
+    sensor_block block;
+    if (len < sizeof(block)) {
+        return -1;
+    }
+    memcpy(&block, data, sizeof(block));
+    if (block.sensorCount > maxCount || block.sensorCount > MAX_SENSORS) {
+        return -1;
+    }
+    data += sizeof(block);
+    len -= sizeof(block);
+
+    if (block.encoding == SENSOR_ENCODING_FLOAT32) {
+        if (len < block.sensorCount * sizeof(float)) {
+            return -1;
+        }
+        memcpy(values, data, block.sensorCount * sizeof(float));
+    } else if (block.encoding == SENSOR_ENCODING_CENTI) {
+        if (len < block.sensorCount * sizeof(int16_t)) {
+            return -1;
+        }
+        for (int i = 0; i < block.sensorCount; i++) {
+            int16_t centi;
+            memcpy(&centi, data + i * sizeof(int16_t), sizeof(centi));
+            values[i] = centi == SENSOR_CENTI_INVALID ? SENSOR_VALUE_INVALID : centi / 100.0f;
+        }
+    } else {
+        return -1;
+    }
+    return block.sensorCount;
+}
+
+
+// Write a sensor_block with count values to out (servant side and simulators).
+// Returns the number of bytes written, 0 if size is too small or count is out of range.
+inline size_t encodeSensorValues(uint8_t *out, size_t size, const float *values, int count, uint8_t encoding) {
+    size_t valueSize = encoding == SENSOR_ENCODING_CENTI ? sizeof(int16_t) : sizeof(float);
+    if (count < 0 || count > MAX_SENSORS || sizeof(sensor_block) + count * valueSize > size) {
+        return 0;
+    }
+
+    sensor_block block = {(uint8_t)count, encoding};
+    memcpy(out, &block, sizeof(block));
+    uint8_t *pos = out + sizeof(block);
+    for (int i = 0; i < count; i++) {
+        if (encoding == SENSOR_ENCODING_CENTI) {
+            float centiValue = values[i] * 100.0f;
+            int16_t centi = SENSOR_CENTI_INVALID;
+            if (values[i] > SENSOR_VALUE_INVALID && centiValue > INT16_MIN && centiValue <= INT16_MAX) {
+                centi = (int16_t)(centiValue < 0 ? centiValue - 0.5f : centiValue + 0.5f);
+            }
+            memcpy(pos, &centi, sizeof(centi));
+        } else {
+            memcpy(pos, &values[i], sizeof(float));
+        }
+        pos += valueSize;
+    }
+    return pos - out;
+}
+
+#endif // PROTOCOL_H
@@ -0,0 +1,43 @@
+#ifndef RECORD_FORMAT_H
+#define RECORD_FORMAT_H
+
+/*
+ * Record Formatting - TX Master ESP32
+ *
+ * Allocation-free CSV row formatting for the master log. Rows are written
+ * straight into a caller-provided buffer, with the same text the firmware
+ * used to build from Arduino String objects:
+ *
+ *   2025-07-29 14:30:15,1,1,23.50      (one row per sensor)
+ *   2025-07-29 14:30:15,3,123456789,NAN (servant without data)
+ *
+ * Plain C++ without Arduino dependencies, so host tools can use it as well.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define RECORD_NAN_SENSOR_NO    123456789   // Sentinel sensor number for servants without data
+#define RECORD_BUFFER_SIZE      2048        // Enough for one servant with 32 sensors
+#define RECORD_TIMESTAMP_SIZE   24          // "2025-07-29 14:30:15.123" and terminator
+
+// Write the RTC time epoch as "2025-07-29 14:30:15", with ".mmm" appended if millis >= 0.
+// The epoch is wall-clock time, so no time zone is applied. Returns the text length.
+size_t formatTimestamp(char *out, size_t size, uint32_t epoch, int millis);
+
+// Write value with two decimals ("23.50", "-999.00", "nan", "inf"), matching
+// Arduino's String(float). Returns the number of characters written (max 24,
+// no terminator is added).
+size_t formatFixed2(char *out, float value);
+
+// Write one "timestamp,servant,sensor,value" row per reading into out.
+// Returns the length of the NUL-terminated text, or 0 if size is too small
+// or count is 0 (the log writes the NAN row for such a reply).
+size_t formatTempRecord(char *out, size_t size, const char *timestamp, int servantID,
+                        const float *readings, int count);
+
+// Write the "timestamp,servant,123456789,NAN" row for a servant without data.
+// Returns the length of the NUL-terminated text, or 0 if size is too small.
+size_t formatNanRecord(char *out, size_t size, const char *timestamp, int servantID);
+
+#endif // RECORD_FORMAT_H
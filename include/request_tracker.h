@@ -0,0 +1,76 @@
+#ifndef REQUEST_TRACKER_H
+#define REQUEST_TRACKER_H
+
+/*
+ * Request Tracker - TX Master ESP32
+ *
+ * Keeps the requests that are waiting for a reply, per servant, and decides
+ * whether an incoming reply belongs to one of them. Replies are matched by
+ * (servant, seq, expected action ID); anything else is classified as late
+ * (its request already timed out or never existed) or duplicate (its request
+ * was already answered). Used from the acquisition task only.
+ */
+
+#include <stdint.h>
+#include "config.h"
+
+#define TRACKER_HISTORY         8           // Answered sequence numbers remembered per servant
+
+typedef enum {
+    MATCH_ACCEPTED,                         // Reply to an outstanding request
+    MATCH_LATE,                             // Request timed out, was cancelled or is unknown
+    MATCH_DUPLICATE                         // Request was already answered
+} match_result;
+
+typedef struct tracker_counters {
+    uint32_t issued;
+    uint32_t accepted;
+    uint32_t late;
+    uint32_t duplicate;
+    uint32_t expired;                       // Requests cancelled without a reply
+    uint32_t legacy;                        // Accepted v1 replies (matched by MAC only)
+} tracker_counters;
+
+class RequestTracker {
+public:
+    RequestTracker();
+
+    // Register a request to servant (0-based) that expects a reply with replyActionID; returns its seq
+    uint32_t issue(int servant, int32_t replyActionID, uint32_t nowUs);
+
+    // Register an expected reply to a request that already has a seq (one broadcast answered by every servant)
+    void track(int servant, uint32_t seq, int32_t replyActionID, uint32_t nowUs);
+
+    // Sequence number for requests without a reply (1002/1003), never matched
+    uint32_t nextSeq();
+
+    // Classify a v2 reply; on MATCH_ACCEPTED *sentUs is the send time of the request
+    match_result match(int servant, uint32_t seq, int32_t actionID, uint32_t *sentUs);
+
+    // Classify a v1 reply: accepts the oldest outstanding request with that reply action ID.
+    // On MATCH_ACCEPTED *seq is the sequence number of the request it was taken for.
+    match_result matchLegacy(int servant, int32_t actionID, uint32_t *seq, uint32_t *sentUs);
+
+    // Give up on a request: a reply arriving later is counted as late
+    void cancel(int servant, uint32_t seq);
+
+    int outstanding(int servant) const;
+    const tracker_counters &counters() const { return stats; }
+
+private:
+    typedef struct pending_request {
+        uint32_t seq;                       // 0 = free slot
+        int32_t replyActionID;
+        uint32_t sentUs;
+    } pending_request;
+
+    void complete(int servant, int slot);
+
+    pending_request pending[MAX_SERVANTS][PROTOCOL_MAX_IN_FLIGHT];
+    uint32_t answered[MAX_SERVANTS][TRACKER_HISTORY];
+    uint8_t answeredNext[MAX_SERVANTS];
+    uint32_t sequence;
+    tracker_counters stats;
+};
+
+#endif // REQUEST_TRACKER_H
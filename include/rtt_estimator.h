@@ -0,0 +1,66 @@
+#ifndef RTT_ESTIMATOR_H
+#define RTT_ESTIMATOR_H
+
+/*
+ * RTT Estimator - TX Master ESP32
+ *
+ * Reply timeouts per servant from its measured round trip times, the way
+ * TCP derives its retransmission timeout (RFC 6298): a smoothed RTT and its
+ * mean deviation, timeout = SRTT + 4 * RTTVAR, at least RTT_MIN_TIMEOUT_MS
+ * and at most sendTimeout. Each timeout doubles it for the next request
+ * (up to RTT_MAX_BACKOFF times), the next measured reply resets that. Only
+ * replies to requests that were still waited for are measured, so a late
+ * reply never shortens the timeout.
+ *
+ * It also tells when waiting is pointless: ESP-NOW reports every unicast
+ * frame once, in send order (OnDataSent), after the radio gave up its
+ * retries. The report only names the destination MAC, so frames are
+ * numbered per servant as they are sent and as their reports come in; a
+ * failed report for the latest request frame (or a later one) means the
+ * request never reached the servant. This relies on one report per frame.
+ * A report that never comes would shift every later one, so each request
+ * sent RTT_REPORT_WINDOW_MS or more after the servant's previous frame
+ * starts the count over; a report later than that is misattributed once.
+ *
+ * sent(), sample(), timedOut() and the queries run in the acquisition task,
+ * acknowledged() in the WiFi task (OnDataSent).
+ */
+
+#include <stdint.h>
+#include <atomic>
+#include "config.h"
+
+class RttEstimator {
+public:
+    RttEstimator();
+
+    // A frame to the servant is about to be queued (before the send, its report can come at once);
+    // request = a reply is expected
+    void sent(int servant, bool request, uint32_t nowMs);
+    void notSent(int servant);                      // The send after sent() failed
+    void acknowledged(int servant, bool delivered);
+
+    // The radio reported the latest request frame to the servant as not delivered
+    bool requestFailed(int servant) const;
+
+    void sample(int servant, uint32_t rttUs);       // Reply to a request that was still waited for
+    void timedOut(int servant);                     // Request given up without a reply
+
+    // Reply timeout for the next request, maxMs (sendTimeout) until the first reply was measured
+    uint32_t timeoutMs(int servant, uint32_t maxMs) const;
+
+    uint32_t srttUs(int servant) const { return srtt[servant]; }
+    uint32_t rttvarUs(int servant) const { return rttvar[servant]; }
+
+private:
+    uint32_t srtt[MAX_SERVANTS];            // Smoothed round trip time, 0 = nothing measured yet
+    uint32_t rttvar[MAX_SERVANTS];          // Mean deviation of the round trip time
+    uint8_t backoff[MAX_SERVANTS];          // Timeouts since the last measured reply
+    uint32_t sentFrames[MAX_SERVANTS];
+    uint32_t requestFrame[MAX_SERVANTS];    // Number of the latest request frame, 0 = none
+    uint32_t lastSentMs[MAX_SERVANTS];
+    std::atomic<uint32_t> reportedFrames[MAX_SERVANTS];
+    std::atomic<uint32_t> failedFrame[MAX_SERVANTS];    // Number of the latest undelivered frame, 0 = none
+};
+
+#endif // RTT_ESTIMATOR_H
@@ -0,0 +1,94 @@
+#ifndef RX_RING_H
+#define RX_RING_H
+
+/*
+ * Receive Ring - TX Master ESP32
+ *
+ * Lock-free single-producer/single-consumer ring of fixed-size packet slots.
+ * The ESP-NOW receive callback (WiFi task) is the only producer, the
+ * acquisition task the only consumer. Each slot keeps a full copy of the
+ * payload together with the sender MAC and the arrival time, so a burst of
+ * replies from many servants is queued instead of overwriting each other.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <atomic>
+
+#define RX_PACKET_MAX_LEN       250         // ESP-NOW payload limit
+
+typedef struct rx_packet {
+    uint8_t mac[6];                         // Sender MAC address
+    uint16_t len;                           // Payload length in bytes
+    uint32_t arrivalUs;                     // Arrival time (microsecond timer, wraps after ~71 min)
+    uint8_t data[RX_PACKET_MAX_LEN];
+} rx_packet;
+
+template <size_t SLOTS>
+class RxRing {
+    static_assert(SLOTS >= 2 && (SLOTS & (SLOTS - 1)) == 0, "RxRing slot count must be a power of two");
+
+public:
+    // Producer side: copy one packet into the next free slot.
+    // Returns false (and counts a drop) if the ring is full or the packet is oversized.
+    bool push(const uint8_t *mac, const uint8_t *data, int len, uint32_t arrivalUs) {
+        if (len < 0 || len > RX_PACKET_MAX_LEN) {
+            dropCount.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        uint32_t h = head.load(std::memory_order_relaxed);
+        uint32_t t = tail.load(std::memory_order_acquire);
+        if (h - t >= SLOTS) {
+            dropCount.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        rx_packet &slot = slots[h & (SLOTS - 1)];
+        memcpy(slot.mac, mac, sizeof(slot.mac));
+        memcpy(slot.data, data, len);
+        slot.len = (uint16_t)len;
+        slot.arrivalUs = arrivalUs;
+        // Publish the slot only after its contents are complete
+        head.store(h + 1, std::memory_order_release);
+
+        uint32_t depth = h + 1 - t;
+        if (depth > highWater.load(std::memory_order_relaxed)) {
+            highWater.store(depth, std::memory_order_relaxed);
+        }
+        return true;
+    }
+
+    // Consumer side: copy the oldest packet out and free its slot.
+    bool pop(rx_packet &out) {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        uint32_t h = head.load(std::memory_order_acquire);
+        if (t == h) {
+            return false;
+        }
+        const rx_packet &slot = slots[t & (SLOTS - 1)];
+        memcpy(out.mac, slot.mac, sizeof(out.mac));
+        out.len = slot.len;
+        out.arrivalUs = slot.arrivalUs;
+        memcpy(out.data, slot.data, slot.len);
+        // Hand the slot back to the producer only after it was copied
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t size() const {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+
+    size_t capacity() const { return SLOTS; }
+    uint32_t dropped() const { return dropCount.load(std::memory_order_relaxed); }
+    uint32_t maxDepth() const { return highWater.load(std::memory_order_relaxed); }
+
+private:
+    rx_packet slots[SLOTS];
+    std::atomic<uint32_t> head{0};          // Next slot to fill, written by the producer only
+    std::atomic<uint32_t> tail{0};          // Next slot to read, written by the consumer only
+    std::atomic<uint32_t> dropCount{0};
+    std::atomic<uint32_t> highWater{0};
+};
+
+#endif // RX_RING_H
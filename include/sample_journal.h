@@ -0,0 +1,71 @@
+#ifndef SAMPLE_JOURNAL_H
+#define SAMPLE_JOURNAL_H
+
+/*
+ * Sample Journal - TX Master ESP32
+ *
+ * Write-ahead journal for log records that were acquired but are not yet
+ * durably on the SD card. The acquisition task appends every record before
+ * it queues it for the storage task; the storage task releases the records
+ * once a log sync has put them on the card. Whatever is still in the journal
+ * at boot was lost with the reset and is written to the log again
+ * (replayLogJournal in log_storage.h).
+ *
+ * On the target the journal lives in RTC slow memory (RTC_NOINIT_ATTR), which
+ * keeps its content through watchdog, panic and software resets but not
+ * through a power loss. A record released late, after a reset between the
+ * sync and the release, is replayed once more and appears twice in the log.
+ *
+ * Entries are stored as binlog records (binlog_format.h) behind a sequence
+ * number and a checksum, in a byte ring of JOURNAL_SIZE bytes. The
+ * acquisition task is the only writer of head, the storage task the only
+ * writer of tail, as in rx_ring.h.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include "config.h"
+#include "acquisition.h"
+
+typedef struct journal_memory {
+    uint32_t magic;                         // JOURNAL_MAGIC once initialised
+    std::atomic<uint32_t> head;             // Bytes ever appended
+    std::atomic<uint32_t> tail;             // Bytes ever released
+    std::atomic<uint32_t> overflows;        // Records not journaled because the journal was full
+    uint32_t nextSeq;
+    uint8_t data[JOURNAL_SIZE];
+} journal_memory;
+
+class SampleJournal {
+public:
+    SampleJournal();
+
+    // Attach the memory that survived the reset. Keeps its entries if the memory holds a
+    // valid journal, else starts empty. Returns the number of entries left to replay.
+    uint32_t begin(journal_memory *memory);
+
+    // Acquisition task: journal record; returns its sequence number, 0 if it didn't fit
+    uint32_t append(const log_record &record);
+
+    // Storage task: the records up to seq are on the card
+    void release(uint32_t seq);
+
+    // Boot only, before the acquisition task starts: the entries in order, record.journalSeq set.
+    // Returns false after the last one, or at the first damaged entry.
+    bool next(uint32_t *position, log_record *record) const;
+    uint32_t start() const;                 // First position for next()
+    void discard();                         // Boot only: drop the entries next() couldn't read
+
+    size_t used() const;                    // Bytes of unreleased entries
+    size_t capacity() const { return JOURNAL_SIZE; }
+    uint32_t overflows() const;
+
+private:
+    void copyIn(uint32_t position, const void *data, size_t len);
+    void copyOut(uint32_t position, void *data, size_t len) const;
+
+    journal_memory *memory;
+};
+
+#endif // SAMPLE_JOURNAL_H
@@ -0,0 +1,122 @@
+#ifndef SD_LOGGER_H
+#define SD_LOGGER_H
+
+/*
+ * SD Logger - TX Master ESP32
+ *
+ * Buffered append-only writer for the master log file. The file handle stays
+ * open for the whole run and records are collected in a RAM buffer. When the
+ * buffer is nearly full, all complete blocks up to the next 512-byte boundary
+ * of the file are committed in one write, so the card sees aligned
+ * multi-sector writes instead of one open/seek/write/close per record. The
+ * partial tail block and the directory entry are synced every
+ * SD_SYNC_INTERVAL_MS.
+ *
+ * A pre-allocated file (capacity > 0, see log_segments.h) is written in
+ * place from its logical end instead: the clusters already exist, so
+ * neither the block writes nor the syncs have to extend the FAT chain.
+ * Past the data, such a file holds whatever the card held before, so end()
+ * cuts it to its data while nothing is being logged; resume() allocates it
+ * again.
+ *
+ * With a backlog (reserveBacklog, SD_BACKLOG_SIZE of PSRAM) append() never
+ * touches the card: data that doesn't fit into the buffer is queued in the
+ * backlog, and poll()/sync() write it out in bulk, SD_BACKLOG_DRAIN_SIZE per
+ * call, whenever the card takes data. A missing, swapped or slow card then
+ * costs RAM instead of records until the backlog is full.
+ *
+ * Talks to the card only through hal.h, so the native build runs the same
+ * writer against a directory on the host.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include "config.h"
+#include "hal.h"
+#include "backlog_ring.h"
+
+#define SD_BLOCK_SIZE           512
+
+typedef struct sd_logger_stats {
+    uint64_t bytesWritten;                  // Bytes committed to the card
+    uint32_t commits;                       // Number of block writes
+    uint32_t syncs;                         // Number of flush + sync operations
+    uint32_t lastWriteUs;                   // Duration of the last block write
+    uint32_t maxWriteUs;                    // Slowest block write since boot
+    uint64_t totalWriteUs;                  // Sum of all block write durations
+    uint32_t lastSyncUs;                    // Duration of the last sync
+    uint32_t maxSyncUs;                     // Slowest sync since boot
+    uint32_t failures;                      // Failed writes / reopen attempts
+    uint32_t droppedBytes;                  // Bytes lost because the buffer was full while the card was gone
+    uint32_t backlogOverflows;              // Appends dropped because the backlog was full
+} sd_logger_stats;
+
+class SdLogger {
+public:
+    SdLogger();
+
+    // Open (or create) the log file, writing the header bytes if the file is empty.
+    // With a capacity the file is pre-allocated to that size and its data ends at dataEnd.
+    // The card must already be mounted.
+    bool begin(const char *path, const void *header, size_t headerLen, uint32_t capacity = 0, uint32_t dataEnd = 0);
+
+    // Allocate the store-and-forward backlog (halAllocLarge); without it a full buffer
+    // waits for the card and drops data while the card is gone. Call once, before logging.
+    bool reserveBacklog(size_t size);
+
+    // Buffer a record; without a backlog whole blocks are written as soon as they are complete
+    bool append(const char *data, size_t len);
+
+    // Write whole blocks and the backlog, and sync once SD_SYNC_INTERVAL_MS has passed
+    void poll();
+
+    // Write everything that is buffered (and up to SD_BACKLOG_DRAIN_SIZE of the backlog)
+    // and sync the directory entry now
+    bool sync();
+
+    // Write and sync everything, close the file and cut a pre-allocated one to its data, so the
+    // card can be pulled; false while data can't be written (the file then stays open) or the
+    // cut failed (retried by the next call, at most every SD_RETRY_INTERVAL_MS).
+    // resume() opens it again, allocated to its capacity.
+    bool end();
+    bool resume();
+
+    bool isOpen() const { return opened; }
+    bool isEnded() const { return ended; }
+    bool needsTrim() const { return trimPending; }  // Ended, but the file is not cut to its data yet
+    const char *filePath() const { return path; }
+    size_t buffered() const { return used; }
+    size_t backlogUsed() const { return backlog.used(); }
+    size_t backlogCapacity() const { return backlog.capacity(); }   // 0 = no backlog
+    size_t backlogPeak() const { return backlog.peak(); }
+    uint32_t length() const { return filePosition + used + backlog.used(); }   // Logical file size including buffered data
+    uint32_t syncedLength() const { return syncedPosition; }    // Logical file size at the last sync
+    uint32_t lastSyncMs() const { return lastSync; }           // halMillis() of the last sync
+    const sd_logger_stats &stats() const { return statistics; }
+
+private:
+    bool commit(bool includePartial);
+    bool drainBacklog();                    // True once the backlog is empty
+    size_t writeChunk(const uint8_t *data, size_t len);    // Returns the bytes that reached the file
+    bool reopen();
+    void close();
+
+    HalFile file;
+    char path[32];
+    uint8_t header[96];
+    size_t headerLen;
+    bool opened;
+    bool ended;                             // Closed by end(), nothing buffered
+    bool trimPending;                       // Ended, pre-allocated space not cut off yet
+    uint32_t capacity;                      // Pre-allocated size, 0 = plain append file
+    uint32_t filePosition;                  // Logical end of file
+    uint32_t syncedPosition;
+    size_t used;                            // Bytes waiting in buffer
+    uint32_t lastSync;
+    uint32_t lastReopenAttempt;
+    sd_logger_stats statistics;
+    BacklogRing backlog;                    // Behind the buffer: its data is newer than the buffered bytes
+    uint8_t buffer[SD_BUFFER_SIZE] __attribute__((aligned(4)));
+};
+
+#endif // SD_LOGGER_H
@@ -0,0 +1,66 @@
+#ifndef STATUS_LED_H
+#define STATUS_LED_H
+
+/*
+ * Status LED - TX Master ESP32
+ *
+ * Driver for the single WS2812 status pixel. setPattern() is the only call
+ * the application needs: it returns at once if the pattern is already
+ * running, and blinking is done by an esp_timer, so the LED keeps its rhythm
+ * while the calling task is blocked and costs nothing in the task loops.
+ * The pixel is written only when its color actually changes (twice per blink
+ * period at most), which keeps the WS2812 transfers away from the radio
+ * callbacks.
+ *
+ * Firmware environments only (uses Adafruit_NeoPixel and esp_timer).
+ */
+
+#include <stdint.h>
+#include <Adafruit_NeoPixel.h>
+#include <esp_err.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+#define LED_BLINK_INTERVAL_MS   1000        // Default on and off time of the blink patterns
+
+// Numbered like the former updateStatusLED() status codes
+typedef enum led_pattern {
+    LED_OFF             = 0,
+    LED_YELLOW          = 1,
+    LED_GREEN_BLINK     = 2,
+    LED_GREEN           = 3,
+    LED_RED             = 4,
+    LED_RED_BLINK       = 5,
+    LED_YELLOW_BLINK    = 6
+} led_pattern;
+
+class StatusLed {
+public:
+    explicit StatusLed(uint8_t pin);
+
+    // Initialise the pixel (off) and the blink timer; call once in setup()
+    bool begin();
+
+    // Switch to pattern; blinking patterns toggle every blinkMs. Safe from any task.
+    void setPattern(led_pattern pattern, uint32_t blinkMs = LED_BLINK_INTERVAL_MS);
+
+    led_pattern pattern() const { return currentPattern; }
+    uint32_t pushes() const { return pushCount; }   // Pixel writes since boot
+
+private:
+    static void onBlinkTimer(void *arg);
+    void push(uint32_t color);              // Caller holds lock
+
+    Adafruit_NeoPixel strip;
+    esp_timer_handle_t blinkTimer;
+    SemaphoreHandle_t lock;
+    led_pattern currentPattern;
+    uint32_t currentBlinkMs;
+    uint32_t patternColor;                  // Color of the pattern's on phase
+    bool blinkOn;
+    uint32_t shownColor;                    // Last color written to the pixel
+    uint32_t pushCount;
+};
+
+#endif // STATUS_LED_H
@@ -0,0 +1,96 @@
+#ifndef TIME_SYNC_H
+#define TIME_SYNC_H
+
+/*
+ * Time Sync - TX Master ESP32
+ *
+ * Sets the RTC from an NTP server without ever blocking the acquisition
+ * task. A sync is a state machine that poll() advances by at most one step
+ * per call and that never waits: join the access point, look up the server,
+ * send up to NTP_REQUESTS SNTP requests (ntp_packet.h), then write the RTC
+ * at the next whole second of the server's time.
+ *
+ * Joining the access point takes the radio off the ESP-NOW channel, so a
+ * sync only runs while the master is idle (not logging). The acquisition task
+ * is the only caller, and it sends nothing over ESP-NOW while ownsRadio() is
+ * true. If logging starts during a sync, the next poll() aborts it. That
+ * same call gives the radio back (halNetRestore) before the acquisition task
+ * sends again. The sync is retried once the master is idle again.
+ *
+ * The RTC keeps local time: the server's UTC plus utcOffsetS.
+ */
+
+#include <stdint.h>
+#include "config.h"
+#include "ntp_packet.h"
+
+typedef enum time_sync_state {
+    TIME_SYNC_IDLE,
+    TIME_SYNC_JOINING,                      // Associating with the access point
+    TIME_SYNC_RESOLVING,                    // DNS lookup of the server
+    TIME_SYNC_REQUESTING,                   // SNTP request sent, waiting for the reply
+    TIME_SYNC_SETTING                       // Radio back; RTC written at the next whole second
+} time_sync_state;
+
+typedef struct time_sync_config {
+    const char *ssid;
+    const char *password;
+    const char *server;                     // Host name or dotted address
+    uint16_t port;                          // NTP_PORT, or the port of tools/ntp_responder
+    int32_t utcOffsetS;                     // Local time of the RTC minus UTC
+} time_sync_config;
+
+typedef struct time_sync_stats {
+    uint32_t attempts;
+    uint32_t successes;
+    uint32_t failures;
+    uint32_t deferred;                      // Syncs aborted because logging started
+    int32_t lastCorrectionS;                // RTC change of the last successful sync
+    uint32_t lastRttMs;                     // Round trip of its NTP exchange
+    uint32_t lastSuccessMs;                 // halMillis() of the last success, 0 = none
+    uint32_t lastDurationMs;                // Radio away from ESP-NOW during the last sync
+} time_sync_stats;
+
+class TimeSync {
+public:
+    TimeSync();
+
+    // Keep config (its strings must stay valid) and schedule the first sync NTP_SYNC_INTERVAL_MS ahead
+    void begin(const time_sync_config &config);
+
+    // Sync at the next chance (boot, RTC found invalid)
+    void request();
+
+    // Acquisition task, every iteration. idle = not logging: a due sync starts only then,
+    // and a running one is aborted (radio restored) as soon as idle turns false.
+    void poll(bool idle);
+
+    // The radio is away from the ESP-NOW channel: no ESP-NOW sends
+    bool ownsRadio() const { return current == TIME_SYNC_JOINING || current == TIME_SYNC_RESOLVING
+                                    || current == TIME_SYNC_REQUESTING; }
+    time_sync_state state() const { return current; }
+    const time_sync_stats &stats() const { return statistics; }
+
+private:
+    void start(uint32_t now);
+    void sendRequest(uint32_t now);
+    void receiveReply(uint32_t now);
+    void restoreRadio(uint32_t now);
+    void finish(uint32_t now, bool success, const char *reason);
+
+    time_sync_config config;
+    time_sync_state current;
+    uint32_t nextAttemptMs;
+    uint32_t stateSinceMs;                  // halMillis() of the last state change or request
+    uint32_t radioSinceMs;                  // halMillis() the radio left the ESP-NOW channel
+    uint32_t serverIp;
+    int requestsSent;
+    ntp_timestamp requestStamp;             // Transmit timestamp of the open request
+    uint64_t serverMs;                      // Server time (Unix ms) at localMs
+    uint32_t localMs;
+    time_sync_stats statistics;
+};
+
+extern TimeSync timeSync;
+
+#endif // TIME_SYNC_H
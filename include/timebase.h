@@ -0,0 +1,102 @@
+#ifndef TIMEBASE_H
+#define TIMEBASE_H
+
+/*
+ * Timebase - TX Master ESP32
+ *
+ * Millisecond wall-clock time without an I2C transfer per lookup. The
+ * DS3231 is read only to anchor the timebase: an RTC second together with
+ * the microsecond timer value of the edge that started it. Between anchors,
+ * nowMs() extrapolates from the timer. The anchor is renewed every
+ * TIMEBASE_ANCHOR_MS.
+ *
+ * The edge comes from the DS3231's 1 Hz square wave when RTC_SQW_PIN is
+ * wired (halRtcEdgeUs). Otherwise it is bracketed by two RTC reads at most
+ * TIMEBASE_SEARCH_GAP_US apart. Before the first anchor (and after
+ * invalidate()) the RTC is read every half search gap until a second
+ * changes between two reads. Once anchored, each renewal reads it exactly
+ * twice, waiting a few ms in one poll: just before the predicted edge and
+ * just after it, inside the range the edge can be in after the last anchor
+ * (wider until the drift is measured). Each read tells on which side of it
+ * the edge is, which narrows that range. Reads that contradict it retry
+ * the next second with twice the range; after two misses in a row the edge
+ * is searched for again. The timer's rate error against the RTC is
+ * measured over at least TIMEBASE_DRIFT_MIN_MS and corrected from then on.
+ *
+ * poll() runs in the acquisition task only. nowMs() and epoch() can be
+ * called from any task. Before the first anchor they fall back to reading
+ * the RTC.
+ */
+
+#include <stdint.h>
+#include <atomic>
+#include "config.h"
+
+typedef struct timebase_stats {
+    uint32_t anchors;                       // Anchors taken on an RTC second edge
+    uint32_t steps;                         // Anchors that found the RTC set or the prediction off by >= 0.5 s
+    uint32_t rtcReads;                      // RTC reads of the anchoring (I2C transfers)
+    int32_t driftPpb;                       // RTC rate minus timer rate, parts per billion (0 = not measured yet)
+    int32_t lastErrorUs;                    // Prediction minus RTC at the last anchor
+    uint32_t maxErrorUs;                    // Largest |lastErrorUs| since the last step
+    bool squareWave;                        // Edges come from the SQW pin (else bracketing reads)
+} timebase_stats;
+
+class Timebase {
+public:
+    Timebase();
+
+    // Setup: take the first anchor; waits for an RTC second edge (up to about 1 s, 2 s with
+    // squareWave = SQW set up but no edge seen yet)
+    bool begin(bool squareWave);
+
+    // Acquisition task, every iteration: renew the anchor when it is due
+    void poll();
+
+    // The RTC was set (time sync): anchor again at its next edge, restart the drift baseline
+    void invalidate();
+
+    bool valid() const { return sequence.load(std::memory_order_acquire) != 0; }
+    uint64_t nowMs() const;                 // Unix time in ms, in the RTC's time zone
+    uint32_t epoch() const { return (uint32_t)(nowMs() / 1000); }
+    const timebase_stats &stats() const { return statistics; }
+
+private:
+    bool anchorFromEdge(uint64_t nowUs);
+    bool anchorFromReads(uint64_t nowUs);
+    void setAnchor(uint32_t epoch, uint64_t edgeUs, uint32_t uncertaintyUs);
+    bool bracketPredictedEdge(uint64_t nowUs);
+    bool narrowEdge(uint32_t epoch, uint64_t startUs, uint64_t doneUs);
+    void predictEdge(uint64_t nowUs);
+    void missedEdge(uint64_t nowUs);
+
+    // Published anchor (seqlock: odd while the acquisition task rewrites it)
+    std::atomic<uint32_t> sequence;
+    std::atomic<uint32_t> anchorEpoch;
+    std::atomic<uint32_t> anchorUsHigh;
+    std::atomic<uint32_t> anchorUsLow;
+    std::atomic<int32_t> anchorDriftPpb;
+
+    // Acquisition task only
+    uint64_t anchorUs;                      // Timer value of the last anchor
+    uint32_t anchorUncertaintyUs;           // How far its edge may be off (bracketing reads)
+    uint64_t baselineUs;                    // Anchor the drift is measured from
+    uint32_t baselineEpoch;
+    uint32_t baselineUncertaintyUs;         // How far its edge may be off (bracketing reads)
+    bool pending;                           // invalidate() called
+    uint64_t invalidatedUs;
+    bool searching;                         // Bracketing the predicted edge failed, read on every poll
+    uint32_t targetEpoch;                   // RTC second that starts at the predicted edge, 0 = not scheduled
+    uint8_t misses;                         // Failed brackets of the predicted edge in a row
+    uint64_t edgeLowUs;                     // Timer range the predicted edge is known to be in
+    uint64_t edgeHighUs;
+    uint64_t firstReadUs;                   // Timer values of the two reads around the predicted edge
+    uint64_t secondReadUs;
+    uint32_t readEpoch;                     // Last read of the search, 0 = none
+    uint64_t readUs;
+    timebase_stats statistics;
+};
+
+extern Timebase timebase;
+
+#endif // TIMEBASE_H
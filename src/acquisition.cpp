@@ -0,0 +1,599 @@
+/*
+ * Acquisition - TX Master ESP32
+ *
+ * See acquisition.h. Everything here runs in the acquisition task, except
+ * acquisitionReceive and acquisitionSent (radio callbacks).
+ */
+
+#include <string.h>
+#include <algorithm>
+#include "acquisition.h"
+#include "metrics.h"
+#include "timebase.h"
+#include "console_log.h"
+#include "hal.h"
+
+PeerRegistry peers;
+RxRing<RX_RING_SLOTS> rxRing;
+
+RequestTracker requestTracker;
+temp servantData[MAX_SERVANTS];
+uint32_t servantDataSeq[MAX_SERVANTS]       = {};   // Request the data in servantData answers
+uint32_t connectionReplySeq[MAX_SERVANTS]   = {};   // Last answered 1001 request
+uint32_t servantRttUs[MAX_SERVANTS]         = {};   // Round trip time of the last reply (without the sync latch delay)
+RttEstimator rttEstimator;
+uint32_t unknownPackets         = 0;                // Packets from unknown senders or with unknown action IDs
+
+// Streaming mode: frames are pushed by the servants and logged as they arrive
+uint32_t lastFrameSeq[MAX_SERVANTS]         = {};   // Frame counter of the last logged frame per servant
+uint32_t lastFrameDisplay[MAX_SERVANTS]     = {};   // Last display update from a frame
+uint32_t streamFrames           = 0;                // Frames logged
+uint32_t streamLostFrames       = 0;                // Gaps in the servants' frame counters
+uint32_t streamDuplicateFrames  = 0;
+uint32_t streamStrayFrames      = 0;                // Frames received while not streaming (answered with 1005)
+
+// Synchronized sampling: latch times reported with the 2003 replies
+uint8_t syncBeaconAddress[6]    = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};  // ESP-NOW broadcast
+uint32_t servantSampleEpoch[MAX_SERVANTS]   = {};
+uint16_t servantSampleMs[MAX_SERVANTS]      = {};
+uint32_t syncCycles             = 0;
+int32_t lastSyncSkewMs          = -1;               // Spread of the latch times in the last cycle, -1 = unknown
+uint32_t maxSyncSkewMs          = 0;
+
+// Connection state tracking: any packet or acknowledged delivery counts as proof of life
+LivenessTracker liveness;
+uint32_t probeSeq[MAX_SERVANTS]             = {};   // Last 1001 probe sent to each servant
+volatile int numConnections     = 0;
+volatile bool acquisitionBusy   = false;
+volatile bool servantOnline[MAX_SERVANTS] = {};
+
+
+int servantIndexFromMac(const uint8_t *mac_addr) {
+    return peers.indexOf(mac_addr); // -1 for unknown senders
+}
+
+
+void acquisitionReceive(const uint8_t *mac, const uint8_t *data, int len) {
+    // Runs in the radio task: only enqueue, decoding happens in the acquisition task (drainRxRing)
+    rxRing.push(mac, data, len, halMicros());
+}
+
+
+void acquisitionSent(const uint8_t *mac, bool delivered) {
+    // The servant's radio acknowledged the frame, so it is alive
+    int servantIndex = servantIndexFromMac(mac);
+    if (delivered) {
+        metrics.sendDelivered.add();
+    } else {
+        metrics.sendFailed.add();
+    }
+    if (servantIndex >= 0) {
+        rttEstimator.acknowledged(servantIndex, delivered);
+    }
+    if (delivered && servantIndex >= 0) {
+        liveness.delivered(servantIndex, halMillis());
+    }
+}
+
+
+uint32_t sendRequest(int servantIndex, int actionID, int replyActionID, float value) {
+    // Requests that expect a reply stay tracked until it arrives or the caller cancels them
+    request_packet packet;
+    uint32_t seq = replyActionID != 0
+        ? requestTracker.issue(servantIndex, replyActionID, halMicros())
+        : requestTracker.nextSeq();
+    buildRequest(&packet, actionID, seq, value);
+
+    rttEstimator.sent(servantIndex, replyActionID != 0, halMillis());
+    if (!halRadioSend(peers.mac(servantIndex), (uint8_t *) &packet, sizeof(packet))) {
+        CONSOLE_WARN("ESP-NOW send failed for target %d\n", servantIndex+1);
+        metrics.sendErrors.add();
+        rttEstimator.notSent(servantIndex);
+        if (replyActionID != 0) {
+            requestTracker.cancel(servantIndex, seq);
+        }
+        return 0;
+    }
+    return seq;
+}
+
+
+bool isStreaming() {
+    return logState && streamingMode;
+}
+
+
+void sendLogState(bool logState){
+    static bool wasStreaming = false;
+    bool streaming = logState && streamingMode;
+
+    if (streaming && !wasStreaming) {
+        memset(lastFrameSeq, 0, sizeof(lastFrameSeq));  // Servants restart their frame counters on 1004
+    }
+
+    for (int i = 0; i < peers.count(); i++) {
+        sendRequest(i, logState ? 1002 : 1003);
+        // The push schedule is repeated with every log state update, so a servant that restarted
+        // resumes streaming; servants ignore a 1004 that doesn't change their period
+        if (streaming) {
+            sendRequest(i, 1004, 0, (float)std::max(streamPeriodMs, STREAM_MIN_PERIOD_MS));
+        } else if (wasStreaming) {
+            sendRequest(i, 1005);
+        }
+    }
+    wasStreaming = streaming;
+}
+
+
+// Decode the readings that start offset bytes into the payload (9 floats or a sensor_block)
+static bool decodeTemp(const packet_info &info, size_t offset, temp *t) {
+    if (info.payloadLen < offset) {
+        return false;
+    }
+    int count = decodeSensorValues(info.payload + offset, info.payloadLen - offset, info.flags, t->sens, MAX_SENSORS);
+    if (count < 0) {
+        return false;
+    }
+    t->count = count;
+    return true;
+}
+
+
+static void handleStreamFrame(int servantIndex, const packet_info &info, const temp &data) { //MARK: Handle stream frame
+    if (!isStreaming()) {
+        // The servant missed the 1005 (or restarted into streaming mode), tell it again
+        streamStrayFrames++;
+        sendRequest(servantIndex, 1005);
+        return;
+    }
+
+    // Frames arrive in order over a unicast link; a repeated counter is a retransmission,
+    // a jump means frames were lost and a smaller value that the servant restarted
+    uint32_t lastSeq = lastFrameSeq[servantIndex];
+    if (info.seq == lastSeq) {
+        streamDuplicateFrames++;
+        return;
+    }
+    if (lastSeq != 0 && info.seq > lastSeq + 1) {
+        streamLostFrames += info.seq - lastSeq - 1;
+    }
+    lastFrameSeq[servantIndex] = info.seq;
+
+    // Several frames per second at short push periods: the ms part keeps their rows apart and in order
+    uint64_t nowMs = timebase.nowMs();
+    queueLogRecord((uint32_t)(nowMs / 1000), servantIndex+1, &data, (int)(nowMs % 1000));
+    streamFrames++;
+
+    // The display doesn't need every frame
+    if (halMillis() - lastFrameDisplay[servantIndex] >= 1000) {
+        lastFrameDisplay[servantIndex] = halMillis();
+        postTemp(servantIndex+1, data, true);
+    }
+}
+
+
+void drainRxRing() { //MARK: Drain receive ring
+    rx_packet packet;
+    packet_info info;
+    temp rxData;
+
+    while (rxRing.pop(packet)) {
+        int servantIndex = servantIndexFromMac(packet.mac);
+        if (servantIndex < 0 || !parsePacket(packet.data, packet.len, &info)) {
+            unknownPackets++;
+            continue;
+        }
+        liveness.heard(servantIndex, halMillis());  // Even a late or unexpected packet proves the servant is up
+
+        // Readings are decoded up front, so truncated or malformed packets never reach the tracker
+        bool knownReply;
+        if (info.actionID == 1001) {
+            knownReply = true;
+        } else if (info.actionID == 2001 || info.actionID == 2002) {
+            knownReply = decodeTemp(info, 0, &rxData);
+        } else if (info.actionID == 2003) {
+            knownReply = decodeTemp(info, sizeof(sync_sample_time), &rxData);
+        } else {
+            knownReply = false;
+        }
+
+        // Streamed frames need the v2 header for their frame counter and are not replies to anything
+        if (info.actionID == 2002 && knownReply && !info.legacy) {
+            handleStreamFrame(servantIndex, info, rxData);
+            continue;
+        }
+
+        // Sync samples carry their latch time in the v2 payload
+        if (info.actionID == 2003 && info.legacy) {
+            knownReply = false;
+        }
+        if (!knownReply || info.actionID == 2002 || (info.legacy && !acceptLegacyReplies)) {
+            unknownPackets++;
+            continue;
+        }
+
+        // Only a reply to a request that is still outstanding is filed; late and
+        // duplicate replies are dropped here and counted by the tracker
+        uint32_t seq = info.seq;
+        uint32_t sentUs = 0;
+        match_result match = info.legacy
+            ? requestTracker.matchLegacy(servantIndex, info.actionID, &seq, &sentUs)
+            : requestTracker.match(servantIndex, info.seq, info.actionID, &sentUs);
+        if (match != MATCH_ACCEPTED) {
+            if (match == MATCH_LATE) {
+                metrics.latePackets[servantIndex].add();
+            }
+            continue;
+        }
+
+        if (info.actionID == 1001) {
+            // Connection test response
+            connectionReplySeq[servantIndex] = seq;
+        } else if (info.actionID == 2003) {
+            // Synchronized sample: latch time followed by the readings
+            sync_sample_time sample;
+            memcpy(&sample, info.payload, sizeof(sample));     // Payload is not aligned inside the packet
+            servantData[servantIndex] = rxData;
+            servantSampleEpoch[servantIndex] = sample.sampleEpoch;
+            servantSampleMs[servantIndex] = sample.sampleMs % 1000;
+            servantDataSeq[servantIndex] = seq;
+            // The latch delay is the servant waiting on purpose, not link or sensor time
+            uint32_t rttUs = packet.arrivalUs - sentUs;
+            uint32_t delayUs = (uint32_t)SYNC_SAMPLE_DELAY_MS * 1000;
+            servantRttUs[servantIndex] = rttUs > delayUs ? rttUs - delayUs : 0;
+            metrics.rttUs[servantIndex].record(servantRttUs[servantIndex]);
+            rttEstimator.sample(servantIndex, servantRttUs[servantIndex]);
+        } else {
+            // Temperature data - file it into the sender's own slot
+            servantData[servantIndex] = rxData;
+            servantDataSeq[servantIndex] = seq;
+            servantRttUs[servantIndex] = packet.arrivalUs - sentUs;
+            metrics.rttUs[servantIndex].record(servantRttUs[servantIndex]);
+            rttEstimator.sample(servantIndex, servantRttUs[servantIndex]);
+        }
+    }
+}
+
+
+static void probeServant(int servantIndex) { //MARK: Probe servant
+    // Fire and forget: the 1001 reply (drainRxRing) or the delivery acknowledgement (acquisitionSent)
+    // refreshes the servant's liveness, nobody waits for it
+    requestTracker.cancel(servantIndex, probeSeq[servantIndex]);     // Previous probe, if still unanswered
+    probeSeq[servantIndex] = sendRequest(servantIndex, 1001, 1001);
+    liveness.probed(servantIndex, halMillis());
+}
+
+
+// Sleep until the radio delivers a packet, but not past timeoutMs after startTime;
+// false once that deadline has passed
+static bool waitForPacket(uint32_t startTime, uint32_t timeoutMs) {
+    uint32_t elapsed = halMillis() - startTime;
+    if (elapsed >= timeoutMs) {
+        return false;
+    }
+    halRadioWait(timeoutMs - elapsed);
+    return true;
+}
+
+
+static bool waitForActionID(int actionID, int targetID, uint32_t seq) { //MARK: Wait for action ID
+    // Replies are filed per servant and request by drainRxRing, so only the answer to seq can satisfy the wait
+    const uint32_t *replySeq = (actionID == 1001) ? &connectionReplySeq[targetID-1] : &servantDataSeq[targetID-1];
+    uint32_t timeoutMs = rttEstimator.timeoutMs(targetID-1, (uint32_t)sendTimeout);
+    uint32_t startTime = halMillis();
+
+    for (;;) {
+        drainRxRing();
+        if (*replySeq == seq) {
+            return true;
+        }
+        // The servant's radio never acknowledged the request: no reply is coming
+        if (rttEstimator.requestFailed(targetID-1)) {
+            CONSOLE_WARN("Request to target %d not delivered\n", targetID);
+            metrics.fastFails[targetID-1].add();
+            requestTracker.cancel(targetID-1, seq);
+            return false;
+        }
+        if (!waitForPacket(startTime, timeoutMs)) {
+            CONSOLE_WARN("Timeout waiting for action ID on target: %d (%lu ms)\n", targetID, (unsigned long)timeoutMs);
+            metrics.timeouts[targetID-1].add();
+            rttEstimator.timedOut(targetID-1);
+            requestTracker.cancel(targetID-1, seq);
+            return false;
+        }
+    }
+}
+
+
+static void getAllTempsFanOut(bool save) {//MARK: Get temperatures (fan-out)
+
+    // Process replies still queued from earlier exchanges first. Each request carries its own
+    // sequence number, so a late reply from the last cycle can't be taken for a new one
+    uint32_t requestSeq[MAX_SERVANTS];
+    uint32_t timeoutMs[MAX_SERVANTS];
+    bool undelivered[MAX_SERVANTS] = {};
+    drainRxRing();
+
+    // Send the request (3001) to every registered servant at once; no connection test beforehand,
+    // a valid reply within the deadline is proof enough that the servant is online
+    int pending = 0;
+    for (int i = 0; i < peers.count(); i++) {
+        timeoutMs[i] = rttEstimator.timeoutMs(i, (uint32_t)sendTimeout);
+        requestSeq[i] = sendRequest(i, 3001, 2001);
+        if (requestSeq[i] != 0) {
+            pending++;
+        }
+    }
+
+    // Collect replies until every servant has answered, its request was reported undelivered or
+    // its own deadline expired. The task sleeps between packets (and delivery failures), each reply
+    // is handled as soon as it is queued
+    uint32_t startTime = halMillis();
+    while (pending > 0) {
+        drainRxRing();
+        pending = 0;
+        uint32_t waitMs = 0;
+        uint32_t elapsed = halMillis() - startTime;
+        for (int i = 0; i < peers.count(); i++) {
+            if (requestSeq[i] == 0 || servantDataSeq[i] == requestSeq[i] || undelivered[i]) {
+                continue;
+            }
+            if (rttEstimator.requestFailed(i)) {
+                undelivered[i] = true;
+            } else if (elapsed < timeoutMs[i]) {
+                pending++;
+                waitMs = std::max(waitMs, timeoutMs[i]);
+            }
+        }
+        if (pending > 0) {
+            waitForPacket(startTime, waitMs);
+        }
+    }
+    int missing = 0;
+    for (int i = 0; i < peers.count(); i++) {
+        if (requestSeq[i] != 0 && servantDataSeq[i] != requestSeq[i]) {
+            missing++;
+        }
+    }
+    CONSOLE_INFO("Fan-out cycle finished after %lu ms (%d servant(s) missing)\n",
+              (unsigned long)(halMillis() - startTime), missing);
+
+    // All servants were sampled within the same window, so the whole cycle shares one timestamp
+    uint32_t cycleEpoch = timebase.epoch();
+
+    for (int i = 0; i < peers.count(); i++) {
+        if (requestSeq[i] != 0 && servantDataSeq[i] == requestSeq[i]) {
+            CONSOLE_DEBUG("Successfully received data from servant %d (%lu us)\n", i+1, (unsigned long)servantRttUs[i]);
+            if (save == true) {
+                queueLogRecord(cycleEpoch, i+1, &servantData[i]);
+            }
+            postTemp(i+1, servantData[i], true);
+        } else {
+            if (requestSeq[i] != 0 && undelivered[i]) {
+                CONSOLE_WARN("Request to servant %d not delivered - logging NAN\n", i+1);
+                requestTracker.cancel(i, requestSeq[i]);
+                metrics.fastFails[i].add();
+            } else if (requestSeq[i] != 0) {
+                CONSOLE_WARN("Failed to receive data from servant %d - logging NAN\n", i+1);
+                requestTracker.cancel(i, requestSeq[i]);    // A reply after the deadline counts as late
+                metrics.timeouts[i].add();
+                rttEstimator.timedOut(i);
+            } else {
+                CONSOLE_WARN("Failed to receive data from servant %d - logging NAN\n", i+1);
+            }
+            if (save == true) {
+                queueLogRecord(cycleEpoch, i+1, NULL);
+            }
+            // Display shows "-" for failed servants
+            temp emptyData = {0};
+            postTemp(i+1, emptyData, false);
+        }
+    }
+}
+
+
+static void getAllTempsSynced(bool save) {//MARK: Get temperatures (sync beacon)
+
+    // One broadcast reaches all servants at (nearly) the same instant; each latches its sensors
+    // SYNC_SAMPLE_DELAY_MS after reception and replies (2003) with the latch time in ms
+    drainRxRing();
+    uint64_t beaconMs = timebase.nowMs();
+    uint32_t seq = requestTracker.nextSeq();
+    sync_beacon_packet beacon;
+    buildSyncBeacon(&beacon, seq, (uint32_t)(beaconMs / 1000), (uint16_t)(beaconMs % 1000), SYNC_SAMPLE_DELAY_MS);
+
+    uint32_t sentUs = halMicros();
+    for (int i = 0; i < peers.count(); i++) {
+        requestTracker.track(i, seq, 2003, sentUs);
+    }
+    bool sent = halRadioSend(syncBeaconAddress, (uint8_t *) &beacon, sizeof(beacon));
+    if (!sent) {
+        CONSOLE_WARN("ESP-NOW sync beacon send failed\n");
+        metrics.sendErrors.add();
+    }
+
+    // Collect replies until every servant has answered or the latch delay plus its own reply timeout
+    // expired. Broadcasts are not acknowledged, so there is no early failure here; instead a servant
+    // that is offline gets the shortest timeout and doesn't hold up the cycle
+    uint32_t timeoutMs[MAX_SERVANTS];
+    for (int i = 0; i < peers.count(); i++) {
+        timeoutMs[i] = SYNC_SAMPLE_DELAY_MS + (liveness.online(i, halMillis())
+                                               ? rttEstimator.timeoutMs(i, (uint32_t)sendTimeout)
+                                               : std::min((uint32_t)RTT_MIN_TIMEOUT_MS, (uint32_t)sendTimeout));
+    }
+    uint32_t startTime = halMillis();
+    int pending = sent ? peers.count() : 0;
+    while (pending > 0) {
+        drainRxRing();
+        pending = 0;
+        uint32_t waitMs = 0;
+        uint32_t elapsed = halMillis() - startTime;
+        for (int i = 0; i < peers.count(); i++) {
+            if (servantDataSeq[i] != seq && elapsed < timeoutMs[i]) {
+                pending++;
+                waitMs = std::max(waitMs, timeoutMs[i]);
+            }
+        }
+        if (pending > 0) {
+            waitForPacket(startTime, waitMs);
+        }
+    }
+    for (int i = 0; i < peers.count(); i++) {
+        if (sent && servantDataSeq[i] != seq) {
+            pending++;
+        }
+    }
+
+    // Skew between units: spread of the latch times the servants reported for this beacon
+    int64_t earliestMs = INT64_MAX;
+    int64_t latestMs = INT64_MIN;
+    for (int i = 0; i < peers.count(); i++) {
+        if (servantDataSeq[i] == seq) {
+            int64_t sampleMs = (int64_t)servantSampleEpoch[i] * 1000 + servantSampleMs[i];
+            earliestMs = std::min(earliestMs, sampleMs);
+            latestMs = std::max(latestMs, sampleMs);
+        }
+    }
+    syncCycles++;
+    lastSyncSkewMs = earliestMs <= latestMs ? (int32_t)(latestMs - earliestMs) : -1;
+    if (lastSyncSkewMs > (int32_t)maxSyncSkewMs) {
+        maxSyncSkewMs = lastSyncSkewMs;
+    }
+    CONSOLE_INFO("Sync cycle %lu finished after %lu ms (%d servant(s) missing, skew %ld ms)\n",
+              (unsigned long)syncCycles, (unsigned long)(halMillis() - startTime), pending, (long)lastSyncSkewMs);
+
+    for (int i = 0; i < peers.count(); i++) {
+        if (servantDataSeq[i] == seq) {
+            CONSOLE_DEBUG("Successfully received data from servant %d (%lu us, sampled at +%ld ms)\n", i+1,
+                      (unsigned long)servantRttUs[i], (long)((int64_t)servantSampleEpoch[i] * 1000 + servantSampleMs[i] - earliestMs));
+            if (save == true) {
+                // Logged with the servant's own latch time at ms resolution
+                queueLogRecord(servantSampleEpoch[i], i+1, &servantData[i], servantSampleMs[i]);
+            }
+            postTemp(i+1, servantData[i], true);
+        } else {
+            CONSOLE_WARN("Failed to receive data from servant %d - logging NAN\n", i+1);
+            requestTracker.cancel(i, seq);
+            metrics.timeouts[i].add();
+            if (sent) {
+                rttEstimator.timedOut(i);
+            }
+            if (save == true) {
+                queueLogRecord((uint32_t)(beaconMs / 1000), i+1, NULL);
+            }
+            temp emptyData = {0};
+            postTemp(i+1, emptyData, false);
+        }
+    }
+}
+
+
+void getAllTemps(bool save) {//MARK: Get temperatures
+
+    acquisitionBusy = true;     // UI shows "Updating Temperature" while the cycle runs
+
+    if (syncSampling) {
+        getAllTempsSynced(save);
+        acquisitionBusy = false;
+        return;
+    }
+
+    if (fanOutPolling) {
+        getAllTempsFanOut(save);
+        acquisitionBusy = false;
+        return;
+    }
+
+    for (int i = 0; i < peers.count(); i++) {
+        // Only try to get temperatures from servants that showed a sign of life recently
+        drainRxRing();
+        bool servantConnected = liveness.online(i, halMillis());
+        if (servantConnected) {
+            // Request temperatures (3001); only the 2001 reply carrying this seq is accepted
+            uint32_t seq = sendRequest(i, 3001, 2001);
+
+            if (seq != 0 && waitForActionID(2001, i+1/*Target ID*/, seq) == true){
+                CONSOLE_DEBUG("Successfully received data from servant %d\n", i+1);
+                if (save == true)
+                {
+                    queueLogRecord(timebase.epoch(), i+1, &servantData[i]);
+                }
+                postTemp(i+1, servantData[i], true);
+            } else {
+                CONSOLE_WARN("Failed to receive data from servant %d - logging NAN\n", i+1);
+                // For failed data retrieval, log NAN if saving
+                if (save == true) {
+                    queueLogRecord(timebase.epoch(), i+1, NULL);
+                }
+                // Display shows "-" for failed servants
+                temp emptyData = {0};
+                postTemp(i+1, emptyData, false);
+            }
+        } else {
+            CONSOLE_INFO("Servant %d not connected - logging NAN\n", i+1);
+            // For disconnected servants, log NAN if saving
+            if (save == true) {
+                queueLogRecord(timebase.epoch(), i+1, NULL);
+            }
+            // Display shows "-" for disconnected servants
+            temp emptyData = {0};
+            postTemp(i+1, emptyData, false);
+        }
+    }
+
+    acquisitionBusy = false;
+}
+
+
+void refreshConnections() { //MARK: Refresh connections
+    static uint32_t lastDebugPrint = 0;
+    bool connections[MAX_SERVANTS];
+    int connected = 0;
+
+    // Passive check: replies, data and acknowledged deliveries since the last refresh keep a
+    // servant online; only servants that went quiet get a (non-blocking) probe
+    drainRxRing();
+    uint32_t now = halMillis();
+    for (int i = 0; i < peers.count(); i++) {
+        if (liveness.needsProbe(i, now)) {
+            probeServant(i);
+        }
+        connections[i] = liveness.online(i, now);
+        servantOnline[i] = connections[i];
+        if (connections[i]) {
+            connected++;
+        }
+    }
+    numConnections = connected;
+    postConnections(connections);
+
+    // Debug: Print connection status every 10 seconds
+    if (halMillis() - lastDebugPrint > 10000) {
+        lastDebugPrint = halMillis();
+        // One message: the console copies the list as a string argument
+        char states[MAX_SERVANTS * 7 + 1];
+        size_t len = 0;
+        for (int i = 0; i < peers.count(); i++) {
+            len += snprintf(states + len, sizeof(states) - len, " S%d=%s", i+1, connections[i] ? "OK" : "X");
+        }
+        states[len] = '\0';
+        CONSOLE_INFO("Connection Status:%s (Total: %d/%d, probes sent: %lu)\n", states, connected, peers.count(),
+                     (unsigned long)liveness.probes());
+        CONSOLE_INFO("RX Ring: max depth %u/%u, dropped %lu, unknown %lu\n",
+                  (unsigned)rxRing.maxDepth(), (unsigned)rxRing.capacity(),
+                  (unsigned long)rxRing.dropped(), (unsigned long)unknownPackets);
+        const tracker_counters &requests = requestTracker.counters();
+        CONSOLE_INFO("Requests: issued %lu, answered %lu (legacy %lu), expired %lu, late %lu, duplicate %lu\n",
+                  (unsigned long)requests.issued, (unsigned long)requests.accepted, (unsigned long)requests.legacy,
+                  (unsigned long)requests.expired, (unsigned long)requests.late, (unsigned long)requests.duplicate);
+        if (syncSampling) {
+            CONSOLE_INFO("Sync: %lu cycles, last skew %ld ms, max skew %lu ms\n",
+                      (unsigned long)syncCycles, (long)lastSyncSkewMs, (unsigned long)maxSyncSkewMs);
+        }
+        if (streamingMode) {
+            CONSOLE_INFO("Stream: %lu frames logged, %lu lost, %lu duplicate, %lu stray\n",
+                      (unsigned long)streamFrames, (unsigned long)streamLostFrames,
+                      (unsigned long)streamDuplicateFrames, (unsigned long)streamStrayFrames);
+        }
+    }
+}
@@ -0,0 +1,56 @@
+/*
+ * Backlog Ring - TX Master ESP32
+ *
+ * See backlog_ring.h.
+ */
+
+#include <string.h>
+#include "backlog_ring.h"
+
+
+BacklogRing::BacklogRing() : memory(NULL), size(0), start(0), count(0), highWater(0) {
+}
+
+
+void BacklogRing::begin(uint8_t *memory, size_t size) {
+    this->memory = memory;
+    this->size = memory != NULL ? size : 0;
+    start = 0;
+    count = 0;
+    highWater = 0;
+}
+
+
+bool BacklogRing::push(const uint8_t *data, size_t len) {
+    if (len > size - count) {
+        return false;
+    }
+    if (len == 0) {
+        return true;
+    }
+    // The free space may wrap around the end of the memory
+    size_t end = (start + count) % size;
+    size_t first = len < size - end ? len : size - end;
+    memcpy(memory + end, data, first);
+    memcpy(memory, data + first, len - first);
+    count += len;
+    if (count > highWater) {
+        highWater = count;
+    }
+    return true;
+}
+
+
+size_t BacklogRing::peek(const uint8_t **data) const {
+    *data = memory + start;
+    return count < size - start ? count : size - start;
+}
+
+
+void BacklogRing::pop(size_t len) {
+    if (len > count) {
+        len = count;
+    }
+    count -= len;
+    start = count > 0 ? (start + len) % size : 0;
+}
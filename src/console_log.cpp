@@ -0,0 +1,291 @@
+/*
+ * Console Log - TX Master ESP32
+ *
+ * See console_log.h.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <inttypes.h>
+#include "console_log.h"
+#include "hal.h"
+
+ConsoleLog consoleLog;
+
+static const char levelTags[] = {'D', 'I', 'W', 'E'};
+
+
+ConsoleLog::ConsoleLog()
+    : head(0), tail(0), dropCount(0), peakDepth(0), direct(true), reportedDrops(0), printCount(0) {
+    for (uint32_t i = 0; i < CONSOLE_SLOTS; i++) {
+        slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+
+console_message *ConsoleLog::reserve(uint32_t *position) {
+    uint32_t pos = head.load(std::memory_order_relaxed);
+    for (;;) {
+        console_slot &slot = slots[pos & (CONSOLE_SLOTS - 1)];
+        int32_t diff = (int32_t)(slot.sequence.load(std::memory_order_acquire) - pos);
+        if (diff == 0) {
+            if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            dropCount.fetch_add(1, std::memory_order_relaxed);     // Full: the console task is behind
+            return NULL;
+        } else {
+            pos = head.load(std::memory_order_relaxed);             // Another producer took this slot
+        }
+    }
+
+    uint32_t depth = pos + 1 - tail.load(std::memory_order_relaxed);
+    uint32_t peak = peakDepth.load(std::memory_order_relaxed);
+    while (depth > peak && !peakDepth.compare_exchange_weak(peak, depth, std::memory_order_relaxed)) {
+    }
+    *position = pos;
+    return &slots[pos & (CONSOLE_SLOTS - 1)].message;
+}
+
+
+void ConsoleLog::publish(uint32_t position) {
+    slots[position & (CONSOLE_SLOTS - 1)].sequence.store(position + 1, std::memory_order_release);
+}
+
+
+size_t ConsoleLog::drain(size_t max) {
+    size_t count = 0;
+    uint32_t drops = dropCount.load(std::memory_order_relaxed);
+    if (drops != reportedDrops) {
+        char text[64];
+        snprintf(text, sizeof(text), "[console: %lu message(s) dropped]\n", (unsigned long)(drops - reportedDrops));
+        halPrint(text);
+        reportedDrops = drops;
+    }
+
+    while (count < max) {
+        uint32_t pos = tail.load(std::memory_order_relaxed);
+        console_slot &slot = slots[pos & (CONSOLE_SLOTS - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != pos + 1) {
+            break;                          // Empty, or the next message is still being written
+        }
+        print(slot.message);
+        slot.sequence.store(pos + CONSOLE_SLOTS, std::memory_order_release);
+        tail.store(pos + 1, std::memory_order_relaxed);
+        count++;
+    }
+    return count;
+}
+
+
+size_t ConsoleLog::depth() const {
+    return head.load(std::memory_order_relaxed) - tail.load(std::memory_order_relaxed);
+}
+
+
+void ConsoleLog::print(const console_message &message) {
+    char line[CONSOLE_LINE_SIZE + 1];
+    size_t len = format(message, line, sizeof(line) - 1);
+    if (len == 0 || line[len - 1] != '\n') {
+        line[len++] = '\n';
+        line[len] = '\0';
+    }
+    halPrint(line);
+    printCount++;
+}
+
+
+//MARK: Encoding
+void ConsoleLog::begin(console_message *message, uint8_t level, const char *format) {
+    message->timeMs = halMillis();
+    message->format = format;
+    message->level = level;
+    message->argCount = 0;
+    message->used = 0;
+}
+
+
+void ConsoleLog::addNumber(console_message *message, console_arg_type type, const void *value, size_t len) {
+    if (message->argCount >= CONSOLE_MAX_ARGS || message->used + len > CONSOLE_ARG_BYTES) {
+        return;                             // Printed as "?"
+    }
+    memcpy(message->data + message->used, value, len);
+    message->used += len;
+    message->types[message->argCount++] = type;
+}
+
+
+void ConsoleLog::add(console_message *message, const char *value) {
+    if (message->argCount >= CONSOLE_MAX_ARGS || message->used + 1 > CONSOLE_ARG_BYTES) {
+        return;
+    }
+    size_t len = value != NULL ? strnlen(value, 255) : 0;
+    len = len < CONSOLE_ARG_BYTES - message->used - 1u ? len : CONSOLE_ARG_BYTES - message->used - 1u;
+    message->data[message->used] = (uint8_t)len;
+    memcpy(message->data + message->used + 1, value, len);
+    message->used += 1 + len;
+    message->types[message->argCount++] = CONSOLE_ARG_STRING;
+}
+
+
+//MARK: Formatting
+typedef struct console_value {
+    console_arg_type type;
+    int64_t integer;                        // Numbers and pointers, sign- or zero-extended
+    double real;
+    const char *text;                       // CONSOLE_ARG_STRING: not terminated
+    size_t textLen;
+} console_value;
+
+
+static bool nextValue(const console_message &message, int *index, size_t *offset, console_value *value) {
+    if (*index >= message.argCount) {
+        return false;
+    }
+    value->type = (console_arg_type)message.types[(*index)++];
+    const uint8_t *data = message.data + *offset;
+    switch (value->type) {
+    case CONSOLE_ARG_INT: {
+        int32_t v;
+        memcpy(&v, data, 4);
+        value->integer = v;
+        *offset += 4;
+        break;
+    }
+    case CONSOLE_ARG_UINT: {
+        uint32_t v;
+        memcpy(&v, data, 4);
+        value->integer = v;
+        *offset += 4;
+        break;
+    }
+    case CONSOLE_ARG_DOUBLE:
+        memcpy(&value->real, data, 8);
+        *offset += 8;
+        break;
+    case CONSOLE_ARG_STRING:
+        value->textLen = data[0];
+        value->text = (const char *)data + 1;
+        *offset += 1 + value->textLen;
+        break;
+    default:
+        memcpy(&value->integer, data, 8);
+        *offset += 8;
+        break;
+    }
+    return true;
+}
+
+
+// One conversion: the spec as written, the value cast to the type its length modifier asks for
+static int formatValue(char *out, size_t size, const char *spec, const char *length, char conversion,
+                       const console_value &value) {
+    bool isString = value.type == CONSOLE_ARG_STRING;
+    bool isReal = value.type == CONSOLE_ARG_DOUBLE;
+    int64_t integer = isReal ? (int64_t)value.real : value.integer;
+    switch (conversion) {
+    case 'd':
+    case 'i':
+        if (isString) break;
+        if (strcmp(length, "hh") == 0) return snprintf(out, size, spec, (signed char)integer);
+        if (strcmp(length, "h") == 0) return snprintf(out, size, spec, (short)integer);
+        if (strcmp(length, "l") == 0) return snprintf(out, size, spec, (long)integer);
+        if (strcmp(length, "ll") == 0 || strcmp(length, "j") == 0) return snprintf(out, size, spec, (long long)integer);
+        if (strcmp(length, "z") == 0 || strcmp(length, "t") == 0) return snprintf(out, size, spec, (ptrdiff_t)integer);
+        return snprintf(out, size, spec, (int)integer);
+    case 'u':
+    case 'x':
+    case 'X':
+    case 'o':
+        if (isString) break;
+        if (strcmp(length, "hh") == 0) return snprintf(out, size, spec, (unsigned char)integer);
+        if (strcmp(length, "h") == 0) return snprintf(out, size, spec, (unsigned short)integer);
+        if (strcmp(length, "l") == 0) return snprintf(out, size, spec, (unsigned long)integer);
+        if (strcmp(length, "ll") == 0 || strcmp(length, "j") == 0) {
+            return snprintf(out, size, spec, (unsigned long long)integer);
+        }
+        if (strcmp(length, "z") == 0 || strcmp(length, "t") == 0) return snprintf(out, size, spec, (size_t)integer);
+        return snprintf(out, size, spec, (unsigned)integer);
+    case 'c':
+        if (isString) break;
+        return snprintf(out, size, spec, (int)integer);
+    case 'f':
+    case 'F':
+    case 'e':
+    case 'E':
+    case 'g':
+    case 'G':
+    case 'a':
+    case 'A':
+        if (isString) break;
+        return snprintf(out, size, spec, isReal ? value.real : (double)integer);
+    case 'p':
+        if (isString || isReal) break;
+        return snprintf(out, size, spec, (void *)(uintptr_t)integer);
+    case 's': {
+        if (!isString) break;
+        char text[256];
+        memcpy(text, value.text, value.textLen);
+        text[value.textLen] = '\0';
+        return snprintf(out, size, spec, text);
+    }
+    }
+    return snprintf(out, size, "?");        // Argument missing or of another kind
+}
+
+
+size_t ConsoleLog::format(const console_message &message, char *out, size_t size) {
+    if (size == 0) {
+        return 0;
+    }
+    size_t len = 0;
+    int written = snprintf(out, size, "[%6lu.%03lu] %c ", (unsigned long)(message.timeMs / 1000),
+                           (unsigned long)(message.timeMs % 1000), levelTags[message.level & 3]);
+    len = written > 0 ? ((size_t)written < size ? (size_t)written : size - 1) : 0;
+
+    int index = 0;
+    size_t offset = 0;
+    for (const char *p = message.format; *p != '\0' && len + 1 < size; ) {
+        if (*p != '%') {
+            out[len++] = *p++;
+            continue;
+        }
+        if (p[1] == '%') {
+            out[len++] = '%';
+            p += 2;
+            continue;
+        }
+
+        // %[flags][width][.precision][length]conversion; the length modifier is kept apart
+        char spec[24];
+        char length[3] = {};
+        size_t specLen = 0;
+        spec[specLen++] = *p++;
+        while (*p != '\0' && strchr("-+ #0123456789.", *p) != NULL && specLen < sizeof(spec) - 4) {
+            spec[specLen++] = *p++;
+        }
+        size_t lengthLen = 0;
+        while (*p != '\0' && strchr("hljztL", *p) != NULL && lengthLen < 2) {
+            length[lengthLen++] = *p;
+            spec[specLen++] = *p++;
+        }
+        if (*p == '\0') {
+            break;
+        }
+        char conversion = *p++;
+        spec[specLen++] = conversion;
+        spec[specLen] = '\0';
+
+        console_value value = {};
+        written = nextValue(message, &index, &offset, &value)
+                  ? formatValue(out + len, size - len, spec, length, conversion, value)
+                  : snprintf(out + len, size - len, "?");
+        if (written > 0) {
+            len += (size_t)written < size - len ? (size_t)written : size - len - 1;
+        }
+    }
+    out[len] = '\0';
+    return len;
+}
@@ -0,0 +1,100 @@
+/*
+ * Formatter Microbenchmark - TX Master ESP32
+ *
+ * Built only in the tx-master-bench environment (-DFORMAT_BENCHMARK).
+ * Runs once at boot and prints CPU cycles per log record for the former
+ * Arduino String implementation of tempToString() and for the allocation-free
+ * formatter in record_format.cpp, and checks that both produce the same text.
+ */
+
+#ifdef FORMAT_BENCHMARK
+
+#include <Arduino.h>
+#include "record_format.h"
+
+#define BENCH_ITERATIONS        2000
+#define BENCH_TIMESTAMP         "2025-07-30 12:34:56"
+
+
+// The previous implementation, kept verbatim as the baseline
+static String legacyTempToString(const float *t, String timestamp, int serventID) {
+    String data = "";
+    data += timestamp + "," + String(serventID) + ",1," + String(t[0]) + "\n";
+    data += timestamp + "," + String(serventID) + ",2," + String(t[1]) + "\n";
+    data += timestamp + "," + String(serventID) + ",3," + String(t[2]) + "\n";
+    data += timestamp + "," + String(serventID) + ",4," + String(t[3]) + "\n";
+    data += timestamp + "," + String(serventID) + ",5," + String(t[4]) + "\n";
+    data += timestamp + "," + String(serventID) + ",6," + String(t[5]) + "\n";
+    data += timestamp + "," + String(serventID) + ",7," + String(t[6]) + "\n";
+    data += timestamp + "," + String(serventID) + ",8," + String(t[7]) + "\n";
+    data += timestamp + "," + String(serventID) + ",9," + String(t[8]) + "\n";
+    return data;
+}
+
+
+static void printResult(const char *name, uint32_t cycles, uint32_t heapBefore) {
+    uint32_t perRecord = cycles / BENCH_ITERATIONS;
+    Serial.printf("  %-28s %8lu cycles/record  %7.2f us/record  free heap %+ld bytes\n",
+                  name, (unsigned long)perRecord, (float)perRecord / ESP.getCpuFreqMHz(),
+                  (long)ESP.getFreeHeap() - (long)heapBefore);
+}
+
+
+void runFormatBenchmark() {
+    // Typical DS18B20 readings (multiples of 0.0625) plus an error value
+    const float readings[9] = {24.375f, 24.4375f, 24.625f, 24.375f, 24.4375f, 24.5f, 24.5625f, 24.5f, -999.0f};
+    static char text[RECORD_BUFFER_SIZE];
+    size_t sink = 0;
+
+    Serial.println("\n=== FORMAT BENCHMARK ===");
+    Serial.printf("%d records per case, CPU %lu MHz\n", BENCH_ITERATIONS, (unsigned long)ESP.getCpuFreqMHz());
+
+    // Output check: every DS18B20 step between -55 and +125 degC must format identically
+    int mismatches = 0;
+    for (int step = -55 * 16; step <= 125 * 16; step += 9) {
+        float values[9];
+        for (int i = 0; i < 9; i++) {
+            values[i] = (step + i) * 0.0625f;
+        }
+        String expected = legacyTempToString(values, String(BENCH_TIMESTAMP), 1);
+        formatTempRecord(text, sizeof(text), BENCH_TIMESTAMP, 1, values, 9);
+        if (strcmp(expected.c_str(), text) != 0) {
+            mismatches++;
+        }
+    }
+    Serial.printf("  Output check: %d mismatching records\n", mismatches);
+
+    uint32_t heapBefore = ESP.getFreeHeap();
+    uint32_t start = ESP.getCycleCount();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        String data = legacyTempToString(readings, String(BENCH_TIMESTAMP), 1 + i % 4);
+        sink += data.length();
+    }
+    printResult("String tempToString()", ESP.getCycleCount() - start, heapBefore);
+
+    heapBefore = ESP.getFreeHeap();
+    start = ESP.getCycleCount();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        sink += formatTempRecord(text, sizeof(text), BENCH_TIMESTAMP, 1 + i % 4, readings, 9);
+    }
+    printResult("formatTempRecord()", ESP.getCycleCount() - start, heapBefore);
+
+    heapBefore = ESP.getFreeHeap();
+    start = ESP.getCycleCount();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        String data = String(BENCH_TIMESTAMP) + "," + String(1 + i % 4) + ",123456789,NAN\n";
+        sink += data.length();
+    }
+    printResult("String NAN row", ESP.getCycleCount() - start, heapBefore);
+
+    heapBefore = ESP.getFreeHeap();
+    start = ESP.getCycleCount();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        sink += formatNanRecord(text, sizeof(text), BENCH_TIMESTAMP, 1 + i % 4);
+    }
+    printResult("formatNanRecord()", ESP.getCycleCount() - start, heapBefore);
+
+    Serial.printf("  (checksum %lu)\n=== FORMAT BENCHMARK END ===\n\n", (unsigned long)sink);
+}
+
+#endif // FORMAT_BENCHMARK
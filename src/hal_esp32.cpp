@@ -0,0 +1,453 @@
+/*
+ * ESP32 Hardware Abstraction Layer - TX Master ESP32
+ *
+ * See hal.h and hal_esp32.h. Firmware environments only (platformio.ini
+ * leaves this file out of the native build).
+ */
+
+#include <Arduino.h>
+#include <esp_now.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+#include <SD.h>
+#include <SPI.h>
+#include <WiFi.h>
+#include <WiFiUdp.h>
+#include <esp_wifi.h>
+#include <lwip/dns.h>
+#include <lwip/tcpip.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <atomic>
+#include "config.h"
+#include "hal_esp32.h"
+#include "lcd_frame.h"
+
+RTC_DS3231 rtc;
+LiquidCrystal_I2C lcd(LCD_ADDRESS, LCD_COLS, LCD_ROWS);
+
+static SemaphoreHandle_t i2cMutex = NULL;
+static hal_receive_cb receiveCallback = NULL;
+static hal_sent_cb sentCallback = NULL;
+static volatile TaskHandle_t radioWaiter = NULL;   // Task woken by every received packet and failed delivery
+static LcdFrame lcdFrame;
+static uint32_t lastLcdFlush = 0;
+
+#define NET_UDP_LOCAL_PORT      2390        // Source port of the time sync's NTP requests
+
+static WiFiUDP netUdp;
+static bool netUdpOpen = false;
+static volatile int resolveStatus = HAL_NET_FAILED;
+static volatile uint32_t resolvedIp = 0;
+static std::atomic<uint32_t> rtcEdgeMicros(0);     // Timer (low 32 bits) at the last SQW falling edge
+static std::atomic<bool> rtcEdgeSeen(false);
+
+
+void halBegin() {
+    i2cMutex = xSemaphoreCreateRecursiveMutex();
+}
+
+
+void lockI2C() {
+    // Recursive so helpers that read the RTC can be called from inside a locked LCD update
+    if (i2cMutex != NULL) {
+        xSemaphoreTakeRecursive(i2cMutex, portMAX_DELAY);
+    }
+}
+
+void unlockI2C() {
+    if (i2cMutex != NULL) {
+        xSemaphoreGiveRecursive(i2cMutex);
+    }
+}
+
+
+//MARK: Time
+uint32_t halMillis() {
+    return millis();
+}
+
+
+uint32_t halMicros() {
+    return (uint32_t)esp_timer_get_time();
+}
+
+
+void halDelay(uint32_t ms) {
+    delay(ms);
+}
+
+
+uint64_t halUptimeUs() {
+    return (uint64_t)esp_timer_get_time();
+}
+
+
+uint32_t halRtcEpoch() {
+    lockI2C();
+    DateTime now = rtc.now();
+    unlockI2C();
+    return now.unixtime();
+}
+
+
+void halRtcSetEpoch(uint32_t epoch) {
+    lockI2C();
+    rtc.adjust(DateTime(epoch));
+    unlockI2C();
+}
+
+
+static void IRAM_ATTR onRtcSecond() {
+    rtcEdgeMicros.store((uint32_t)esp_timer_get_time(), std::memory_order_relaxed);
+    rtcEdgeSeen.store(true, std::memory_order_relaxed);
+}
+
+
+bool halRtcBeginSquareWave() {
+#if RTC_SQW_PIN >= 0
+    lockI2C();
+    rtc.writeSqwPinMode(DS3231_SquareWave1Hz);
+    unlockI2C();
+    // SQW is open drain; the DS3231 updates its seconds on the falling edge
+    pinMode(RTC_SQW_PIN, INPUT_PULLUP);
+    attachInterrupt(digitalPinToInterrupt(RTC_SQW_PIN), onRtcSecond, FALLING);
+    return true;
+#else
+    return false;
+#endif
+}
+
+
+uint64_t halRtcEdgeUs() {
+    if (!rtcEdgeSeen.load(std::memory_order_relaxed)) {
+        return 0;
+    }
+    // Edge first: an edge between the two loads can then only make the age smaller, never wrap it
+    uint32_t edge = rtcEdgeMicros.load(std::memory_order_relaxed);
+    uint64_t now = (uint64_t)esp_timer_get_time();
+    return now - (uint32_t)((uint32_t)now - edge);
+}
+
+
+//MARK: Radio
+static void onEspNowReceive(const uint8_t *mac, const uint8_t *data, int len) {
+    if (receiveCallback != NULL) {
+        receiveCallback(mac, data, len);
+    }
+    // Runs in the WiFi task, not an ISR. The notification count also covers packets that
+    // arrive while the waiter is busy, so its next halRadioWait() returns at once.
+    TaskHandle_t waiter = radioWaiter;
+    if (waiter != NULL) {
+        xTaskNotifyGive(waiter);
+    }
+}
+
+
+static void onEspNowSent(const uint8_t *mac, esp_now_send_status_t status) {
+    if (sentCallback != NULL) {
+        sentCallback(mac, status == ESP_NOW_SEND_SUCCESS);
+    }
+    // A request that never arrived won't be answered: let the waiter give up on it now
+    TaskHandle_t waiter = radioWaiter;
+    if (status != ESP_NOW_SEND_SUCCESS && waiter != NULL) {
+        xTaskNotifyGive(waiter);
+    }
+}
+
+
+void halRadioSetCallbacks(hal_receive_cb onReceive, hal_sent_cb onSent) {
+    // Called again after every esp_now_init(), which drops the registrations
+    receiveCallback = onReceive;
+    sentCallback = onSent;
+    esp_now_register_send_cb(onEspNowSent);
+    esp_now_register_recv_cb(onEspNowReceive);
+}
+
+
+bool halRadioSend(const uint8_t *mac, const uint8_t *data, size_t len) {
+    return esp_now_send(mac, data, len) == ESP_OK;
+}
+
+
+bool halRadioWait(uint32_t timeoutMs) {
+    radioWaiter = xTaskGetCurrentTaskHandle();
+    // Round up, so the caller's halMillis() deadline has passed when no packet came
+    TickType_t ticks = (timeoutMs + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS;
+    return ulTaskNotifyTake(pdTRUE, ticks) > 0;
+}
+
+
+//MARK: Network
+void halNetConnect(const char *ssid, const char *password) {
+    // Station mode as ESP-NOW set it up; the channel follows the access point until halNetRestore()
+    WiFi.begin(ssid, password);
+}
+
+
+int halNetStatus() {
+    switch (WiFi.status()) {
+    case WL_CONNECTED:
+        return HAL_NET_READY;
+    case WL_NO_SSID_AVAIL:
+    case WL_CONNECT_FAILED:
+        return HAL_NET_FAILED;
+    default:
+        return HAL_NET_PENDING;
+    }
+}
+
+
+static void onDnsFound(const char *name, const ip_addr_t *address, void *arg) {
+    if (address != NULL && IP_IS_V4(address)) {
+        resolvedIp = ip4_addr_get_u32(ip_2_ip4(address));
+        resolveStatus = HAL_NET_READY;
+    } else {
+        resolveStatus = HAL_NET_FAILED;
+    }
+}
+
+
+static void startDnsLookup(void *host) {
+    // lwIP's raw DNS API belongs to its tcpip thread; the answer comes back through onDnsFound
+    ip_addr_t address;
+    err_t result = dns_gethostbyname((const char *)host, &address, onDnsFound, NULL);
+    if (result == ERR_OK) {
+        onDnsFound((const char *)host, &address, NULL);
+    } else if (result != ERR_INPROGRESS) {
+        resolveStatus = HAL_NET_FAILED;
+    }
+}
+
+
+void halNetResolve(const char *host) {
+    // host must stay valid until the lookup is done (the time sync passes its configured server)
+    IPAddress address;
+    if (address.fromString(host)) {
+        resolvedIp = (uint32_t)address;
+        resolveStatus = HAL_NET_READY;
+        return;
+    }
+    resolveStatus = HAL_NET_PENDING;
+    if (tcpip_callback(startDnsLookup, (void *)host) != ERR_OK) {
+        resolveStatus = HAL_NET_FAILED;
+    }
+}
+
+
+int halNetResolveStatus(uint32_t *ip) {
+    int status = resolveStatus;
+    if (status == HAL_NET_READY) {
+        *ip = resolvedIp;
+    }
+    return status;
+}
+
+
+bool halNetSendUdp(uint32_t ip, uint16_t port, const uint8_t *data, size_t len) {
+    if (!netUdpOpen) {
+        netUdpOpen = netUdp.begin(NET_UDP_LOCAL_PORT) == 1;
+        if (!netUdpOpen) {
+            return false;
+        }
+    }
+    return netUdp.beginPacket(IPAddress(ip), port) == 1 && netUdp.write(data, len) == len
+           && netUdp.endPacket() == 1;
+}
+
+
+size_t halNetReceiveUdp(uint8_t *data, size_t len) {
+    if (!netUdpOpen || netUdp.parsePacket() <= 0) {
+        return 0;
+    }
+    int read = netUdp.read(data, len);
+    return read > 0 ? (size_t)read : 0;
+}
+
+
+void halNetRestore() {
+    if (netUdpOpen) {
+        netUdp.stop();
+        netUdpOpen = false;
+    }
+    // Leaves the access point but keeps the WiFi driver, and with it ESP-NOW and its peers, running
+    WiFi.disconnect();
+    esp_wifi_set_channel(ESPNOW_CHANNEL, WIFI_SECOND_CHAN_NONE);
+}
+
+
+//MARK: LCD
+static void sendLcdRun(uint8_t col, uint8_t row, const char *text, size_t len) {
+    lcd.setCursor(col, row);
+    for (size_t i = 0; i < len; i++) {
+        lcd.write((uint8_t)text[i]);
+    }
+}
+
+
+void halLcdWrite(uint8_t col, uint8_t row, const char *text) {
+    lcdFrame.write(col, row, text);
+}
+
+
+void halLcdWriteField(uint8_t col, uint8_t row, uint8_t width, const char *text) {
+    lcdFrame.writeField(col, row, width, text);
+}
+
+
+void halLcdClear() {
+    lcdFrame.clear();
+}
+
+
+void halLcdInvalidate() {
+    lcdFrame.invalidate();
+}
+
+
+void halLcdFlush(bool immediate) {
+    // The I2C bus is only taken when something changed
+    if ((!immediate && halMillis() - lastLcdFlush < LCD_FLUSH_INTERVAL_MS) || !lcdFrame.dirty()) {
+        return;
+    }
+    lastLcdFlush = halMillis();
+    lockI2C();
+    lcdFrame.flush(sendLcdRun);
+    unlockI2C();
+}
+
+
+//MARK: SD card
+bool halStorageRemount() {
+    // The card may have been swapped or lost power
+    SD.end();
+    return SD.begin(CS_PIN, SPI, SD_SPI_FREQUENCY, SD_MOUNT_POINT);
+}
+
+
+bool halFileExists(const char *path) {
+    return SD.exists(path);
+}
+
+
+bool halFileRename(const char *from, const char *to) {
+    return SD.rename(from, to);
+}
+
+
+bool halFileTruncate(const char *path, uint32_t size) {
+    // Not in the Arduino FS API; the VFS path of the card is its mount point plus path
+    char vfsPath[48];
+    snprintf(vfsPath, sizeof(vfsPath), "%s%s", SD_MOUNT_POINT, path);
+    return truncate(vfsPath, size) == 0;
+}
+
+
+bool halMakeDir(const char *path) {
+    return SD.exists(path) || SD.mkdir(path);
+}
+
+
+HalFile::HalFile() {
+}
+
+
+bool HalFile::open(const char *path, int mode) {
+    if (mode == HAL_FILE_UPDATE) {
+        // "r+" doesn't create the file, "w" would truncate it
+        if (!SD.exists(path)) {
+            File created = SD.open(path, FILE_WRITE);
+            if (!created) {
+                return false;
+            }
+            created.close();
+        }
+        file = SD.open(path, "r+");
+    } else {
+        file = SD.open(path, mode == HAL_FILE_APPEND ? FILE_APPEND : FILE_READ);
+    }
+    return (bool)file;
+}
+
+
+void HalFile::close() {
+    file.close();
+}
+
+
+bool HalFile::isOpen() const {
+    return (bool)file;
+}
+
+
+size_t HalFile::read(uint8_t *data, size_t len) {
+    return file.read(data, len);
+}
+
+
+size_t HalFile::write(const uint8_t *data, size_t len) {
+    return file.write(data, len);
+}
+
+
+void HalFile::flush() {
+    file.flush();
+}
+
+
+uint32_t HalFile::size() {
+    return file.size();
+}
+
+
+bool HalFile::seek(uint32_t position) {
+    return file.seek(position);
+}
+
+
+bool HalFile::preallocate(uint32_t length) {
+    // FatFs allocates the cluster chain when a writable file is extended past its end;
+    // the clusters aren't cleared, so this costs only the FAT updates
+    uint32_t position = file.position();
+    uint8_t zero = 0;
+    if (file.size() >= length) {
+        return true;
+    }
+    bool grown = file.seek(length - 1) && file.write(&zero, 1) == 1;
+    file.flush();
+    return file.seek(position) && grown && file.size() >= length;
+}
+
+
+//MARK: System
+uint32_t halFreeHeap() {
+    return ESP.getFreeHeap();
+}
+
+
+uint32_t halMinFreeHeap() {
+    return ESP.getMinFreeHeap();
+}
+
+
+void *halAllocLarge(size_t size) {
+    // Never from the internal heap: the radio and the task stacks need it
+    return heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+}
+
+
+//MARK: Console
+void halPrintf(const char *format, ...) {
+    // Formatted on the stack; longer lines are cut off
+    char text[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    Serial.print(text);
+}
+
+
+void halPrint(const char *text) {
+    Serial.print(text);
+}
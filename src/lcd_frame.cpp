@@ -0,0 +1,96 @@
+/*
+ * LCD Frame - TX Master ESP32
+ *
+ * See lcd_frame.h.
+ */
+
+#include <string.h>
+#include "lcd_frame.h"
+
+// A cursor move costs one command byte, as much as rewriting one unchanged cell,
+// so runs separated by a single unchanged cell are sent as one
+#define LCD_RUN_MERGE_GAP       1
+
+
+LcdFrame::LcdFrame() {
+    memset(&statistics, 0, sizeof(statistics));
+    clear();
+    memset(shown, ' ', sizeof(shown));      // The controller clears its memory on init
+}
+
+
+void LcdFrame::write(uint8_t col, uint8_t row, const char *text) {
+    if (row >= LCD_ROWS) {
+        return;
+    }
+    for (int i = col; i < LCD_COLS && *text != '\0'; i++, text++) {
+        frame[row][i] = *text;
+    }
+}
+
+
+void LcdFrame::writeField(uint8_t col, uint8_t row, uint8_t width, const char *text) {
+    if (row >= LCD_ROWS) {
+        return;
+    }
+    for (int i = col; i < LCD_COLS && i < col + width; i++) {
+        frame[row][i] = *text != '\0' ? *text++ : ' ';
+    }
+}
+
+
+void LcdFrame::clear() {
+    for (int row = 0; row < LCD_ROWS; row++) {
+        memset(frame[row], ' ', LCD_COLS);
+        frame[row][LCD_COLS] = '\0';
+    }
+}
+
+
+void LcdFrame::invalidate() {
+    memset(shown, 0, sizeof(shown));
+}
+
+
+bool LcdFrame::dirty() const {
+    for (int row = 0; row < LCD_ROWS; row++) {
+        if (memcmp(frame[row], shown[row], LCD_COLS) != 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+size_t LcdFrame::flush(lcd_run_writer writer) {
+    size_t sent = 0;
+    for (int row = 0; row < LCD_ROWS; row++) {
+        int col = 0;
+        while (col < LCD_COLS) {
+            if (frame[row][col] == shown[row][col]) {
+                col++;
+                continue;
+            }
+
+            // Extend the run over later changes that are at most LCD_RUN_MERGE_GAP cells apart
+            int start = col;
+            int end = col + 1;
+            for (int next = end; next < LCD_COLS && next <= end + LCD_RUN_MERGE_GAP; next++) {
+                if (frame[row][next] != shown[row][next]) {
+                    end = next + 1;
+                }
+            }
+
+            writer(start, row, &frame[row][start], end - start);
+            memcpy(&shown[row][start], &frame[row][start], end - start);
+            statistics.runs++;
+            statistics.cells += end - start;
+            sent += end - start;
+            col = end;
+        }
+    }
+    if (sent > 0) {
+        statistics.flushes++;
+    }
+    return sent;
+}
@@ -0,0 +1,58 @@
+/*
+ * Liveness Tracker - TX Master ESP32
+ *
+ * See liveness_tracker.h.
+ */
+
+#include "liveness_tracker.h"
+
+
+LivenessTracker::LivenessTracker() : probeCount(0) {
+    for (int i = 0; i < MAX_SERVANTS; i++) {
+        lastSeenMs[i].store(0, std::memory_order_relaxed);
+        seen[i].store(false, std::memory_order_relaxed);
+        lastProbeMs[i] = 0;
+        probedOnce[i] = false;
+    }
+}
+
+
+void LivenessTracker::heard(int servant, uint32_t nowMs) {
+    lastSeenMs[servant].store(nowMs, std::memory_order_relaxed);
+    seen[servant].store(true, std::memory_order_release);
+}
+
+
+void LivenessTracker::delivered(int servant, uint32_t nowMs) {
+    heard(servant, nowMs);
+}
+
+
+uint32_t LivenessTracker::silenceMs(int servant, uint32_t nowMs) const {
+    if (!seen[servant].load(std::memory_order_acquire)) {
+        return UINT32_MAX;
+    }
+    uint32_t lastMs = lastSeenMs[servant].load(std::memory_order_relaxed);
+    // The WiFi task may record a time slightly newer than the caller's nowMs
+    return (int32_t)(nowMs - lastMs) > 0 ? nowMs - lastMs : 0;
+}
+
+
+bool LivenessTracker::online(int servant, uint32_t nowMs) const {
+    return silenceMs(servant, nowMs) < LIVENESS_TIMEOUT_MS;
+}
+
+
+bool LivenessTracker::needsProbe(int servant, uint32_t nowMs) const {
+    if (silenceMs(servant, nowMs) < PROBE_AFTER_MS) {
+        return false;
+    }
+    return !probedOnce[servant] || nowMs - lastProbeMs[servant] >= PROBE_INTERVAL_MS;
+}
+
+
+void LivenessTracker::probed(int servant, uint32_t nowMs) {
+    lastProbeMs[servant] = nowMs;
+    probedOnce[servant] = true;
+    probeCount++;
+}
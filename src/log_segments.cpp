@@ -0,0 +1,179 @@
+/*
+ * Log Segments - TX Master ESP32
+ *
+ * See log_segments.h. Storage task only.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "log_segments.h"
+#include "hal.h"
+
+#define MANIFEST_HEADER         "segment,file,first_epoch,last_epoch,bytes\n"
+#define MANIFEST_HEADER_LEN     (sizeof(MANIFEST_HEADER) - 1)
+#define MANIFEST_ROW_LEN        (LOG_SEGMENT_PATH_SIZE + 38)   // "0001," path ",0000000000" x3 "\n"
+#define SEGMENT_DAY_OFFSET      (sizeof(LOG_DIR))               // Position of "20250729" in a segment path
+#define MAX_SEGMENTS_PER_DAY    999
+
+
+static uint32_t rowOffset(uint16_t number) {
+    return MANIFEST_HEADER_LEN + (uint32_t)(number - 1) * MANIFEST_ROW_LEN;
+}
+
+
+LogSegments::LogSegments() : rows(0) {
+    extension[0] = '\0';
+    memset(&current, 0, sizeof(current));
+}
+
+
+bool LogSegments::begin(const char *extension) {
+    strncpy(this->extension, extension, sizeof(this->extension) - 1);
+    this->extension[sizeof(this->extension) - 1] = '\0';
+    memset(&current, 0, sizeof(current));
+    rows = 0;
+
+    HalFile manifest;
+    if (!halMakeDir(LOG_DIR) || !manifest.open(LOG_MANIFEST_FILENAME, HAL_FILE_UPDATE)) {
+        return false;
+    }
+    uint32_t size = manifest.size();
+    if (size < MANIFEST_HEADER_LEN) {
+        // New manifest, or its header was cut short by a power loss: start the list over
+        bool written = manifest.seek(0)
+            && manifest.write((const uint8_t *)MANIFEST_HEADER, MANIFEST_HEADER_LEN) == MANIFEST_HEADER_LEN;
+        manifest.flush();
+        manifest.close();
+        return written;
+    }
+
+    // A partial last row (power loss while it was written) is overwritten by the next add()
+    rows = (uint16_t)((size - MANIFEST_HEADER_LEN) / MANIFEST_ROW_LEN);
+    char row[MANIFEST_ROW_LEN + 1] = {};
+    bool readRow = rows > 0 && manifest.seek(rowOffset(rows))
+                   && manifest.read((uint8_t *)row, MANIFEST_ROW_LEN) == MANIFEST_ROW_LEN;
+    manifest.close();
+    if (!readRow) {
+        return true;
+    }
+
+    // Continue in the last segment if it is still there and has the same format
+    unsigned number;
+    unsigned long firstEpoch, lastEpoch, bytes;
+    char path[32];
+    size_t pathLen = SEGMENT_DAY_OFFSET + 12 + strlen(extension);     // "20250729-001" after the directory
+    if (sscanf(row, "%u,%31[^,],%lu,%lu,%lu", &number, path, &firstEpoch, &lastEpoch, &bytes) == 5
+        && number == rows && strlen(path) == pathLen && strcmp(path + pathLen - strlen(extension), extension) == 0
+        && halFileExists(path)) {
+        current.number = (uint16_t)number;
+        memcpy(current.path, path, pathLen + 1);
+        current.firstEpoch = firstEpoch;
+        current.lastEpoch = lastEpoch;
+        current.bytes = bytes;
+    }
+    return true;
+}
+
+
+bool LogSegments::needsNew(uint32_t epoch, uint32_t length, size_t len) const {
+    if (!hasCurrent()) {
+        return true;
+    }
+    if (current.firstEpoch != 0 && epoch / 86400 != current.firstEpoch / 86400) {
+        return true;
+    }
+    return length + len > LOG_SEGMENT_SIZE;
+}
+
+
+bool LogSegments::add(uint32_t epoch) {
+    char day[9];
+    time_t seconds = (time_t)epoch;
+    struct tm fields;
+    gmtime_r(&seconds, &fields);
+    strftime(day, sizeof(day), "%Y%m%d", &fields);
+
+    // Numbered on from the current segment if it started the same day
+    int next = 1;
+    if (hasCurrent() && strncmp(current.path + SEGMENT_DAY_OFFSET, day, 8) == 0) {
+        next = atoi(current.path + SEGMENT_DAY_OFFSET + 9) + 1;
+    }
+
+    log_segment segment = {};
+    for (;; next++) {
+        if (next > MAX_SEGMENTS_PER_DAY) {
+            return false;
+        }
+        char path[32];
+        snprintf(path, sizeof(path), "%s/%s-%03d%s", LOG_DIR, day, next, extension);
+        if (!halFileExists(path)) {
+            memcpy(segment.path, path, sizeof(segment.path) - 1);
+            break;
+        }
+    }
+
+    // The current segment stays if the manifest can't be written
+    log_segment previous = current;
+    uint16_t previousRows = rows;
+    segment.number = rows + 1;
+    current = segment;
+    rows = segment.number;
+    if (!writeRow()) {
+        current = previous;
+        rows = previousRows;
+        return false;
+    }
+    return true;
+}
+
+
+void LogSegments::noteRecord(uint32_t epoch) {
+    if (current.firstEpoch == 0) {
+        current.firstEpoch = epoch;
+    }
+    current.lastEpoch = epoch;
+}
+
+
+bool LogSegments::update(uint32_t bytes) {
+    if (!hasCurrent()) {
+        return false;
+    }
+    current.bytes = bytes;
+    return writeRow();
+}
+
+
+bool LogSegments::writeRow() {
+    HalFile manifest;
+    if (!manifest.open(LOG_MANIFEST_FILENAME, HAL_FILE_UPDATE)) {
+        return false;
+    }
+    uint32_t size = manifest.size();
+    if (size < MANIFEST_HEADER_LEN) {
+        if (!manifest.seek(0)
+            || manifest.write((const uint8_t *)MANIFEST_HEADER, MANIFEST_HEADER_LEN) != MANIFEST_HEADER_LEN) {
+            manifest.close();
+            return false;
+        }
+        size = MANIFEST_HEADER_LEN;
+    }
+
+    // A manifest with fewer rows is a new one (card swapped): list the segment after its last row
+    uint16_t listed = (uint16_t)((size - MANIFEST_HEADER_LEN) / MANIFEST_ROW_LEN);
+    if (current.number > listed + 1) {
+        current.number = listed + 1;
+        rows = current.number;
+    }
+
+    char row[MANIFEST_ROW_LEN + 16];
+    snprintf(row, sizeof(row), "%04u,%s,%010lu,%010lu,%010lu\n", (unsigned)current.number, current.path,
+             (unsigned long)current.firstEpoch, (unsigned long)current.lastEpoch, (unsigned long)current.bytes);
+    bool written = strlen(row) == MANIFEST_ROW_LEN && manifest.seek(rowOffset(current.number))
+                   && manifest.write((const uint8_t *)row, MANIFEST_ROW_LEN) == MANIFEST_ROW_LEN;
+    manifest.flush();
+    manifest.close();
+    return written;
+}
@@ -0,0 +1,313 @@
+/*
+ * Log Storage - TX Master ESP32
+ *
+ * See log_storage.h. Storage task only, so the static buffers need no locking.
+ */
+
+#include <math.h>
+#include <string.h>
+#include <stdio.h>
+#include <algorithm>
+#include "log_storage.h"
+#include "binlog_format.h"
+#include "record_format.h"
+#include "metrics.h"
+#include "console_log.h"
+#include "hal.h"
+
+SdLogger sdLogger;
+volatile bool storageError = false;
+LogSegments logSegments;
+SampleJournal sampleJournal;
+
+static bool binaryFormat = false;
+static bool segmented = false;
+static char logHeader[96];                  // File header of the log format, written to every new file
+static uint32_t appendedSeq = 0;            // Journal entry of the last record handed to the logger
+
+
+static void retireOldBinaryLog(const char *path) { //MARK: Retire old binary log
+    // Records of a different format version can't be appended to the same file; move the
+    // old file aside (binlog2csv still reads it) instead of mixing layouts or deleting data
+    HalFile file;
+    if (!file.open(path, HAL_FILE_READ)) {
+        return;
+    }
+    binlog_header header;
+    size_t len = file.read((uint8_t *)&header, sizeof(header));
+    file.close();
+    if (len < sizeof(header) || memcmp(header.magic, BINLOG_MAGIC, sizeof(header.magic)) != 0
+        || header.version == BINLOG_VERSION) {
+        return;
+    }
+
+    char retiredName[32];
+    snprintf(retiredName, sizeof(retiredName), "%s.v%u", path, header.version);
+    for (int i = 1; halFileExists(retiredName) && i < 100; i++) {
+        snprintf(retiredName, sizeof(retiredName), "%s.v%u.%d", path, header.version, i);
+    }
+    if (halFileRename(path, retiredName)) {
+        CONSOLE_INFO("Old Log Format:\t\t\t\tMoved to %s\n", retiredName);
+    } else {
+        CONSOLE_WARN("Old Log Format:\t\t\t\tRename failed\n");
+    }
+}
+
+
+static size_t buildHeader(bool binary, uint32_t createdEpoch) {
+    if (!binary) {
+        memcpy(logHeader, CSV_HEADER "\n", strlen(CSV_HEADER "\n"));
+        return strlen(CSV_HEADER "\n");
+    }
+
+    binlog_header header = {};
+    memcpy(header.magic, BINLOG_MAGIC, sizeof(header.magic));
+    header.version = BINLOG_VERSION;
+    header.headerSize = sizeof(binlog_header);
+    header.recordSize = sizeof(binlog_record);
+    header.sensorCount = BINLOG_MAX_SENSORS;
+    header.valueType = BINLOG_VALUE_FLOAT32;
+    header.createdEpoch = createdEpoch;
+    strncpy(header.deviceId, MASTER_DEVICE_ID, sizeof(header.deviceId));
+    strncpy(header.firmware, FIRMWARE_VERSION, sizeof(header.firmware));
+    memcpy(logHeader, &header, sizeof(header));
+    return sizeof(header);
+}
+
+
+bool openLogFile(const char *path, bool binary, uint32_t createdEpoch) {
+    // The log file stays open from here on; the header is added if the file is empty
+    binaryFormat = binary;
+    segmented = false;
+    size_t headerLen = buildHeader(binary, createdEpoch);
+    if (binary) {
+        retireOldBinaryLog(path);
+    }
+    return sdLogger.begin(path, logHeader, headerLen);
+}
+
+
+static bool startSegment(uint32_t epoch) { //MARK: Start segment
+    // Finish the current segment first: data synced, final manifest row, unused space cut off.
+    // While its data can't be written, or the SD backlog isn't written out yet, the records
+    // stay in the current segment.
+    char finished[LOG_SEGMENT_PATH_SIZE] = "";
+    uint32_t finishedBytes = 0;
+    if (logSegments.hasCurrent()) {
+        // An ended logger has synced everything and is closed already
+        if (!sdLogger.isEnded()
+            && (!sdLogger.isOpen() || !sdLogger.sync() || sdLogger.length() != sdLogger.syncedLength())) {
+            return false;
+        }
+        finishedBytes = sdLogger.syncedLength();
+        logSegments.update(finishedBytes);
+        strcpy(finished, logSegments.segment().path);
+    }
+
+    if (!logSegments.add(epoch)) {
+        CONSOLE_WARN("Log Segment:\t\t\t\tManifest write failed\n");
+        return false;
+    }
+    bool opened = sdLogger.begin(logSegments.segment().path, logHeader, buildHeader(binaryFormat, epoch),
+                                 LOG_SEGMENT_SIZE, 0);
+    if (finished[0] != '\0' && !halFileTruncate(finished, finishedBytes)) {
+        CONSOLE_WARN("Log Segment:\t\t\t\tCould not trim %s\n", finished);
+    }
+    CONSOLE_INFO("Log Segment:\t\t\t\t%s%s\n", logSegments.segment().path, opened ? "" : " (open failed)");
+    return opened;
+}
+
+
+bool openSegmentedLog(bool binary, uint32_t createdEpoch) {
+    binaryFormat = binary;
+    segmented = true;
+    if (!logSegments.begin(binary ? ".bin" : ".csv")) {
+        return false;
+    }
+    if (!logSegments.hasCurrent()) {
+        return startSegment(createdEpoch);
+    }
+
+    // Continue where the last sync left the segment; the first record decides whether it is still current.
+    // After a power loss the file is still pre-allocated and holds old card data past the synced length;
+    // a CSV file can't tell its reader where its rows end, so it is cut there first
+    const log_segment &segment = logSegments.segment();
+    if (!halFileTruncate(segment.path, segment.bytes)) {
+        CONSOLE_WARN("Log Segment:\t\t\t\tCould not trim %s\n", segment.path);
+    }
+    return sdLogger.begin(segment.path, logHeader, buildHeader(binary, createdEpoch), LOG_SEGMENT_SIZE,
+                          segment.bytes);
+}
+
+
+static void writeToSD(uint32_t epoch, const void *data, size_t len) { //MARK: Write to SD
+    // The logger keeps the file open and commits whole 512-byte blocks; a failed
+    // write stays buffered and the logger remounts the card on its next commit
+    if (segmented) {
+        if (logSegments.needsNew(epoch, sdLogger.length(), len)) {
+            startSegment(epoch);
+        }
+        logSegments.noteRecord(epoch);
+    }
+    if (sdLogger.isEnded()) {
+        sdLogger.resume();                  // Logging started again; a failure is handled like a missing card
+    }
+
+    if (!sdLogger.append((const char *)data, len) || !sdLogger.isOpen()) {
+        if (!storageError) {
+            CONSOLE_WARN("SD Card not available for writing - data kept in buffer\n");
+            reportError("SD Card unavailable", 2);
+        }
+        storageError = true;
+    } else {
+        storageError = false;
+    }
+}
+
+
+static void writeBinaryRecord(const log_record &record) {
+    // Fixed part followed by only the readings the servant reported (none without data)
+    static uint8_t entry[sizeof(binlog_record) + BINLOG_MAX_SENSORS * sizeof(float)];
+    binlog_record fixed = {};
+    fixed.epoch = record.epoch;
+    fixed.millis = record.millis >= 0 ? record.millis : 0;
+    fixed.servantID = record.servantID;
+    bool hasData = record.valid && record.data.count > 0;
+    fixed.flags = hasData ? 0 : BINLOG_FLAG_NO_DATA;
+    if (record.millis >= 0) {
+        fixed.flags |= BINLOG_FLAG_HAS_MILLIS;
+    }
+    fixed.sensorCount = hasData ? std::min(record.data.count, BINLOG_MAX_SENSORS) : 0;
+
+    memcpy(entry, &fixed, sizeof(fixed));
+    memcpy(entry + sizeof(fixed), record.data.sens, fixed.sensorCount * sizeof(float));
+    writeToSD(record.epoch, entry, sizeof(fixed) + fixed.sensorCount * sizeof(float));
+}
+
+
+static void writeCsvRecord(const log_record &record) {
+    // Formatted into a static buffer: no heap allocation per record
+    static char text[RECORD_BUFFER_SIZE];
+    char recordTimestamp[RECORD_TIMESTAMP_SIZE];
+    formatTimestamp(recordTimestamp, sizeof(recordTimestamp), record.epoch, record.millis);
+
+    // A reply without readings gets the NAN row like a missing one: no servant is left without a row
+    size_t len;
+    if (record.valid && record.data.count > 0) {
+        len = formatTempRecord(text, sizeof(text), recordTimestamp, record.servantID,
+                               record.data.sens, record.data.count);
+    } else {
+        len = formatNanRecord(text, sizeof(text), recordTimestamp, record.servantID);
+    }
+
+    CONSOLE_DEBUG("Data to write: %s\n", text);
+    writeToSD(record.epoch, text, len);
+}
+
+
+void writeLogRecord(const log_record &record) {
+    // A segment change syncs the previous records before this one is appended
+    uint32_t syncs = sdLogger.stats().syncs;
+    if (binaryFormat) {
+        writeBinaryRecord(record);
+    } else {
+        writeCsvRecord(record);
+    }
+    if (sdLogger.stats().syncs != syncs) {
+        sampleJournal.release(appendedSeq);
+    }
+    if (record.journalSeq != 0) {
+        appendedSeq = record.journalSeq;
+    }
+}
+
+
+static void afterSync(uint32_t syncsBefore) {
+    // The manifest first: a record may only leave the journal once a restart finds it on the card
+    if (segmented && logSegments.hasCurrent() && sdLogger.syncedLength() != logSegments.segment().bytes) {
+        logSegments.update(sdLogger.syncedLength());
+    }
+    if (sdLogger.stats().syncs != syncsBefore && sdLogger.length() == sdLogger.syncedLength()) {
+        sampleJournal.release(appendedSeq);
+    }
+}
+
+
+void pollLogFile() {
+    uint32_t syncs = sdLogger.stats().syncs;
+    sdLogger.poll();
+    if (sampleJournal.used() * 100 >= sampleJournal.capacity() * JOURNAL_SYNC_PERCENT
+        && halMillis() - sdLogger.lastSyncMs() >= JOURNAL_SYNC_MIN_MS
+        && sdLogger.length() != sdLogger.syncedLength()) {
+        sdLogger.sync();
+    }
+    afterSync(syncs);
+}
+
+
+bool syncLogFile() {
+    uint32_t syncs = sdLogger.stats().syncs;
+    bool synced = sdLogger.sync();
+    afterSync(syncs);
+    return synced;
+}
+
+
+bool closeLogFile() {
+    if (sdLogger.isEnded() && !sdLogger.needsTrim()) {
+        return true;
+    }
+    // Synced through the manifest and journal first, so end() only closes and trims
+    return syncLogFile() && sdLogger.end();
+}
+
+
+uint32_t replayLogJournal() { //MARK: Replay journal
+    uint32_t replayed = 0;
+    uint32_t position = sampleJournal.start();
+    log_record record;
+    while (sampleJournal.next(&position, &record)) {
+        writeLogRecord(record);
+        replayed++;
+    }
+    // Entries after a damaged one can't be read; once the rest is on the card they are dropped
+    if (syncLogFile()) {
+        sampleJournal.discard();
+    }
+    metrics.journalReplayed.add(replayed);
+    return replayed;
+}
+
+
+void printStorageStats() {
+    const sd_logger_stats &stats = sdLogger.stats();
+    uint32_t avgWriteUs = stats.commits > 0 ? (uint32_t)(stats.totalWriteUs / stats.commits) : 0;
+    CONSOLE_INFO("SD Writer: %llu bytes in %lu block writes (last %lu us, avg %lu us, max %lu us), "
+                 "%lu syncs (last %lu us, max %lu us), %u bytes buffered, %u bytes in backlog (peak %u), %lu failures, "
+                 "%lu bytes dropped\n",
+                 (unsigned long long)stats.bytesWritten, (unsigned long)stats.commits,
+                 (unsigned long)stats.lastWriteUs, (unsigned long)avgWriteUs, (unsigned long)stats.maxWriteUs,
+                 (unsigned long)stats.syncs, (unsigned long)stats.lastSyncUs, (unsigned long)stats.maxSyncUs,
+                 (unsigned)sdLogger.buffered(), (unsigned)sdLogger.backlogUsed(), (unsigned)sdLogger.backlogPeak(),
+                 (unsigned long)stats.failures, (unsigned long)stats.droppedBytes);
+}
+
+
+bool writeMetricsLog(uint32_t epoch) { //MARK: Write metrics log
+    // Opened and closed per dump: a few KB every few minutes, next to the log file that stays open
+    static char text[METRICS_TEXT_SIZE];
+    char heading[RECORD_TIMESTAMP_SIZE + 8];
+    char recordTimestamp[RECORD_TIMESTAMP_SIZE];
+    formatTimestamp(recordTimestamp, sizeof(recordTimestamp), epoch, -1);
+    int headingLen = snprintf(heading, sizeof(heading), "=== %s\n", recordTimestamp);
+    size_t len = formatMetrics(text, sizeof(text));
+
+    HalFile file;
+    if (!file.open(METRICS_FILENAME, HAL_FILE_APPEND)) {
+        return false;
+    }
+    bool written = file.write((const uint8_t *)heading, headingLen) == (size_t)headingLen
+                   && file.write((const uint8_t *)text, len) == len;
+    file.close();
+    return written;
+}
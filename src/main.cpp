@@ -8,7 +8,7 @@
  * Provides synchronized temperature reference data for aerial thermal imaging validation
  * 
  * Enhancements include:
- * - WiFi connectivity and NTP time synchronization (temporarily disabled for stability)
+ * - WiFi connectivity and NTP time synchronization in the background while not logging
  * - Watchdog timer for system reliability
  * - Improved error handling and recovery
  * - Robust SD card and RTC operations
@@ -27,133 +27,158 @@
 // ✅ FIXED: Flexible logging system works with 1-4 servants (partial connectivity)
 // ✅ FIXED: Enhanced debug output for connection status and data retrieval
 // ✅ FIXED: Timeout handling and proper NAN logging for disconnected servants
+// ✅ FIXED: Display and LED no longer freeze during temperature requests (radio, SD and UI run in separate tasks)
+// ✅ FIXED: Display temperature values not completely overwritten when digit count changes (fixed-width LCD fields)
 
 // Known Issues - Pending Resolution
 // TODO: Occasionally logging timer shows incorrect values (42947XXX seconds) - rare occurrence
-// TODO: Display temperature values not completely overwritten when digit count changes
-// TODO: Display and LED briefly freeze during temperature request ("Updating Temperature")
 // TODO: Status LED occasionally shows brief "No connection" even when connected
 // TODO: Display retains last temperature values when connection is lost (should show "--" or similar)
 
 // System Architecture Notes
-// - WiFi/NTP temporarily disabled to prevent watchdog timeouts during deployment
-// - ESP-NOW communication on WiFi Channel 1 for servant coordination
-// - Master-servant topology supports up to 4 GCT units with 9 sensors each
+// - ESP-NOW communication on WiFi Channel 1 (ESPNOW_CHANNEL) for servant coordination
+// - The RTC is set over NTP by a non-blocking state machine in the acquisition task (time_sync.h). It only
+//   runs while not logging, since joining the access point takes the radio off the ESP-NOW channel; logging
+//   aborts it and gets the radio back at once. Boot no longer waits for WiFi
+// - Master-servant topology supports up to 19 GCT units with a variable number of sensors each, up to
+//   MAX_SENSORS (servant table from /peers.txt or NVS, LCD pages through the units four at a time)
 // - Real-time status monitoring via LCD display and LED indicators
 // - Button-controlled logging for synchronized data collection during drone flights
+// - FreeRTOS task split: ESP-NOW acquisition on core 0, SD writer and LCD/LED/button on core 1,
+//   connected only through bounded queues so a slow SD write or I2C transfer never delays the radio
+// - Records are journaled in RTC memory (sample_journal.h) until a log sync has put them on the card;
+//   after a watchdog or panic reset the journal is written to the log again before acquisition starts
+// - While the SD card is missing or busy, log data waits in a PSRAM backlog (sd_logger.h) and is written
+//   out in bulk once the card is back, so a card swap neither loses records nor stalls the storage task
+// - The LCD is drawn into a shadow frame (lcd_frame.h); only changed cells go over I2C, at most every
+//   LCD_FLUSH_INTERVAL_MS, which keeps the bus shared with the DS3231 free
+// - ESP-NOW packets pass through a lock-free ring (rx_ring.h): OnDataRecv only enqueues,
+//   the acquisition task decodes and files replies per sender MAC and request sequence number.
+//   Each received packet also wakes the acquisition task (halRadioWait), which sleeps while it
+//   waits for replies instead of polling the ring
+// - Reply timeouts adapt per servant to its measured round trip time (rtt_estimator.h), with
+//   sendTimeout as the upper limit; a request OnDataSent reports as undelivered is given up at once
+// - Timestamps come from a ms timebase (timebase.h) anchored once a minute on a DS3231 second edge
+//   (SQW on RTC_SQW_PIN) and extrapolated from the microsecond timer with measured drift correction,
+//   so neither the clock on the LCD nor the log records read the RTC over I2C
+// - The log is split into daily segment files in /log, pre-allocated so appends never extend the FAT
+//   chain, and listed with their time ranges in /log/manifest.csv (log_segments.h)
+// - Status messages from the tasks and callbacks go into a binary ring (console_log.h) and are formatted
+//   and printed by a console task at the lowest priority; debug messages only exist in debug builds
+// - Acquisition (acquisition.cpp) and log storage (log_storage.cpp) reach the hardware only through
+//   hal.h, so they also build on the PC against simulated servants (pio run -e native)
 
 
 
 #include <esp_now.h>
 #include <WiFi.h>
 #include <esp_wifi.h>
-#include <RTClib.h>
 #include <FS.h>
 #include <SD.h>
 #include <SPI.h>
-#include <LiquidCrystal_I2C.h>
-#include <Adafruit_NeoPixel.h>
 #include <time.h>
 #include <HTTPClient.h>
 #include <ArduinoJson.h>
 #include <esp_task_wdt.h>
 #include <WiFiUdp.h>
+#include <Preferences.h>
+#include "config.h"
+#include "hal_esp32.h"
+#include "acquisition.h"
+#include "log_storage.h"
+#include "record_format.h"
+#include "metrics.h"
+#include "lcd_frame.h"
+#include "status_led.h"
+#include "time_sync.h"
+#include "timebase.h"
+#include "console_log.h"
+
+#ifdef FORMAT_BENCHMARK
+void runFormatBenchmark();  // src/format_bench.cpp, tx-master-bench environment only
+#endif
 
 //User variables
-int sendTimeout         = 1000;     //Timeout for waiting for a servent response data in ms
+int sendTimeout         = 1000;     //Longest wait for a servant response in ms; below it the timeout follows the measured round trip time
 int logIntervall        = 10000;    //Log intervall in ms (>= 10000 ms = 10s)
 int pingCheckIntervall  = 2000;     //Ping check intervall in ms (increased from 1000 to reduce interference)
 int tempUpdateIntervall = 10000;    //Temperature update intervall in ms
-
-// WiFi and NTP configuration
-const char* ssid = "VodafoneMobileWiFi-A8E1";        // Replace with your WiFi network name
-const char* password = "I5IJ4ij4"; // Replace with your WiFi password
-const char* ntpServer = "time.google.com";  // Changed to Google's NTP (more reliable than pool.ntp.org)
-const long gmtOffset_sec = 3600;            // GMT+1 for Amsterdam (CET)
-const int daylightOffset_sec = 3600;        // +1 hour for summer time (CEST)
-
-// Time management configuration
-const unsigned long NTP_RETRY_INTERVAL = 3600000;    // Retry NTP sync every hour (3600000ms)
+bool fanOutPolling      = true;     //Request data from all servants at once and collect replies within each servant's own timeout
+bool binaryLogging      = false;    //Log compact binary records to BIN_FILENAME instead of CSV (convert with tools/binlog2csv)
+bool segmentedLogging   = true;     //Log into daily, pre-allocated segment files in LOG_DIR (listed in LOG_MANIFEST_FILENAME) instead of one growing file
+bool acceptLegacyReplies = true;    //Accept replies from servants without the v2 protocol header, matched by MAC only
+bool streamingMode      = false;    //While logging, servants push their frames (2002) instead of being polled (requires v2 servants)
+int streamPeriodMs      = 1000;     //Push period requested from the servants in streaming mode in ms (>= STREAM_MIN_PERIOD_MS)
+bool syncSampling       = false;    //Poll with one broadcast sync beacon (1006) so all servants sample at the same instant (requires v2 servants)
+int metricsLogMinutes   = 0;        //Append the metrics registry to METRICS_FILENAME every N minutes (0 = off; "metrics" on Serial always works)
+
+// NTP port (network, server and time zone: WIFI_* and NTP_* in config.h)
+uint16_t ntpPort = NTP_PORT;                // Port of tools/ntp_responder when testing without internet
+
+// Time management configuration (sync interval and timeouts: NTP_* in config.h)
 const unsigned long RTC_VALIDITY_CHECK = 86400000;   // Check RTC validity every 24 hours
-unsigned long lastNTPSync = 0;                       // Timestamp of last successful NTP sync
 unsigned long lastRTCCheck = 0;                      // Timestamp of last RTC validity check
-bool ntpSyncSuccessful = false;                      // Flag to track if NTP ever succeeded
-
-// structure to send data
-typedef struct struct_message {
-    int actionID;
-    float value;
-} struct_message;
-struct_message TXdata;
-
-
-typedef struct temp {
-    int actionID;
-    float sens1;
-    float sens2;
-    float sens3;
-    float sens4;
-    float sens5;
-    float sens6;
-    float sens7;
-    float sens8;
-    float sens9;
-} temp;
-temp RXData;
+
 
 // system variables
-volatile bool messageReceived   = false;
-volatile int receivedActionID   = 0;
-int numConnections              = 0;
-int timeLeft                    = 0;
-char timestamp[19];
-char fileName[24];
+volatile int timeLeft           = 0;
+char timestamp[20];
 bool connectionStatus           = false;
-bool logState                   = false;
+volatile bool logState          = false;
 esp_err_t lastSendStatus        = ESP_FAIL;
-temp receivedData;
-File file;
-
-// Connection state tracking
-unsigned long lastConnectionCheck[4] = {0, 0, 0, 0};
-bool deviceOnline[4] = {false, false, false, false};
-const unsigned long CONNECTION_TIMEOUT = 5000; // 5 seconds
-
-// Pin definitions
-#define CS_PIN 5
-#define LED_PIN 4
-#define BUTTON_PIN 0
-
-
-Adafruit_NeoPixel strip(1, LED_PIN, NEO_GRB + NEO_KHZ800);  // Create an instance of the Adafruit_NeoPixel class
 
-uint8_t broadcastAddresses[][6] = {
-    {0x48, 0xE7, 0x29, 0x8C, 0x79, 0x68},  // Servant 1 (COM13) - GCT1
-    {0x48, 0xE7, 0x29, 0x8C, 0x73, 0x18},  // Servant 2 (COM15) - GCT2
-    {0x4C, 0x11, 0xAE, 0x65, 0xBD, 0x54},  // Servant 3 (COM16) - GCT3
-    {0x48, 0xE7, 0x29, 0x8C, 0x72, 0x50}   // Servant 4 (unknown) - GCT4
+// Pin definitions: see config.h (CS_PIN, LED_PIN, BUTTON_PIN)
+
+// Display updates posted to the UI task, the only task that talks to the LCD after setup()
+typedef enum {
+    UI_TEMP,                // Average temperature of one servant (row 2)
+    UI_CONNECTIONS,         // Connection tick marks of all servants (row 1)
+    UI_TEXT,                // Free text at a given position
+    UI_ERROR                // Fatal error screen
+} ui_event_type;
+
+typedef struct ui_event {
+    ui_event_type type;
+    int servantID;
+    bool connected;
+    bool connections[MAX_SERVANTS];
+    temp data;
+    uint8_t col;
+    uint8_t row;
+    int errorNr;
+    char text[LCD_COLS + 1];
+} ui_event;
+
+// Task handles and queues (the I2C bus lock lives in hal_esp32.cpp)
+TaskHandle_t acquisitionTaskHandle  = NULL;
+TaskHandle_t storageTaskHandle      = NULL;
+TaskHandle_t uiTaskHandle           = NULL;
+TaskHandle_t consoleTaskHandle      = NULL;
+QueueHandle_t logQueue              = NULL;
+QueueHandle_t uiQueue               = NULL;
+unsigned long logCycleDue           = 0;    // millis() the next log cycle is due, 0 = none scheduled yet
+volatile bool metricsDumpRequested  = false;    // "metrics" command, printed by the console task
+bool peerFailed[MAX_SERVANTS]       = {};   // ESP-NOW peer registration failed, retried by the acquisition task
+
+
+StatusLed statusLed(LED_PIN);    // WS2812 status pixel, blinks from its own timer (status_led.h)
+RTC_NOINIT_ATTR journal_memory journalMemory;   // Sample journal, kept through resets (sample_journal.h)
+
+// Fallback servant table, used when neither the SD card nor NVS holds one (see loadPeerTable)
+const uint8_t defaultServantAddresses[][6] = {
+    SERVANT_1_MAC,  // Servant 1 (COM13) - GCT1
+    SERVANT_2_MAC,  // Servant 2 (COM15) - GCT2
+    SERVANT_3_MAC,  // Servant 3 (COM16) - GCT3
+    SERVANT_4_MAC   // Servant 4 (unknown) - GCT4
 };
-esp_now_peer_info_t peerInfo[4];
-
-RTC_DS3231 rtc;
-
-LiquidCrystal_I2C lcd(0x27, 20, 4); // set the LCD address to 0x27 for a 20 chars and 4 line display
-
-
-void sendLogState(bool logState){
-        if(logState){
-        TXdata.actionID = 1002;
-        for (int i = 0; i < 4; i++) {
-            esp_err_t result = esp_now_send(broadcastAddresses[i], (uint8_t *) &TXdata, sizeof(TXdata));
-        }
-    }else{
-        TXdata.actionID = 1003;
-        for (int i = 0; i < 4; i++) {
-            esp_err_t result = esp_now_send(broadcastAddresses[i], (uint8_t *) &TXdata, sizeof(TXdata));
-        }
-    }
-}
 
+// UI task copy of what each servant shows on rows 1 and 2, so any LCD page can be redrawn
+temp uiServantData[MAX_SERVANTS];
+bool uiHasTemp[MAX_SERVANTS]        = {};
+bool uiTempConnected[MAX_SERVANTS]  = {};
+bool uiConnections[MAX_SERVANTS]    = {};
+int lcdPage                         = 0;    // Servants (lcdPage * SERVANTS_PER_PAGE) + 1 ... are shown
+unsigned long uiErrorSince          = 0;    // millis() the error screen went up, 0 = none
 
 void buttonState(){ //MARK: Button state
     static unsigned long lastButtonPress = 0;
@@ -166,49 +191,40 @@ void buttonState(){ //MARK: Button state
     // Debug: Print button state every 5 seconds
     if (millis() - lastDebugPrint > 5000) {
         lastDebugPrint = millis();
-        Serial.printf("Button Debug: Pin %d = %s, logState = %s\n", 
+        CONSOLE_DEBUG("Button Debug: Pin %d = %s, logState = %s\n", 
                      BUTTON_PIN, currentButtonState ? "HIGH" : "LOW", logState ? "ON" : "OFF");
     }
     
     // Check if button state changed
     if (currentButtonState != lastButtonState) {
-        Serial.printf("Button state changed: %s -> %s at %lu ms\n", 
+        CONSOLE_DEBUG("Button state changed: %s -> %s at %lu ms\n", 
                      lastButtonState ? "HIGH" : "LOW", currentButtonState ? "HIGH" : "LOW", millis());
         
         // If button was just pressed (HIGH to LOW transition)
         if (currentButtonState == LOW && lastButtonState == HIGH) {
             lastButtonPress = millis();  // Record press time only when button is pressed
-            Serial.println("Button PRESSED - will toggle after debounce");
+            CONSOLE_DEBUG("Button PRESSED - will toggle after debounce");
         }
         // If button was just released (LOW to HIGH transition) 
         else if (currentButtonState == HIGH && lastButtonState == LOW) {
-            Serial.println("Button RELEASED - checking debounce");
+            CONSOLE_DEBUG("Button RELEASED - checking debounce");
             
             // Check if the press duration was long enough (debounce)
             if ((millis() - lastButtonPress) > debounceDelay) {
-                // Toggle logging state
+                // Toggle logging state (the acquisition task notices the change and informs the servants)
                 logState = !logState;
-                Serial.printf("DEBOUNCE OK - Toggling logState to %s\n", logState ? "ON" : "OFF");
+                CONSOLE_DEBUG("DEBOUNCE OK - Toggling logState to %s\n", logState ? "ON" : "OFF");
                 
-                sendLogState(logState);
+                // The status line on row 3 follows logState on the next UI refresh
                 if (logState) {
                     timeLeft = 0; // Start logging immediately
-                    // Immediately update display to show logging status
-                    lcd.setCursor(0, 3);
-                    if (numConnections > 0) {
-                        lcd.print("Logging: Starting...");
-                    } else {
-                        lcd.print("Logging: No connect  ");
-                    }
-                    Serial.println("=== LOGGING ACTIVATED ===");
+                    CONSOLE_INFO("=== LOGGING ACTIVATED ===");
                 } else {
-                    Serial.println("=== LOGGING DEACTIVATED ===");
-                    lcd.setCursor(0, 3);
-                    lcd.print("Idle (ready to log) ");
+                    CONSOLE_INFO("=== LOGGING DEACTIVATED ===");
                 }
-                Serial.printf("Button pressed - Log state: %s, numConnections: %d\n", logState ? "ON" : "OFF", numConnections);
+                CONSOLE_INFO("Button pressed - Log state: %s, numConnections: %d\n", logState ? "ON" : "OFF", numConnections);
             } else {
-                Serial.printf("DEBOUNCE FAILED - Duration: %lu ms (need > %lu ms)\n", 
+                CONSOLE_DEBUG("DEBOUNCE FAILED - Duration: %lu ms (need > %lu ms)\n", 
                              (millis() - lastButtonPress), debounceDelay);
             }
         }
@@ -218,841 +234,431 @@ void buttonState(){ //MARK: Button state
 }
 
 
-void OnDataSent(const uint8_t *mac_addr, esp_now_send_status_t status) {
-
-    Serial.print(mac_addr[0], HEX); Serial.print(":");
-    Serial.print(mac_addr[1], HEX); Serial.print(":");
-    Serial.print(mac_addr[2], HEX); Serial.print(":");
-    Serial.print(mac_addr[3], HEX); Serial.print(":");
-    Serial.print(mac_addr[4], HEX); Serial.print(":");
-    Serial.print(mac_addr[5], HEX); Serial.print(" --> ");
-
-    if (status == ESP_NOW_SEND_SUCCESS) {
-        Serial.println("Delivery Success");
-        connectionStatus = true;
-    } else {
-        Serial.println("Delivery Fail");
-        connectionStatus = false;
-    }
-    lastSendStatus = status == ESP_NOW_SEND_SUCCESS ? ESP_OK : ESP_FAIL;
+void OnDataSent(const uint8_t *mac_addr, bool delivered) {
+    // Runs in the WiFi task: only enqueue the message, the console task prints it
+    CONSOLE_DEBUG("%02X:%02X:%02X:%02X:%02X:%02X --> Delivery %s", mac_addr[0], mac_addr[1], mac_addr[2],
+                  mac_addr[3], mac_addr[4], mac_addr[5], delivered ? "Success" : "Fail");
+    connectionStatus = delivered;
+    lastSendStatus = delivered ? ESP_OK : ESP_FAIL;
+    acquisitionSent(mac_addr, delivered);
 }
 
 void OnDataRecv(const uint8_t *mac_addr, const uint8_t *incomingData, int len) {
-    // First, copy the actionID to determine the message type
-    int incomingActionID;
-    memcpy(&incomingActionID, incomingData, sizeof(int));
-    
-    if (incomingActionID == 1001) {
-        // Connection test response - copy to struct_message
-        struct_message connectionResponse;
-        memcpy(&connectionResponse, incomingData, sizeof(connectionResponse));
-        receivedActionID = connectionResponse.actionID;
-    } else if (incomingActionID == 2001) {
-        // Temperature data - copy to temp structure
-        memcpy(&receivedData, incomingData, sizeof(receivedData));
-        receivedActionID = receivedData.actionID;
-    } else {
-        // Unknown message type, try to copy as temp structure (default)
-        memcpy(&receivedData, incomingData, sizeof(receivedData));
-        receivedActionID = receivedData.actionID;
-    }
-    
-    messageReceived = true;
+    // Runs in the WiFi task: only enqueues, decoding happens in the acquisition task (drainRxRing)
+    acquisitionReceive(mac_addr, incomingData, len);
 }
 
+
 void SerialUserInput() {
     while (!Serial.available()) {
         // Wait for user input
     }
     int userActionID = Serial.parseInt();
-    TXdata.actionID = userActionID != 0 ? userActionID : 1; // Use user input if available, otherwise use default value
+    int actionID = userActionID != 0 ? userActionID : 1; // Use user input if available, otherwise use default value
 
-    TXdata.value = 2.0; // Replace with your actual default value
-
-    for (int i = 0; i < 4; i++) {
-        esp_err_t result = esp_now_send(broadcastAddresses[i], (uint8_t *) &TXdata, sizeof(TXdata));
+    for (int i = 0; i < peers.count(); i++) {
+        sendRequest(i, actionID, 0, 2.0); // Replace 2.0 with your actual default value
     }
 }
 
-void updateConnectionStatus(bool status, int targetID) { //MARK: Update connection status
-    lcd.setCursor(0, 1);
-    lcd.print("S1:");
-    lcd.setCursor(5, 1);
-    lcd.print("S2:");
-    lcd.setCursor(10, 1);
-    lcd.print("S3:");
-    lcd.setCursor(15, 1);
-    lcd.print("S4:");
+void handleSerialCommands() { //MARK: Serial commands
+    // Non-blocking line reader, polled by the UI task: "metrics" dumps the registry, "metrics reset" clears it
+    static char line[32];
+    static size_t lineLen = 0;
 
-    
-    switch (targetID)
-    {
-        case 1:
-            lcd.setCursor(3, 1);
-            break;
-
-        case 2:
-            lcd.setCursor(8, 1);
-            break;
-
-        case 3:
-            lcd.setCursor(13, 1);
-            break;
-
-        case 4:
-            lcd.setCursor(18, 1);
-            break;
-    }
-
-    if (status) {
-        lcd.write(byte(0)); // Tick mark
-    } else {
-        lcd.print("x");
+    while (Serial.available() > 0) {
+        char c = (char)Serial.read();
+        if (c != '\n' && c != '\r') {
+            if (lineLen < sizeof(line) - 1) {
+                line[lineLen++] = c;
+            }
+            continue;
+        }
+        if (lineLen == 0) {
+            continue;
+        }
+        line[lineLen] = '\0';
+        lineLen = 0;
+
+        if (strcmp(line, "metrics") == 0) {
+            metricsDumpRequested = true;        // A few KB: written by the console task, between its messages
+        } else if (strcmp(line, "metrics reset") == 0) {
+            resetMetrics();
+            CONSOLE_INFO("Metrics:\t\t\t\tReset\n");
+        } else {
+            CONSOLE_WARN("Unknown command '%s' (commands: metrics, metrics reset)\n", line);
+        }
     }
 }
 
 
-bool checkConnection(int locTargetID) { //MARK: Check connection
-    static unsigned long lastCheckTime[4] = {0, 0, 0, 0};
-    static bool lastCheckResult[4] = {false, false, false, false};
-    
-    // Implement cooldown: only check each servant once every 3 seconds to reduce interference
-    unsigned long currentTime = millis();
-    if (currentTime - lastCheckTime[locTargetID-1] < 3000) {
-        return lastCheckResult[locTargetID-1]; // Return cached result
-    }
-    
-    esp_err_t result;
-    
-    // structure to Action Code as a connection test
-    typedef struct struct_message {
-        int actionID;
-    } struct_message;
-    struct_message testData;
-
-    testData.actionID = 1001;
-
-    // Store current state to restore later
-    bool previousMessageReceived = messageReceived;
-    int previousReceivedActionID = receivedActionID;
-    
-    // Clear any previous message state
-    messageReceived = false;
-    receivedActionID = 0;
+uint32_t get_epoch() {
+    return timebase.epoch();    // No I2C transfer once the timebase is anchored
+}
 
-    // Send connection test message
-    result = esp_now_send(broadcastAddresses[locTargetID-1], (uint8_t *) &testData, sizeof(testData));
 
-    lastCheckTime[locTargetID-1] = currentTime;
-    
-    if (result == ESP_OK) {     // Check if the message was queued for sending successfully
-        // Wait for response from servant with timeout
-        unsigned long startTime = millis();
-        const unsigned long responseTimeout = 800; // Increased timeout to 800ms for more reliable connection tests
-        
-        while (!messageReceived && (millis() - startTime) < responseTimeout) {
-            delay(10); // Small delay to allow response processing
-        }
-        
-        // Check if we received a valid response
-        if (messageReceived && receivedActionID == 1001) {
-            lastCheckResult[locTargetID-1] = true;
-            // Don't reset messageReceived here to avoid clearing valid temperature data
-            return true;
-        } else {
-            lastCheckResult[locTargetID-1] = false;
-            // Restore previous state if no connection response was received
-            messageReceived = previousMessageReceived;
-            receivedActionID = previousReceivedActionID;
-            return false;
-        }
-    } else {
-        Serial.printf("ESP-NOW send failed for target %d: %d\n", locTargetID, result);
-        lastCheckResult[locTargetID-1] = false;
-        // Restore previous state
-        messageReceived = previousMessageReceived;
-        receivedActionID = previousReceivedActionID;
-        return false;
-    }
+const char* format_timestamp(uint32_t epoch, char *buffer) {
+    DateTime now(epoch);
+    sprintf(buffer, "%04d-%02d-%02d %02d:%02d:%02d", now.year(), now.month(), now.day(), now.hour(), now.minute(), now.second());
+    return buffer;
 }
 
 
-bool waitForActionID(int actionID, int targetID) { //MARK: Wait for action ID
-    
-    // if(checkConnection(targetID)){  //Only request data if the connection is established
-        unsigned long startTime = millis();
-        bool connectionStatus = false;
-
-        while (!messageReceived || receivedActionID != actionID) {
-            if (millis() - startTime > sendTimeout) {
-                Serial.println("Timeout waiting for action ID on target: " + String(targetID));
-                connectionStatus = false;
-                break;
-            }else{
-                connectionStatus = true;
-            }
-        }
-        messageReceived = false; // Reset for next message
-
-        //updateConnectionStatus(connectionStatus, targetID);
-        return connectionStatus; // FIXED: Return actual connection status instead of always true
-    }
-    // return (false);
-// }
-
-
-String tempToString(temp t, String timestamp, int serventID) {//MARK: To String
-    String data = "";
-    data += timestamp + "," + String(serventID) + ",1," + String(t.sens1) + "\n";
-    data += timestamp + "," + String(serventID) + ",2," + String(t.sens2) + "\n";
-    data += timestamp + "," + String(serventID) + ",3," + String(t.sens3) + "\n";
-    data += timestamp + "," + String(serventID) + ",4," + String(t.sens4) + "\n";
-    data += timestamp + "," + String(serventID) + ",5," + String(t.sens5) + "\n";
-    data += timestamp + "," + String(serventID) + ",6," + String(t.sens6) + "\n";
-    data += timestamp + "," + String(serventID) + ",7," + String(t.sens7) + "\n";
-    data += timestamp + "," + String(serventID) + ",8," + String(t.sens8) + "\n";
-    data += timestamp + "," + String(serventID) + ",9," + String(t.sens9) + "\n";
-    return data;
+const char* get_timestamp(char *buffer) {
+    return format_timestamp(get_epoch(), buffer);
 }
 
 
 const char* get_timestamp() {
-    DateTime now = rtc.now();
-    sprintf(timestamp, "%04d-%02d-%02d %02d:%02d:%02d", now.year(), now.month(), now.day(), now.hour(), now.minute(), now.second());
-    return timestamp;
+    return get_timestamp(timestamp);    // Shared buffer, only for the UI task and setup()
 }
 
 
-void displayTemp(int targetID, temp t, bool isConnected = true) { //MARK: Display temperature
-
-    switch (targetID)
-    {
-        case 1:
-            lcd.setCursor( 0, 2);
-            break;
+int lcdPageCount() {
+    return max(1, (peers.count() + SERVANTS_PER_PAGE - 1) / SERVANTS_PER_PAGE);
+}
 
-        case 2:
-            lcd.setCursor( 5, 2);
-            break;
 
-        case 3:
-            lcd.setCursor(10, 2);
-            break;
+void displayTemp(int targetID, temp t, bool isConnected = true) { //MARK: Display temperature
 
-        case 4:
-            lcd.setCursor(15, 2);
-            break;
+    // Keep the value for page switches; only servants on the current page are drawn
+    uiServantData[targetID-1] = t;
+    uiTempConnected[targetID-1] = isConnected;
+    uiHasTemp[targetID-1] = true;
+    if ((targetID-1) / SERVANTS_PER_PAGE != lcdPage || uiErrorSince != 0) {
+        return;
     }
 
+    int col = ((targetID-1) % SERVANTS_PER_PAGE) * 5;
+    char text[8];
+
     if (isConnected) {
         // Validate temperature readings and count valid sensors
         float tempSum = 0;
         int validSensorCount = 0;
-        float temps[9] = {t.sens1, t.sens2, t.sens3, t.sens4, t.sens5, t.sens6, t.sens7, t.sens8, t.sens9};
         
-        for (int i = 0; i < 9; i++) {
+        for (int i = 0; i < t.count; i++) {
             // Check if temperature is reasonable (between -50°C and 100°C)
-            if (temps[i] >= -50.0 && temps[i] <= 100.0) {
-                tempSum += temps[i];
+            if (t.sens[i] >= -50.0 && t.sens[i] <= 100.0) {
+                tempSum += t.sens[i];
                 validSensorCount++;
             }
         }
         
         if (validSensorCount > 0) {
             float avgTemp = tempSum / validSensorCount;
-            lcd.print("     "); // Clear the area first (5 spaces)
-            lcd.setCursor((targetID-1)*5, 2); // Reset cursor position
-            lcd.printf("%.1f", avgTemp);
+            snprintf(text, sizeof(text), "%.1f", avgTemp);
         } else {
-            lcd.print(" --- "); // Show error indicator for invalid readings
+            snprintf(text, sizeof(text), " --- "); // Show error indicator for invalid readings
         }
     } else {
-        lcd.print("  -  "); // Connection lost indicator
+        snprintf(text, sizeof(text), "  -  "); // Connection lost indicator
     }
+    halLcdWriteField(col, 2, 5, text);   // Always the full 5 cells, so no digits of a longer value remain
 }
     
 
-void blinkLED(int red, int green, int blue, int blinkIntervall) {
-    static unsigned long previousMillis = 0;
-    static bool ledState = false;
-    unsigned long currentMillis = millis();
-
-    if (currentMillis - previousMillis >= blinkIntervall) {
-        previousMillis = currentMillis;
-        ledState = !ledState;
-
-        if (ledState) {
-            strip.setPixelColor(0, strip.Color(red, green, blue));
-        } else {
-            strip.setPixelColor(0, strip.Color(0, 0, 0));
-        }
-
-        strip.show();
-    }
-}
-
-
-void updateStatusLED(int status, int blinkIntervall = 1000){ //MARK: Update status LED
-    switch (status)
-    {
-
-    case 0:
-        strip.setPixelColor(0, strip.Color(0, 0, 0)); // Turn off the LED
-        break;
-
-    case 1:
-        strip.setPixelColor(0, strip.Color(255, 100, 0));   // Constant yellow
-        break;
-    
-    case 2:
-        blinkLED(0, 255, 0, blinkIntervall);    // Blink the LED in green
-        break;
-    
-    case 3:
-        strip.setPixelColor(0, strip.Color(0, 255, 0)); // Constant green
-        break;
-
-    case 4:
-        strip.setPixelColor(0, strip.Color(255, 0, 0)); // Constant red
-        break;
-
-    case 5:
-        blinkLED(255, 0, 0, blinkIntervall);    // Blink the LED in red
-        break;
-
-    case 6:
-        blinkLED(255, 100, 0, blinkIntervall);  // Blink the LED in yellow
-        break;
-    
-    default:
-        break;
-    }
-
-    strip.show();
-}
-
-
 void displayTimeStamp() {
-    lcd.setCursor(0, 0);
-    lcd.print(get_timestamp());
+    // Redrawn on every UI pass; the frame sends only the digits that changed
+    halLcdWrite(0, 0, get_timestamp());
 }
 
 
 void displayError(String errorMessage = "", int errorNr = 0){ //MARK: Display error
-    lcd.clear();
-    lcd.setCursor(0, 1);
+    char line[LCD_COLS + 1];
+    halLcdClear();
 
     if (errorMessage != "" && errorNr != 0){
-        lcd.printf("FATAL ERROR: Nr. %d", errorNr);
-        lcd.setCursor(0, 2);
-        lcd.print(errorMessage);
+        snprintf(line, sizeof(line), "FATAL ERROR: Nr. %d", errorNr);
+        halLcdWrite(0, 1, line);
+        halLcdWrite(0, 2, errorMessage.c_str());
     }else if (errorMessage != "" && errorNr == 0){
-        lcd.print("FATAL ERROR:");
-        lcd.setCursor(0, 2);
-        lcd.print(errorMessage);
+        halLcdWrite(0, 1, "FATAL ERROR:");
+        halLcdWrite(0, 2, errorMessage.c_str());
     }else{
-        lcd.print("FATAL ERROR (undef.)");
+        halLcdWrite(0, 1, "FATAL ERROR (undef.)");
     }
+    halLcdFlush(true);          // Also used by setup() error loops, where no UI task flushes
 }
 
 
-void writeToSD(String dataString) { //MARK: Write to SD
-    Serial.println("=== ATTEMPTING TO WRITE TO SD CARD ===");
-    Serial.printf("Data to write: %s\n", dataString.c_str());
-    
-    // Check if SD card is still available
-    if (!SD.begin(CS_PIN)) {
-        Serial.println("SD Card not available for writing");
-        displayError("SD Card unavailable", 2);
-        updateStatusLED(5);
+void displayText(int col, int row, const char *text) {
+    if (uiQueue == NULL) {      // Before the UI task exists, write directly
+        halLcdWrite(col, row, text);
+        halLcdFlush(true);
         return;
     }
-    
-    file = SD.open(fileName, FILE_APPEND); // Open the file in append mode
+    ui_event event = {};
+    event.type = UI_TEXT;
+    event.col = col;
+    event.row = row;
+    strncpy(event.text, text, LCD_COLS);
+    xQueueSend(uiQueue, &event, 0);
+}
 
-    if (!file){
-        Serial.println("Failed to open file for writing");
-        displayError("Failed to open file", 2);
-        updateStatusLED(5);
-        
-        // Try to remount SD card
-        delay(1000);
-        if (SD.begin(CS_PIN)) {
-            Serial.println("SD Card remounted successfully");
-            file = SD.open(fileName, FILE_APPEND);
-            if (!file) {
-                Serial.println("Still failed to open file after remount");
-                return;
-            }
-        } else {
-            Serial.println("Failed to remount SD card");
-            return;
-        }
-    }
 
-    size_t bytesWritten = file.print(dataString);
-    file.close();
-    
-    // Verify write was successful
-    if (bytesWritten == 0) {
-        Serial.println("Warning: No bytes written to SD card");
-    } else {
-        Serial.printf("=== SUCCESS: Wrote %d bytes to SD card ===\n", bytesWritten);
-        Serial.printf("File: %s\n", fileName);
+void reportError(const char *errorMessage, int errorNr) {
+    if (uiQueue == NULL) {
+        displayError(errorMessage, errorNr);
+        return;
     }
+    ui_event event = {};
+    event.type = UI_ERROR;
+    event.errorNr = errorNr;
+    strncpy(event.text, errorMessage, LCD_COLS);
+    xQueueSend(uiQueue, &event, 0);
 }
 
 
-void getAllTemps(bool save = true) {//MARK: Get temperatures
+void postTemp(int targetID, const temp &t, bool isConnected) {
+    ui_event event = {};
+    event.type = UI_TEMP;
+    event.servantID = targetID;
+    event.connected = isConnected;
+    event.data = t;
+    xQueueSend(uiQueue, &event, 0);
+}
 
-    updateStatusLED(0);
-    lcd.setCursor(0, 3);
-    lcd.print("Updating Temperature");
 
-    TXdata.actionID = 3001; //Action ID for getting all temperatures from a servent
+void postConnections(const bool connections[]) {
+    ui_event event = {};
+    event.type = UI_CONNECTIONS;
+    memcpy(event.connections, connections, sizeof(event.connections));
+    xQueueSend(uiQueue, &event, 0);
+}
 
-    for (int i = 0; i < 4; i++) {
-        // Only try to get temperatures from connected servants
-        bool servantConnected = checkConnection(i+1);
-        if (servantConnected) {
-            // Clear previous data to prevent contamination
-            memset(&receivedData, 0, sizeof(receivedData));
-            
-            esp_err_t result = esp_now_send(broadcastAddresses[i], (uint8_t *) &TXdata, sizeof(TXdata));
 
-            if (waitForActionID(2001,i+1/*Target ID*/) == true){
-                Serial.printf("Successfully received data from servant %d\n", i+1);
-                if (save == true)
-                {
-                    writeToSD(tempToString(receivedData,get_timestamp(), i+1));
-                }
-                displayTemp(i+1, receivedData, true);
-            } else {
-                Serial.printf("Failed to receive data from servant %d - logging NAN\n", i+1);
-                // For failed data retrieval, log NAN if saving
-                if (save == true) {
-                    writeToSD(String(get_timestamp()) + "," + String(i+1) + ",123456789,NAN\n");
-                }
-                // Display shows "-" for failed servants
-                temp emptyData = {0};
-                displayTemp(i+1, emptyData, false);
-            }
-        } else {
-            Serial.printf("Servant %d not connected - logging NAN\n", i+1);
-            // For disconnected servants, log NAN if saving
-            if (save == true) {
-                writeToSD(String(get_timestamp()) + "," + String(i+1) + ",123456789,NAN\n");
-            }
-            // Display shows "-" for disconnected servants
-            temp emptyData = {0};
-            displayTemp(i+1, emptyData, false);
-        }
+void queueLogRecord(uint32_t epoch, int servantID, const temp *t, int millis) {
+    log_record record = {};
+    record.epoch = epoch;
+    record.millis = millis;
+    record.servantID = servantID;
+    record.valid = (t != NULL);
+    if (t != NULL) {
+        record.data = *t;
+    }
+    // Journaled first, so a reset before the next log sync doesn't lose the record
+    record.journalSeq = sampleJournal.append(record);
+    // Never block the radio task on a slow SD card: drop and count instead
+    if (xQueueSend(logQueue, &record, 0) != pdTRUE) {
+        metrics.droppedLogRecords.add();
+        CONSOLE_WARN("Log queue full - dropped record for servant %d (total dropped: %lu)\n", servantID, (unsigned long)metrics.droppedLogRecords.get());
     }
 }
 
 
 void logLoop() {    //MARK: Log loop
     static unsigned long previousExecution = 0;
-    static unsigned long lastDisplayUpdate = 0;
+    static unsigned long lastCountdownUpdate = 0;
     unsigned long currentTime = millis();
 
     // If timeLeft is 0, it means we should retrieve data
     if (timeLeft <= 0) {
+        // How late this cycle starts; the first cycle after logging was switched on has no due time
+        if (logCycleDue != 0) {
+            long lateMs = (long)(currentTime - logCycleDue);
+            metrics.logLatenessMs.record(lateMs > 0 ? lateMs : 0);
+            if (lateMs > LOG_DEADLINE_SLACK_MS) {
+                metrics.missedDeadlines.add();
+                CONSOLE_WARN("Log cycle started %ld ms late\n", lateMs);
+            }
+        }
+        logCycleDue = currentTime + logIntervall;
         previousExecution = currentTime;
         timeLeft = logIntervall / 1000; // Reset to full interval in seconds
         
         // Only try to get temperatures if we have connected servants
         if (numConnections > 0) {
-            Serial.println("=== RETRIEVING DATA FOR LOGGING ===");
-            lcd.setCursor(0, 3);
-            lcd.print("Retrieving Data...  ");
+            CONSOLE_DEBUG("=== RETRIEVING DATA FOR LOGGING ===");
             getAllTemps();
-            Serial.println("=== DATA RETRIEVAL COMPLETE ===");
+            CONSOLE_DEBUG("=== DATA RETRIEVAL COMPLETE ===");
         } else {
-            Serial.println("Logging: No servants connected, skipping data collection");
-            lcd.setCursor(0, 3);
-            lcd.print("Logging: No connect  ");
+            CONSOLE_INFO("Logging: No servants connected, skipping data collection");
         }
-        lastDisplayUpdate = currentTime;
+        lastCountdownUpdate = currentTime;
     } else {
-        // Update the countdown display every second
-        if (currentTime - lastDisplayUpdate >= 1000) {
-            lastDisplayUpdate = currentTime;
-            timeLeft = logIntervall / 1000 - (currentTime - previousExecution) / 1000;
+        // Update the countdown every second (the UI task displays it)
+        if (currentTime - lastCountdownUpdate >= 1000) {
+            lastCountdownUpdate = currentTime;
+            int remaining = logIntervall / 1000 - (currentTime - previousExecution) / 1000;
             
             // Ensure timeLeft doesn't go negative
-            if (timeLeft < 0) {
-                timeLeft = 0;
+            if (remaining < 0) {
+                remaining = 0;
             }
+            timeLeft = remaining;
             
-            lcd.setCursor(0, 3);
             if (numConnections > 0) {
-                lcd.print("Logging:");
-                lcd.setCursor(8, 3);
-                lcd.printf(" %d s        ", timeLeft);
-                Serial.printf("Logging countdown: %d seconds\n", timeLeft);
+                CONSOLE_DEBUG("Logging countdown: %d seconds\n", remaining);
             } else {
-                lcd.print("Logging: No connect  ");
-                Serial.println("Logging: No connections available");
+                CONSOLE_DEBUG("Logging: No connections available");
             }
         }
     }
-    
-    // Debug output (commented out)
-    // Serial.println("timeLeft: " + String(timeLeft));
-    // Serial.println("currentTime: " + String(currentTime));
-    // Serial.println("previousExecution: " + String(previousExecution));
 }
 
 
-void displayConnectionStatus() { //MARK: Display connection status
-    static unsigned long lastDebugPrint = 0;
-    numConnections = 0;
-
-    // Clear the entire connection status line first
-    lcd.setCursor(0, 1);
-    lcd.print("                    "); // Clear 20 characters
-    
-    // Redraw the connection status labels and indicators
-    lcd.setCursor(0, 1);
-    lcd.print("S1:");
-    lcd.setCursor(5, 1);
-    lcd.print("S2:");
-    lcd.setCursor(10, 1);
-    lcd.print("S3:");
-    lcd.setCursor(15, 1);
-    lcd.print("S4:");
-    
-    bool connections[4];
-    
-    lcd.setCursor(3, 1);
-    connections[0] = checkConnection(1);
-    if (connections[0]) {
-        lcd.write(byte(0)); // Tick mark
-        numConnections++;
-    } else {
-        lcd.print("x");
+void displayConnectionStatus(const bool connections[]) { //MARK: Display connection status
+    memcpy(uiConnections, connections, sizeof(uiConnections));
+    if (uiErrorSince != 0) {
+        return;                 // Drawn when the error screen is taken down
     }
 
-    lcd.setCursor(8, 1);
-    connections[1] = checkConnection(2);
-    if (connections[1]) {
-        lcd.write(byte(0)); // Tick mark
-        numConnections++;
-    } else {
-        lcd.print("x");
+    // Labels and indicators of the servants on the current page, the rest of the row blank
+    char line[LCD_COLS + 1] = "";
+    int len = 0;
+    int first = lcdPage * SERVANTS_PER_PAGE;
+    for (int i = first; i < peers.count() && i < first + SERVANTS_PER_PAGE; i++) {
+        len += snprintf(line + len, sizeof(line) - len, "S%d:%c ", i+1, connections[i] ? LCD_CHAR_TICK : 'x');
+        len = min(len, LCD_COLS);
     }
+    halLcdWriteField(0, 1, LCD_COLS, line);
+}
 
-    lcd.setCursor(13, 1);
-    connections[2] = checkConnection(3);
-    if (connections[2]) {
-        lcd.write(byte(0)); // Tick mark
-        numConnections++;
-    } else {
-        lcd.print("x");
-    }
 
-    lcd.setCursor(18, 1);
-    connections[3] = checkConnection(4);
-    if (connections[3]) {
-        lcd.write(byte(0)); // Tick mark
-        numConnections++;
-    } else {
-        lcd.print("x");
+void redrawServantRows() {
+    // Rows 1 and 2 from the UI task's copies: after a page change or the error screen
+    displayConnectionStatus(uiConnections);
+    halLcdWriteField(0, 2, LCD_COLS, "");
+    int first = lcdPage * SERVANTS_PER_PAGE;
+    for (int i = first; i < peers.count() && i < first + SERVANTS_PER_PAGE; i++) {
+        if (uiHasTemp[i]) {
+            displayTemp(i+1, uiServantData[i], uiTempConnected[i]);
+        }
     }
-    
-    // Debug: Print connection status every 10 seconds
-    if (millis() - lastDebugPrint > 10000) {
-        lastDebugPrint = millis();
-        Serial.printf("Connection Status: S1=%s S2=%s S3=%s S4=%s (Total: %d)\n",
-                     connections[0] ? "OK" : "X", connections[1] ? "OK" : "X",
-                     connections[2] ? "OK" : "X", connections[3] ? "OK" : "X", numConnections);
+}
+
+
+void updateLcdPage() { //MARK: Update LCD page
+    // More servants than fit on rows 1 and 2: show them page by page
+    static unsigned long lastPageChange = 0;
+    if (lcdPageCount() <= 1 || millis() - lastPageChange < LCD_PAGE_INTERVAL_MS) {
+        return;
     }
+    lastPageChange = millis();
+    lcdPage = (lcdPage + 1) % lcdPageCount();
+    redrawServantRows();
 }
 
 
-bool connectToWiFi() {
-    Serial.println("WiFi Connection:\t\t\tAttempting...");
-    lcd.setCursor(0, 0);
-    lcd.print("Connecting to WiFi...");
-    
-    // Feed watchdog before starting WiFi connection
-    esp_task_wdt_reset();
-    
-    // Ensure WiFi is disconnected first
-    WiFi.disconnect(true);
-    delay(100);
-    
-    WiFi.mode(WIFI_AP_STA); // Set to both AP and STA mode for ESP-NOW compatibility
-    WiFi.begin(ssid, password);
-    
-    int attempts = 0;
-    const int maxAttempts = 20; // 10 seconds timeout
-    
-    while (WiFi.status() != WL_CONNECTED && attempts < maxAttempts) {
-        delay(500);
-        Serial.print(".");
-        attempts++;
-        
-        // Feed watchdog during WiFi connection to prevent timeout
-        esp_task_wdt_reset();
-        
-        // Show progress on LCD
-        if (attempts % 4 == 0) {
-            lcd.setCursor(19, 0);
-            lcd.print(attempts / 4);
-        }
+bool holdErrorScreen() {
+    // An error stays readable for UI_ERROR_HOLD_MS; updates meanwhile only change the UI task's copies
+    if (uiErrorSince == 0) {
+        return false;
     }
-    
-    if (WiFi.status() == WL_CONNECTED) {
-        Serial.println();
-        Serial.print("WiFi Connection:\t\t\tSuccess (");
-        Serial.print(WiFi.localIP());
-        Serial.println(")");
-        lcd.setCursor(0, 0);
-        lcd.print("WiFi Connected      ");
+    if (millis() - uiErrorSince < UI_ERROR_HOLD_MS) {
         return true;
-    } else {
-        Serial.println();
-        Serial.printf("WiFi Connection:\t\t\tFailed (Status: %d)\n", WiFi.status());
-        lcd.setCursor(0, 0);
-        lcd.print("WiFi Failed         ");
-        return false;
     }
+    uiErrorSince = 0;
+    halLcdClear();
+    redrawServantRows();
+    return false;
 }
 
 
-bool syncTimeWithNTP() {
-    Serial.println("NTP Time Sync:\t\t\t\tAttempting...");
-    lcd.setCursor(0, 1);
-    lcd.print("Syncing time...");
-    
-    // Feed watchdog before starting NTP sync
-    esp_task_wdt_reset();
-    
-    // Detailed network diagnostics
-    Serial.printf("WiFi Status: %d (Connected=%d)\n", WiFi.status(), WL_CONNECTED);
-    Serial.printf("WiFi IP: %s\n", WiFi.localIP().toString().c_str());
-    Serial.printf("WiFi Gateway: %s\n", WiFi.gatewayIP().toString().c_str());
-    Serial.printf("WiFi DNS: %s\n", WiFi.dnsIP().toString().c_str());
-    
-    // Test basic connectivity first
-    Serial.println("Testing basic connectivity...");
-    WiFiClient client;
-    if (client.connect("8.8.8.8", 53)) {  // Google DNS on port 53
-        Serial.println("Basic TCP connectivity: OK");
-        client.stop();
-    } else {
-        Serial.println("Basic TCP connectivity: FAILED");
-        Serial.println("Network issue - cannot reach external servers");
-        return false;
-    }
-    
-    // Test DNS resolution
-    Serial.println("Testing DNS resolution...");
-    IPAddress ntpIP;
-    if (WiFi.hostByName(ntpServer, ntpIP)) {
-        Serial.printf("DNS Resolution: OK (%s -> %s)\n", ntpServer, ntpIP.toString().c_str());
-    } else {
-        Serial.printf("DNS Resolution: FAILED (cannot resolve %s)\n", ntpServer);
-        Serial.println("Trying alternate NTP servers...");
-        
-        // Try backup NTP servers
-        const char* backupServers[] = {"pool.ntp.org", "time.nist.gov", "time.cloudflare.com"};
-        bool dnsWorking = false;
-        
-        for (int i = 0; i < 3; i++) {
-            if (WiFi.hostByName(backupServers[i], ntpIP)) {
-                Serial.printf("Backup DNS OK: %s -> %s\n", backupServers[i], ntpIP.toString().c_str());
-                dnsWorking = true;
-                break;
-            }
-        }
-        
-        if (!dnsWorking) {
-            Serial.println("All DNS lookups failed - DNS issue detected");
-            return false;
+void displayStatusLine() { //MARK: Display status line
+    char line[LCD_COLS + 1];
+
+    if (acquisitionBusy) {
+        snprintf(line, sizeof(line), "Updating Temperature");
+    } else if (logState) {
+        if (numConnections > 0 && streamingMode) {
+            snprintf(line, sizeof(line), "Streaming: %d ms%-*s", max(streamPeriodMs, STREAM_MIN_PERIOD_MS), LCD_COLS, "");
+        } else if (numConnections > 0) {
+            snprintf(line, sizeof(line), "Logging: %d s%-*s", timeLeft, LCD_COLS, "");
+        } else {
+            snprintf(line, sizeof(line), "Logging: No connect ");
         }
+    } else if (numConnections == 0) {
+        snprintf(line, sizeof(line), "ERROR: No connection");
+    } else {
+        snprintf(line, sizeof(line), "Idle (ready to log) ");
     }
-    
-    // Configure time with NTP server
-    Serial.printf("Configuring NTP with server: %s\n", ntpServer);
-    Serial.printf("Timezone: GMT%+ld, DST: %d hours\n", gmtOffset_sec/3600, daylightOffset_sec/3600);
-    
-    configTime(gmtOffset_sec, daylightOffset_sec, ntpServer);
-    
-    // Wait for time to be set with detailed progress
-    struct tm timeinfo;
-    int attempts = 0;
-    const int maxAttempts = 8; // 4 seconds timeout
-    
-    Serial.println("Waiting for NTP response...");
-    while (!getLocalTime(&timeinfo) && attempts < maxAttempts) {
-        delay(500);
-        attempts++;
-        
-        // Feed watchdog during NTP sync to prevent timeout
-        esp_task_wdt_reset();
-        
-        // Show detailed progress
-        if (attempts % 2 == 0) {
-            lcd.setCursor(18, 1);
-            lcd.print(attempts / 2);
-            Serial.printf("NTP attempt %d/%d (%.1fs elapsed)...\n", attempts, maxAttempts, attempts * 0.5);
+
+    halLcdWriteField(0, 3, LCD_COLS, line);
+}
+
+
+bool mostServantsConnected() {
+    // At least three out of four, like the original 4-servant setup
+    return numConnections > 0 && numConnections * 4 >= peers.count() * 3;
+}
+
+
+void updateLEDFromState() {
+    if (storageError) {
+        statusLed.setPattern(LED_RED_BLINK); // Blink red - SD card can't be written
+    } else if (logState) {
+        if (mostServantsConnected()) {
+            statusLed.setPattern(LED_GREEN); // Constant green - 3 of 4 (75 %) or more servants logging
+        } else if (numConnections > 0) {
+            statusLed.setPattern(LED_YELLOW); // Constant yellow - fewer servants but still logging
+        } else {
+            statusLed.setPattern(LED_YELLOW_BLINK); // Blink yellow - no connections but logging active
         }
-        
-        // Check if we're getting partial time data
-        time_t now;
-        time(&now);
-        if (now > 0) {
-            Serial.printf("Partial time received: %ld (but getLocalTime still fails)\n", now);
+    } else {
+        if (mostServantsConnected()){
+            statusLed.setPattern(LED_GREEN_BLINK); // Blink green - ready with 75 % or more of the servants
+        } else if (numConnections > 0) {
+            statusLed.setPattern(LED_YELLOW_BLINK); // Blink yellow - ready with fewer servants
+        } else {
+            statusLed.setPattern(LED_RED_BLINK); // Blink red - no connections
         }
     }
-    
-    Serial.printf("NTP sync completed after %d attempts (%.1fs)\n", attempts, attempts * 0.5);
-    
-    if (getLocalTime(&timeinfo)) {
-        Serial.printf("Raw time received - Year: %d, Month: %d, Day: %d\n", 
-                     timeinfo.tm_year + 1900, timeinfo.tm_mon + 1, timeinfo.tm_mday);
-        Serial.printf("Time: %02d:%02d:%02d\n", timeinfo.tm_hour, timeinfo.tm_min, timeinfo.tm_sec);
-        
-        // Validate the received time (should be reasonable)
-        if (timeinfo.tm_year > (2020 - 1900) && timeinfo.tm_year < (2050 - 1900)) {
-            // Update RTC with NTP time
-            DateTime ntpTime(timeinfo.tm_year + 1900, timeinfo.tm_mon + 1, timeinfo.tm_mday,
-                            timeinfo.tm_hour, timeinfo.tm_min, timeinfo.tm_sec);
-            rtc.adjust(ntpTime);
-            
-            // Update tracking variables
-            lastNTPSync = millis();
-            ntpSyncSuccessful = true;
-            
-            Serial.println("NTP Time Sync:\t\t\t\tSuccess");
-            Serial.printf("Time updated to: %04d-%02d-%02d %02d:%02d:%02d\n",
-                         timeinfo.tm_year + 1900, timeinfo.tm_mon + 1, timeinfo.tm_mday,
-                         timeinfo.tm_hour, timeinfo.tm_min, timeinfo.tm_sec);
-            
-            lcd.setCursor(0, 1);
-            lcd.print("Time synced         ");
-            // Clear any leftover NTP progress numbers from the display
-            lcd.setCursor(18, 1);
-            lcd.print(" ");
-            return true;
-        } else {
-            Serial.printf("NTP Time Sync:\t\t\t\tFailed (Invalid time - year %d)\n", timeinfo.tm_year + 1900);
-            lcd.setCursor(0, 1);
-            lcd.print("Time invalid        ");
-            // Clear any leftover NTP progress numbers from the display
-            lcd.setCursor(18, 1);
-            lcd.print(" ");
-            return false;
+}
+
+
+void handleUiEvent(const ui_event &event) {
+    switch (event.type)
+    {
+    case UI_TEMP:
+        displayTemp(event.servantID, event.data, event.connected);
+        break;
+
+    case UI_CONNECTIONS:
+        displayConnectionStatus(event.connections);
+        break;
+
+    case UI_TEXT:
+        if (uiErrorSince == 0) {
+            halLcdWrite(event.col, event.row, event.text);
         }
-    } else {
-        Serial.println("NTP Time Sync:\t\t\t\tFailed (No response from NTP server)");
-        Serial.println("Possible causes:");
-        Serial.println("1. NTP port 123 blocked by firewall/router");
-        Serial.println("2. ISP blocking NTP traffic");
-        Serial.println("3. Network congestion");
-        Serial.println("4. NTP server overloaded");
-        
-        // Try one more time with a different approach
-        Serial.println("Trying manual NTP query...");
-        // You could implement manual NTP packet query here if needed
-        
-        lcd.setCursor(0, 1);
-        lcd.print("NTP blocked/timeout ");
-        // Clear any leftover NTP progress numbers from the display
-        lcd.setCursor(18, 1);
-        lcd.print(" ");
-        return false;
+        break;
+
+    case UI_ERROR:
+        displayError(event.text, event.errorNr);
+        uiErrorSince = max(millis(), 1UL);
+        break;
     }
 }
 
 
 bool isRTCTimeValid() {
+    lockI2C();
     DateTime now = rtc.now();
+    unlockI2C();
     
-    // Check if RTC time is reasonable (not reset to default values)
+    // Check if RTC time is reasonable (not reset to default values, typical sign of a dead battery)
     if (now.year() < 2020 || now.year() > 2050) {
-        Serial.printf("RTC Invalid: Year %d out of range\n", now.year());
+        CONSOLE_WARN("RTC Invalid: Year %d out of range\n", now.year());
         return false;
     }
-    
-    // Check if RTC has lost time (typical sign of dead battery)
-    // If it's been more than 48 hours since last NTP sync and RTC shows a time
-    // that's way off from when we expect it to be, RTC might be dead
-    if (ntpSyncSuccessful && lastNTPSync > 0) {
-        unsigned long expectedElapsed = (millis() - lastNTPSync) / 1000; // seconds
-        // Allow for some drift, but if RTC is more than 10 minutes off, it's likely dead
-        if (expectedElapsed > 600) { // More than 10 minutes
-            Serial.println("RTC potentially lost time - battery may be dead");
-            return false;
-        }
-    }
-    
     return true;
 }
 
 
-bool attemptNTPSync() {
-    // Don't attempt if we just tried recently (unless it's startup)
-    if (lastNTPSync > 0 && (millis() - lastNTPSync) < NTP_RETRY_INTERVAL) {
-        return false; // Too soon to retry
-    }
-    
-    Serial.println("Attempting background NTP sync...");
-    
-    // Set WiFi mode and connect
-    WiFi.mode(WIFI_AP_STA);
-    WiFi.begin(ssid, password);
-    
-    int attempts = 0;
-    const int maxWiFiAttempts = 10; // 5 seconds max for WiFi
-    
-    while (WiFi.status() != WL_CONNECTED && attempts < maxWiFiAttempts) {
-        delay(500);
-        attempts++;
-        esp_task_wdt_reset();
-    }
-    
-    bool syncSuccess = false;
-    if (WiFi.status() == WL_CONNECTED) {
-        Serial.println("WiFi connected for NTP sync");
-        syncSuccess = syncTimeWithNTP();
-        WiFi.disconnect();
-    } else {
-        Serial.println("WiFi connection failed for NTP sync");
-    }
-    
-    // Reset WiFi mode for ESP-NOW compatibility
-    WiFi.mode(WIFI_STA);
-    delay(100);
-    esp_wifi_set_channel(1, WIFI_SECOND_CHAN_NONE);
-    
-    return syncSuccess;
-}
-
-
 void manageTimeSync() {
     unsigned long currentTime = millis();
     
-    // Check RTC validity periodically
+    // Check RTC validity periodically; the hourly sync itself is scheduled by timeSync
     if (currentTime - lastRTCCheck > RTC_VALIDITY_CHECK) {
         lastRTCCheck = currentTime;
         
         if (!isRTCTimeValid()) {
-            Serial.println("RTC time invalid - attempting emergency NTP sync");
-            // Force immediate NTP sync attempt
-            lastNTPSync = 0; // Reset to force sync
-            attemptNTPSync();
+            CONSOLE_WARN("RTC time invalid - NTP sync requested");
+            timeSync.request();
         }
     }
-    
-    // Periodic NTP sync attempt (every hour)
-    if (currentTime - lastNTPSync > NTP_RETRY_INTERVAL) {
-        Serial.println("Scheduled NTP sync attempt");
-        attemptNTPSync();
-    }
 }
 
 
@@ -1095,13 +701,268 @@ void updateSystemTimeFromRTC() {
 }
 
 
+bool addServantPeer(int servantIndex);
+
+
+void retryFailedPeers() {
+    // Until its registration succeeds, sends to the servant fail and it stays offline (NAN rows)
+    for (int i = 0; i < peers.count(); i++) {
+        if (peerFailed[i] && addServantPeer(i)) {
+            peerFailed[i] = false;
+            CONSOLE_INFO("ESP-NOW Peer Addition (Target %d):\tSuccess (retried)\n", i+1);
+        }
+    }
+}
+
+
+void acquisitionTask(void *parameter) { //MARK: Acquisition task
+    esp_task_wdt_add(NULL);
+
+    unsigned long previousTempUpdate = 0;
+    unsigned long previousConnectStat = 0;
+    bool previousLogState = logState;
+
+    refreshConnections();
+
+    for (;;) {
+        esp_task_wdt_reset();
+        uint32_t iterationStart = halMicros();
+
+        // Background time management (timebase anchor, RTC validity check, NTP sync while not logging)
+        timebase.poll();
+        manageTimeSync();
+        timeSync.poll(!logState);
+        if (timeSync.ownsRadio()) {
+            // The radio is on the access point's channel: no ESP-NOW until the sync gives it back
+            metrics.loopUs.record(halMicros() - iterationStart);
+            vTaskDelay(pdMS_TO_TICKS(10));
+            continue;
+        }
+
+        // Inform the servants as soon as the button changed the log state
+        if (logState != previousLogState) {
+            previousLogState = logState;
+            logCycleDue = 0;
+            sendLogState(logState);
+        }
+
+        unsigned long currentTime = millis();
+        if (currentTime - previousConnectStat >= (unsigned long)pingCheckIntervall) {   // Update the connection status only every ping interval, to avoid callback issues
+            previousConnectStat = currentTime;
+            retryFailedPeers();
+            refreshConnections();
+            sendLogState(logState);
+        }
+
+        if (isStreaming()) {
+            drainRxRing();      // Servants push their frames; they are logged as they are drained
+        } else if (logState) {
+            logLoop();
+        } else if (currentTime - previousTempUpdate >= (unsigned long)tempUpdateIntervall) {   // Update displayed temperature every 10 seconds
+            previousTempUpdate = currentTime;
+            getAllTemps(false);
+        }
+
+        metrics.loopUs.record(halMicros() - iterationStart);
+        if (isStreaming()) {
+            halRadioWait(10);   // A pushed frame ends the pause early and is logged right away
+        } else {
+            vTaskDelay(pdMS_TO_TICKS(10));
+        }
+    }
+}
+
+
+void storageTask(void *parameter) { //MARK: Storage task
+    esp_task_wdt_add(NULL);
+    log_record record;
+    unsigned long lastStatsPrint = millis();
+    unsigned long lastMetricsLog = millis();
+
+    for (;;) {
+        esp_task_wdt_reset();
+
+        // Wake up at least once a second to keep feeding the watchdog and syncing the log
+        if (xQueueReceive(logQueue, &record, pdMS_TO_TICKS(1000)) == pdTRUE) {
+            writeLogRecord(record);
+        }
+
+        // Commit the partial tail block once it is older than SD_SYNC_INTERVAL_MS
+        pollLogFile();
+
+        // Logging stopped and every record is written: close the log and trim its pre-allocated
+        // space, so the card can be pulled (retried each pass until the data is on the card)
+        if (!logState && (!sdLogger.isEnded() || sdLogger.needsTrim()) && uxQueueMessagesWaiting(logQueue) == 0
+            && closeLogFile()) {
+            CONSOLE_INFO("Log File:\t\t\t\tClosed (%s, %lu bytes)\n", sdLogger.filePath(),
+                         (unsigned long)sdLogger.syncedLength());
+        }
+        if (sdLogger.isOpen() && storageError && sdLogger.buffered() == 0) {
+            storageError = false;
+        }
+
+        if (millis() - lastStatsPrint >= SD_STATS_INTERVAL_MS) {
+            lastStatsPrint = millis();
+            printStorageStats();
+        }
+
+        // The storage task owns the card, so the periodic metrics dump is written from here
+        if (metricsLogMinutes > 0 && millis() - lastMetricsLog >= (unsigned long)metricsLogMinutes * 60000UL) {
+            lastMetricsLog = millis();
+            if (!writeMetricsLog(get_epoch())) {
+                CONSOLE_WARN("Metrics Log (%s):\t\tWrite failed\n", METRICS_FILENAME);
+            }
+        }
+    }
+}
+
+
+void uiTask(void *parameter) { //MARK: UI task
+    esp_task_wdt_add(NULL);
+    ui_event event;
+
+    for (;;) {
+        esp_task_wdt_reset();
+
+        // Sleep until a display update arrives, but refresh clock, LED and button at least every UI_REFRESH_MS
+        bool haveEvent = xQueueReceive(uiQueue, &event, pdMS_TO_TICKS(UI_REFRESH_MS)) == pdTRUE;
+
+        // Drawing only changes the shadow frame; the flush takes the I2C lock if any cell changed
+        while (haveEvent) {
+            handleUiEvent(event);
+            haveEvent = xQueueReceive(uiQueue, &event, 0) == pdTRUE;
+        }
+        buttonState();
+        if (!holdErrorScreen()) {
+            displayTimeStamp();
+            updateLcdPage();
+            displayStatusLine();
+        }
+        halLcdFlush();
+
+        updateLEDFromState();
+        handleSerialCommands();
+    }
+}
+
+
+void consoleTask(void *parameter) { //MARK: Console task
+    // Not watched by the watchdog: at priority 0 it only runs when every other task is idle
+    static char text[METRICS_TEXT_SIZE];
+    for (;;) {
+        consoleLog.drain();
+        // The metrics dump doesn't fit a console message; the only other Serial writer, so no interleaving
+        if (metricsDumpRequested) {
+            metricsDumpRequested = false;
+            formatMetrics(text, sizeof(text));
+            halPrint("=== METRICS ===\n");
+            halPrint(text);
+        }
+        vTaskDelay(pdMS_TO_TICKS(CONSOLE_DRAIN_MS));
+    }
+}
+
+
+void savePeerTableToNVS() {
+    // Written only when the table changed, to spare the flash
+    static char text[MAX_SERVANTS * PEER_MAC_TEXT_SIZE + 1];
+    static char stored[MAX_SERVANTS * PEER_MAC_TEXT_SIZE + 1];
+    size_t len = peers.toText(text, sizeof(text));
+
+    Preferences prefs;
+    if (len == 0 || !prefs.begin(PEER_NVS_NAMESPACE, false)) {
+        return;
+    }
+    size_t storedLen = prefs.getBytes("table", stored, sizeof(stored));
+    if (storedLen != len || memcmp(stored, text, len) != 0) {
+        prefs.putBytes("table", text, len);
+        Serial.println("Peer Table NVS Copy:\t\t\tUpdated");
+    }
+    prefs.end();
+}
+
+
+void loadPeerTable() { //MARK: Load peer table
+    // The SD card file wins; NVS keeps a copy of the last table read from it, so the fleet
+    // survives a card swap, and the config.h defaults are the last resort
+    static char text[PEER_FILE_MAX_SIZE];
+    const char *source = NULL;
+
+    File file = SD.open(PEER_FILENAME, FILE_READ);
+    if (file) {
+        size_t len = file.read((uint8_t *)text, sizeof(text));
+        file.close();
+        if (peers.loadFromText(text, len) > 0) {
+            source = PEER_FILENAME;
+            savePeerTableToNVS();
+        } else {
+            Serial.printf("Peer Table (%s):\t\tInvalid, ignored\n", PEER_FILENAME);
+        }
+    }
+
+    if (source == NULL) {
+        Preferences prefs;
+        if (prefs.begin(PEER_NVS_NAMESPACE, true)) {
+            size_t len = prefs.getBytes("table", text, sizeof(text));
+            prefs.end();
+            if (len > 0 && peers.loadFromText(text, len) > 0) {
+                source = "NVS";
+            }
+        }
+    }
+
+    if (source == NULL) {
+        peers.clear();
+        for (size_t i = 0; i < sizeof(defaultServantAddresses) / sizeof(defaultServantAddresses[0]); i++) {
+            peers.add(defaultServantAddresses[i]);
+        }
+        source = "defaults";
+    }
+
+    Serial.printf("Peer Table (%s):\t\t%d servant(s)\n", source, peers.count());
+    for (int i = 0; i < peers.count(); i++) {
+        char mac[PEER_MAC_TEXT_SIZE];
+        formatMac(peers.mac(i), mac);
+        Serial.printf("  S%d: %s\n", i+1, mac);
+    }
+}
+
+
+bool addServantPeer(int servantIndex) {
+    esp_now_peer_info_t peer = {};
+    memcpy(peer.peer_addr, peers.mac(servantIndex), 6);
+    peer.channel = 0;
+    peer.encrypt = false;
+    peer.ifidx = WIFI_IF_STA;  // Set the interface to STA
+    return esp_now_add_peer(&peer) == ESP_OK;
+}
+
+
+bool addSyncBeaconPeer() {
+    // Broadcast peer for the sync beacon; broadcast frames are not acknowledged
+    esp_now_peer_info_t peer = {};
+    memcpy(peer.peer_addr, syncBeaconAddress, 6);
+    peer.channel = 0;
+    peer.encrypt = false;
+    peer.ifidx = WIFI_IF_STA;  // Set the interface to STA
+    return esp_now_add_peer(&peer) == ESP_OK;
+}
+
+
 void setup() {  //MARK: Setup
     Serial.begin(115200);
 
+    // LCD and RTC share the I2C bus; every access after setup() goes through its lock
+    halBegin();
+
     // Initialize watchdog timer (30 seconds timeout)
     esp_task_wdt_init(30, true);
     esp_task_wdt_add(NULL);
 
+#ifdef FORMAT_BENCHMARK
+    runFormatBenchmark();
+#endif
+
     Serial.println("\n\n\nSELF CHECK:\n");
 
 
@@ -1111,10 +972,11 @@ void setup() {  //MARK: Setup
     //------------------ BUTTON - INIT - END ------------------
 
     //------------------ NEOPIXEL - INIT - BEGIN ------------------
-    strip.begin(); // Initialize the NeoPixel library
-    strip.show();  // Initialize all pixels to 'off'
+    if (!statusLed.begin()) {       // Pixel off, blink timer ready
+        Serial.println("Status LED Timer:\t\t\tFailed");
+    }
     //------------------ NEOPIXEL - INIT - END ------------------
-    updateStatusLED(1);
+    statusLed.setPattern(LED_YELLOW);
 
     //------------------ LCD - INIT - BEGIN ------------------
     lcd.init();                     // initialize the lcd
@@ -1130,250 +992,168 @@ void setup() {  //MARK: Setup
         B01000,
         B00000
         };
-    lcd.createChar(0, tickMark);    // Create a new custom character
+    lcd.createChar(0, tickMark);    // Create a new custom character (LCD_CHAR_TICK)
+    halLcdInvalidate();             // Controller was just reset: the next flush draws every cell
 
-    lcd.setCursor(8, 0);            // set cursor to first column, first row
-    lcd.print("Boot...");        // print message
+    halLcdWrite(8, 0, "Boot...");   // print message
+    halLcdFlush(true);
     //------------------ LCD - INIT - END ------------------
 
+    //------------------ SD CARD - INIT - BEGIN ------------------
+    while(!SD.begin(CS_PIN, SPI, SD_SPI_FREQUENCY, SD_MOUNT_POINT)){
+        Serial.println("SD Card Mount Failed");
+        displayError("SD Card Mount Failed", 4);
+        statusLed.setPattern(LED_RED_BLINK);
+    }
+
+    uint8_t cardType = SD.cardType();
+
+    while(cardType == CARD_NONE){
+        statusLed.setPattern(LED_RED_BLINK);
+        Serial.println("SD Card Mount:\t\t\t\tFailed");
+        displayError("SD Card Mount Failed", 2);
+    }
+    Serial.println("SD Card Mount:\t\t\t\tSuccess");
+
+    // Store-and-forward buffer for card outages; without PSRAM a missing card costs records again
+    if (sdLogger.reserveBacklog(SD_BACKLOG_SIZE)) {
+        Serial.printf("SD Backlog (PSRAM):\t\t\tSuccess (%lu KB)\n", (unsigned long)(SD_BACKLOG_SIZE / 1024));
+    } else {
+        Serial.println("SD Backlog (PSRAM):\t\t\tFailed");
+    }
+    //------------------ SD CARD - INIT - END ------------------
+
+    //------------------ PEER TABLE - INIT - BEGIN ------------------
+    loadPeerTable();
+    //------------------ PEER TABLE - INIT - END ------------------
+
     //------------------ ESP-NNOW -INIT - BEGIN ------------------
-    // Set WiFi mode for ESP-NOW (will be temporarily changed for WiFi connection later)
+    // Set WiFi mode for ESP-NOW (the time sync joins the access point only while not logging)
     WiFi.mode(WIFI_STA);
+    esp_wifi_set_channel(ESPNOW_CHANNEL, WIFI_SECOND_CHAN_NONE);
 
     while (esp_now_init() != ESP_OK) {
         Serial.println("ESP-NOW Initialization:\t\t\tFailed");
         displayError("Error init ESP-NOW", 6);
-        updateStatusLED(4);
+        statusLed.setPattern(LED_RED);
         delay(3000);
     }
     Serial.println("ESP-NOW Initialization:\t\t\tSuccess");
 
-    esp_now_register_send_cb(OnDataSent);
-    esp_now_register_recv_cb(OnDataRecv);
+    halRadioSetCallbacks(OnDataRecv, OnDataSent);
 
-    for (int i = 0; i < 4; i++) {
-        memcpy(peerInfo[i].peer_addr, broadcastAddresses[i], 6);
-        peerInfo[i].channel = 0;  
-        peerInfo[i].encrypt = false;
-        peerInfo[i].ifidx = WIFI_IF_STA;  // Set the interface to STA
-        
-        if (esp_now_add_peer(&peerInfo[i]) != ESP_OK){
-            Serial.println("ESP-NOW Peer Addition (Target " + String(i+1) + "):\tFailed");
-            displayError("Failed to add peer", 5);
-            updateStatusLED(4);
-            return;
+    // A servant that can't be registered must not stop the others from being logged: it stays
+    // offline and the acquisition task retries the registration
+    bool peersFailed = false;
+    for (int i = 0; i < peers.count(); i++) {
+        if (!addServantPeer(i)){
+            Serial.println("ESP-NOW Peer Addition (Target " + String(i+1) + "):\tFailed (retried later)");
+            peerFailed[i] = true;
+            peersFailed = true;
         }else{
             Serial.print("ESP-NOW Peer Addition (Target " + String(i+1) + "):\tSuccess\n");
         }
     }
-    //------------------ ESP-NNOW -INIT - END ------------------
-
-    //------------------ SD CARD - INIT - BEGIN ------------------
-    while(!SD.begin(CS_PIN)){
-        Serial.println("SD Card Mount Failed");
-        displayError("SD Card Mount Failed", 4);
-        updateStatusLED(5);
-    }
-
-    uint8_t cardType = SD.cardType();
-
-    while(cardType == CARD_NONE){
-        updateStatusLED(5);
-        Serial.println("SD Card Mount:\t\t\t\tFailed");
-        displayError("SD Card Mount Failed", 2);
+    if (peersFailed) {
+        displayError("Failed to add peer", 5);
+        statusLed.setPattern(LED_RED);
+        delay(3000);            // Long enough to read before the start screen replaces it
     }
-    Serial.println("SD Card Mount:\t\t\t\tSuccess");
-
-    strncpy(fileName, "/data_master.csv", sizeof(fileName));
-    File file = SD.open(fileName, FILE_APPEND);
-
-    if (!file) {
-        Serial.println("Writing to file:\t\t\tFailed");
-        updateStatusLED(5);
-        displayError("Failed to open file", 2);
+    if (!addSyncBeaconPeer()) {
+        Serial.println("ESP-NOW Peer Addition (Broadcast):\tFailed");
     } else {
-        // Add header if file is empty
-        if (file.size() == 0) {
-            file.println("timestamp,target_no,sensor_no,temperature");
-        }
-        Serial.println("Writing to file:\t\t\tSuccess");
-        file.close();
+        Serial.println("ESP-NOW Peer Addition (Broadcast):\tSuccess");
     }
-
-    //------------------ SD CARD - INIT - END ------------------
+    //------------------ ESP-NNOW -INIT - END ------------------
 
     //------------------ RTC - INIT - BEGIN ------------------
   if (! rtc.begin()) {
     Serial.println("Init RTC:\t\t\t\tFailed");
-    updateStatusLED(4);
+    statusLed.setPattern(LED_RED);
     while (true){}
     } else {
       Serial.print("Init RTC:\t\t\t\tSuccess (");
       Serial.print(get_timestamp());
       Serial.println(")"); 
   }
-    //------------------ RTC - INIT - END ------------------
 
-    //------------------ WIFI & NTP TIME SYNC - BEGIN ------------------
-    // Feed watchdog before starting WiFi/NTP operations
-    esp_task_wdt_reset();
-    Serial.println("Starting WiFi/NTP initialization...");
-    
-    // Initialize time management tracking
-    lastNTPSync = 0;
-    lastRTCCheck = millis();
-    ntpSyncSuccessful = false;
-    
-    // Attempt WiFi connection and NTP time sync
-    Serial.println("Attempting WiFi/NTP time synchronization...");
-    if (connectToWiFi()) {
-        if (syncTimeWithNTP()) {
-            Serial.println("WiFi and NTP setup completed successfully");
-        } else {
-            Serial.println("WiFi connected but NTP sync failed - continuing with RTC time");
-        }
-        // Disconnect WiFi to free resources for ESP-NOW
-        WiFi.disconnect();
-        delay(100);
+    // Millisecond timebase: anchored on an RTC second edge, then no RTC reads per timestamp
+    bool squareWave = halRtcBeginSquareWave();
+    if (timebase.begin(squareWave)) {
+        Serial.printf("Timebase:\t\t\t\tSuccess (%s)\n", timebase.stats().squareWave ? "SQW edge"
+                      : squareWave ? "RTC reads, no SQW edges seen" : "RTC reads");
     } else {
-        Serial.println("WiFi connection failed, continuing without NTP sync - using RTC time only");
+        Serial.println("Timebase:\t\t\t\tFailed (reading the RTC per timestamp)");
     }
-    
-    // Reset WiFi mode for ESP-NOW compatibility
-    WiFi.mode(WIFI_STA);
-    delay(100);
-    
-    // Set WiFi channel to 1 for ESP-NOW consistency
-    esp_wifi_set_channel(1, WIFI_SECOND_CHAN_NONE);
-    
-    // Reinitialize ESP-NOW after WiFi operations
-    esp_now_deinit();
-    delay(100);
-    while (esp_now_init() != ESP_OK) {
-        Serial.println("ESP-NOW Reinitialization:\t\t\tFailed");
-        delay(1000);
+    //------------------ RTC - INIT - END ------------------
+
+    //------------------ LOG FILE - INIT - BEGIN ------------------
+    // The log file stays open from here on; the header is added if the file is empty
+    bool logFileOpen = segmentedLogging
+        ? openSegmentedLog(binaryLogging, get_epoch())
+        : openLogFile(binaryLogging ? BIN_FILENAME : SD_FILENAME, binaryLogging, get_epoch());
+
+    if (!logFileOpen) {
+        Serial.println("Writing to file:\t\t\tFailed");
+        statusLed.setPattern(LED_RED_BLINK);
+        displayError("Failed to open file", 2);
+    } else {
+        sdLogger.sync();
+        Serial.printf("Writing to file:\t\t\tSuccess (%s)\n", sdLogger.filePath());
     }
-    Serial.println("ESP-NOW Reinitialization:\t\t\tSuccess");
-    
-    // Re-register the callback and peers
-    esp_now_register_recv_cb(OnDataRecv);
-    for (int i = 0; i < 4; i++) {
-        esp_now_peer_info_t peerInfo;
-        memcpy(peerInfo.peer_addr, broadcastAddresses[i], 6);
-        peerInfo.channel = 0;
-        peerInfo.encrypt = false;
-        peerInfo.ifidx = WIFI_IF_STA;  // Set the interface to STA
-        
-        if (esp_now_add_peer(&peerInfo) != ESP_OK) {
-            Serial.printf("ESP-NOW Peer Re-addition (Target %d):\t\tFailed\n", i + 1);
-        } else {
-            Serial.printf("ESP-NOW Peer Re-addition (Target %d):\t\tSuccess\n", i + 1);
-        }
+
+    // Records the last reset caught between acquisition and a log sync
+    uint32_t journaled = sampleJournal.begin(&journalMemory);
+    if (journaled > 0 && logFileOpen) {
+        Serial.printf("Journal Replay:\t\t\t\t%lu of %lu record(s)\n", (unsigned long)replayLogJournal(),
+                      (unsigned long)journaled);
     }
+    //------------------ LOG FILE - INIT - END ------------------
+
+    //------------------ WIFI & NTP TIME SYNC - BEGIN ------------------
+    // No waiting here: the acquisition task syncs in the background while the master is idle (time_sync.h)
+    lastRTCCheck = millis();
+    time_sync_config syncConfig = {WIFI_SSID, WIFI_PASSWORD, NTP_SERVER, ntpPort, GMT_OFFSET_SEC + DAYLIGHT_OFFSET_SEC};
+    timeSync.begin(syncConfig);
+    timeSync.request();
+    Serial.printf("NTP Time Sync:\t\t\t\tScheduled (%s:%u)\n", NTP_SERVER, (unsigned)ntpPort);
     
     // Update system time from RTC regardless of WiFi/NTP success
     updateSystemTimeFromRTC();
     //------------------ WIFI & NTP TIME SYNC - END ------------------
 
-    lcd.clear();
-    lcd.setCursor(4, 0);            // set cursor to first column, first row
-    lcd.print("Connecting...");     // print message
+    halLcdClear();
+    halLcdWrite(4, 0, "Connecting..."); // print message
+    halLcdFlush(true);
 
     Serial.println("\nSELF-CHECK COMPLET\n\n\n");
     
-    updateStatusLED(0);
-}
-
-
-void loop() {
-    // Feed the watchdog timer
-    esp_task_wdt_reset();
-
-    // Background time management (check for RTC validity and periodic NTP sync)
-    manageTimeSync();
-
-    static unsigned long previousTempUpdate = tempUpdateIntervall;
-    unsigned long currentTempUpdate = millis();
-    if (currentTempUpdate - previousTempUpdate >= tempUpdateIntervall && logState == false) {   // Update displayed temperature every 10 seconds
-        previousTempUpdate = currentTempUpdate;
-        getAllTemps(false);
-    }
-    
-    displayTimeStamp();
-
-    static unsigned long previousConnectStat = pingCheckIntervall;
-    unsigned long currentConnectStat = millis();
-    if (currentConnectStat - previousConnectStat >= pingCheckIntervall) {   // Update the connection status only every second, to avoid callback issues
-        previousConnectStat = currentConnectStat;
-        displayConnectionStatus();
-        sendLogState(logState);
-    }
+    statusLed.setPattern(LED_OFF);
 
-    // Only enter error loop if we have no connections AND we're not actively logging
-    // This prevents logging mode from being interrupted by temporary connection issues
-    while(numConnections == 0 && !logState){
-        // Feed the watchdog timer in the error loop
-        esp_task_wdt_reset();
-        
-        lcd.setCursor(0, 3);
-        lcd.print("ERROR: No connection");
-        displayConnectionStatus();
-        updateStatusLED(5);
-        displayTimeStamp();
-        
-        // Small delay to prevent tight loop
-        delay(100);
-        
-        // Check connections again to see if we can exit the error loop
-        displayConnectionStatus();
-        if (numConnections > 0) {
-            break; // Exit the error loop when any connection is established
-        }
+    //------------------ TASKS - INIT - BEGIN ------------------
+    logQueue = xQueueCreate(LOG_QUEUE_LENGTH, sizeof(log_record));
+    uiQueue = xQueueCreate(UI_QUEUE_LENGTH, sizeof(ui_event));
+    if (logQueue == NULL || uiQueue == NULL) {
+        Serial.println("Task Queue Creation:\t\t\tFailed");
+        displayError("Out of memory", 7);
+        statusLed.setPattern(LED_RED);
+        while (true) {}
     }
 
-    buttonState();
-
-    if(logState){
-        // Allow logging with any number of connected servants (even just 1)
-        static unsigned long lastLEDDebug = 0;
-        if (millis() - lastLEDDebug > 5000) { // Debug every 5 seconds
-            lastLEDDebug = millis();
-            if (numConnections > 0) {
-                if (numConnections >= 3) {
-                    Serial.println("LED: Constant Green (3+ servants logging)");
-                } else {
-                    Serial.println("LED: Constant Yellow (1-2 servants logging)");
-                }
-            } else {
-                Serial.println("LED: Blink Yellow (no connections but logging active)");
-            }
-        }
-        
-        if (numConnections > 0) {
-            if (numConnections >= 3) {
-                updateStatusLED(3); // Constant green - 3 or more servants logging
-            } else {
-                updateStatusLED(1); // Constant yellow - fewer than 3 servants but still logging
-            }
-            logLoop(); // logLoop handles its own display messages
-        } else {
-            // No connections but logging is active - keep trying
-            updateStatusLED(6); // Blink yellow - no connections but logging active
-            // Still call logLoop to maintain timing, but it will skip data collection
-            logLoop(); // logLoop will display "Logging: No connection"
-        }
+    // From here on, messages are queued; the console task prints them
+    consoleLog.setDirect(false);
+    xTaskCreatePinnedToCore(consoleTask, "console", CONSOLE_TASK_STACK, NULL, CONSOLE_TASK_PRIORITY, &consoleTaskHandle, CONSOLE_TASK_CORE);
+    xTaskCreatePinnedToCore(uiTask, "ui", UI_TASK_STACK, NULL, UI_TASK_PRIORITY, &uiTaskHandle, UI_TASK_CORE);
+    xTaskCreatePinnedToCore(storageTask, "storage", STORAGE_TASK_STACK, NULL, STORAGE_TASK_PRIORITY, &storageTaskHandle, STORAGE_TASK_CORE);
+    xTaskCreatePinnedToCore(acquisitionTask, "acquisition", ACQ_TASK_STACK, NULL, ACQ_TASK_PRIORITY, &acquisitionTaskHandle, ACQ_TASK_CORE);
+    Serial.println("Task Startup:\t\t\t\tSuccess");
+    //------------------ TASKS - INIT - END ------------------
+}
 
-    }else{
-        // Not logging - show idle status
-        if (numConnections >= 3){
-            updateStatusLED(2); // Blink green - ready with 3+ servants
-        } else if (numConnections > 0) {
-            updateStatusLED(6); // Blink yellow - ready with fewer servants
-        } else {
-            updateStatusLED(5); // Blink red - no connections
-        }
 
-        lcd.setCursor(0, 3);
-        lcd.print("Idle (ready to log) ");
-    }
+void loop() {
+    // All work runs in the pinned acquisition, storage and UI tasks started by setup(),
+    // so the Arduino loop task is no longer needed
+    esp_task_wdt_delete(NULL);
+    vTaskDelete(NULL);
 }
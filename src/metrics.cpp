@@ -0,0 +1,187 @@
+/*
+ * Metrics - TX Master ESP32
+ *
+ * See metrics.h.
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include "metrics.h"
+#include "acquisition.h"
+#include "log_storage.h"
+#include "time_sync.h"
+#include "timebase.h"
+#include "console_log.h"
+#include "hal.h"
+
+metrics_registry metrics;
+
+
+//MARK: Histogram
+Histogram::Histogram() : samples(0), largest(0) {
+    for (int i = 0; i < METRICS_BUCKETS; i++) {
+        buckets[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+
+void Histogram::record(uint32_t value) {
+    int bucket = value == 0 ? 0 : 32 - __builtin_clz(value);
+    if (bucket >= METRICS_BUCKETS) {
+        bucket = METRICS_BUCKETS - 1;
+    }
+    buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    samples.fetch_add(1, std::memory_order_relaxed);
+
+    // Single writer, so a plain compare and store is enough for the maximum
+    if (value > largest.load(std::memory_order_relaxed)) {
+        largest.store(value, std::memory_order_relaxed);
+    }
+}
+
+
+void Histogram::reset() {
+    for (int i = 0; i < METRICS_BUCKETS; i++) {
+        buckets[i].store(0, std::memory_order_relaxed);
+    }
+    samples.store(0, std::memory_order_relaxed);
+    largest.store(0, std::memory_order_relaxed);
+}
+
+
+uint32_t Histogram::percentile(uint32_t percent) const {
+    uint32_t total = count();
+    if (total == 0) {
+        return 0;
+    }
+    uint64_t rank = ((uint64_t)total * percent + 99) / 100;   // 1-based rank of the percentile sample
+    uint64_t seen = 0;
+    for (int i = 0; i < METRICS_BUCKETS; i++) {
+        seen += buckets[i].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            uint32_t bound = i == 0 ? 0 : (uint32_t)((1ULL << i) - 1);
+            uint32_t max = maximum();
+            return (i == METRICS_BUCKETS - 1 || bound > max) ? max : bound;
+        }
+    }
+    return maximum();
+}
+
+
+size_t Histogram::format(char *out, size_t size) const {
+    uint32_t total = count();
+    int len = total == 0
+        ? snprintf(out, size, "n=0")
+        : snprintf(out, size, "n=%lu p50<=%lu p95<=%lu p99<=%lu max=%lu", (unsigned long)total,
+                   (unsigned long)percentile(50), (unsigned long)percentile(95), (unsigned long)percentile(99),
+                   (unsigned long)maximum());
+    return len < 0 ? 0 : ((size_t)len < size ? (size_t)len : size - 1);
+}
+
+
+//MARK: Registry
+void resetMetrics() {
+    for (int i = 0; i < MAX_SERVANTS; i++) {
+        metrics.rttUs[i].reset();
+        metrics.timeouts[i].reset();
+        metrics.fastFails[i].reset();
+        metrics.latePackets[i].reset();
+    }
+    metrics.sendErrors.reset();
+    metrics.loopUs.reset();
+    metrics.logLatenessMs.reset();
+    metrics.missedDeadlines.reset();
+    metrics.droppedLogRecords.reset();
+    metrics.sendDelivered.reset();
+    metrics.sendFailed.reset();
+    metrics.sdWriteUs.reset();
+    metrics.journalReplayed.reset();
+}
+
+
+// Appends to out at *len, never past size - 1
+static void appendf(char *out, size_t size, size_t *len, const char *format, ...) {
+    if (*len + 1 >= size) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    int written = vsnprintf(out + *len, size - *len, format, args);
+    va_end(args);
+    if (written > 0) {
+        *len += (size_t)written < size - *len ? (size_t)written : size - *len - 1;
+    }
+}
+
+
+static void appendHistogram(char *out, size_t size, size_t *len, const char *name, const Histogram &histogram) {
+    char text[96];
+    histogram.format(text, sizeof(text));
+    appendf(out, size, len, "%s %s\n", name, text);
+}
+
+
+size_t formatMetrics(char *out, size_t size) {
+    size_t len = 0;
+    if (size == 0) {
+        return 0;
+    }
+    out[0] = '\0';
+
+    appendf(out, size, &len, "uptime_s %lu\n", (unsigned long)(halMillis() / 1000));
+    appendf(out, size, &len, "heap free=%lu min=%lu\n", (unsigned long)halFreeHeap(),
+            (unsigned long)halMinFreeHeap());
+    appendHistogram(out, size, &len, "loop_us", metrics.loopUs);
+
+    uint32_t delivered = metrics.sendDelivered.get();
+    uint32_t failed = metrics.sendFailed.get();
+    uint32_t reports = delivered + failed;
+    appendf(out, size, &len, "send delivered=%lu failed=%lu fail_pct=%.1f errors=%lu\n", (unsigned long)delivered,
+            (unsigned long)failed, reports > 0 ? failed * 100.0 / reports : 0.0,
+            (unsigned long)metrics.sendErrors.get());
+
+    const tracker_counters &requests = requestTracker.counters();
+    appendf(out, size, &len, "requests issued=%lu answered=%lu legacy=%lu expired=%lu late=%lu duplicate=%lu\n",
+            (unsigned long)requests.issued, (unsigned long)requests.accepted, (unsigned long)requests.legacy,
+            (unsigned long)requests.expired, (unsigned long)requests.late, (unsigned long)requests.duplicate);
+
+    for (int i = 0; i < peers.count(); i++) {
+        char text[96];
+        metrics.rttUs[i].format(text, sizeof(text));
+        appendf(out, size, &len, "rtt_us S%d %s timeouts=%lu late=%lu fast_fail=%lu srtt=%lu rttvar=%lu rto_ms=%lu\n",
+                i+1, text, (unsigned long)metrics.timeouts[i].get(), (unsigned long)metrics.latePackets[i].get(),
+                (unsigned long)metrics.fastFails[i].get(), (unsigned long)rttEstimator.srttUs(i),
+                (unsigned long)rttEstimator.rttvarUs(i), (unsigned long)rttEstimator.timeoutMs(i, (uint32_t)sendTimeout));
+    }
+    appendf(out, size, &len, "rx_ring max_depth=%u dropped=%lu unknown=%lu\n", (unsigned)rxRing.maxDepth(),
+            (unsigned long)rxRing.dropped(), (unsigned long)unknownPackets);
+
+    appendHistogram(out, size, &len, "log_lateness_ms", metrics.logLatenessMs);
+    appendf(out, size, &len, "log missed_deadlines=%lu dropped_records=%lu\n",
+            (unsigned long)metrics.missedDeadlines.get(), (unsigned long)metrics.droppedLogRecords.get());
+
+    appendHistogram(out, size, &len, "sd_write_us", metrics.sdWriteUs);
+    const sd_logger_stats &sd = sdLogger.stats();
+    appendf(out, size, &len, "sd bytes=%llu commits=%lu syncs=%lu failures=%lu dropped_bytes=%lu buffered=%u\n",
+            (unsigned long long)sd.bytesWritten, (unsigned long)sd.commits, (unsigned long)sd.syncs,
+            (unsigned long)sd.failures, (unsigned long)sd.droppedBytes, (unsigned)sdLogger.buffered());
+    appendf(out, size, &len, "sd_backlog used=%u capacity=%u peak=%u overflows=%lu\n", (unsigned)sdLogger.backlogUsed(),
+            (unsigned)sdLogger.backlogCapacity(), (unsigned)sdLogger.backlogPeak(),
+            (unsigned long)sd.backlogOverflows);
+    appendf(out, size, &len, "journal used=%u capacity=%u overflows=%lu replayed=%lu\n", (unsigned)sampleJournal.used(),
+            (unsigned)sampleJournal.capacity(), (unsigned long)sampleJournal.overflows(),
+            (unsigned long)metrics.journalReplayed.get());
+    const time_sync_stats &sync = timeSync.stats();
+    appendf(out, size, &len, "time_sync attempts=%lu ok=%lu failed=%lu deferred=%lu correction_s=%ld rtt_ms=%lu "
+            "radio_away_ms=%lu\n", (unsigned long)sync.attempts, (unsigned long)sync.successes,
+            (unsigned long)sync.failures, (unsigned long)sync.deferred, (long)sync.lastCorrectionS,
+            (unsigned long)sync.lastRttMs, (unsigned long)sync.lastDurationMs);
+    const timebase_stats &clock = timebase.stats();
+    appendf(out, size, &len, "timebase anchors=%lu steps=%lu rtc_reads=%lu drift_ppb=%ld error_us=%ld max_error_us=%lu "
+            "sqw=%d\n", (unsigned long)clock.anchors, (unsigned long)clock.steps, (unsigned long)clock.rtcReads,
+            (long)clock.driftPpb, (long)clock.lastErrorUs, (unsigned long)clock.maxErrorUs, clock.squareWave ? 1 : 0);
+    appendf(out, size, &len, "console depth=%u max_depth=%u slots=%u dropped=%lu printed=%lu\n",
+            (unsigned)consoleLog.depth(), (unsigned)consoleLog.maxDepth(), (unsigned)CONSOLE_SLOTS,
+            (unsigned long)consoleLog.dropped(), (unsigned long)consoleLog.printed());
+    return len;
+}
@@ -0,0 +1,741 @@
+/*
+ * Native Hardware Abstraction Layer - TX Master ESP32
+ *
+ * See hal_native.h. Single-threaded: radio callbacks run inside halDelay()
+ * and halRadioWait(), where the firmware would see them arrive from the
+ * WiFi task.
+ */
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+#include "config.h"
+#include "protocol.h"
+#include "rx_ring.h"
+#include "hal_native.h"
+#include "lcd_frame.h"
+#include "ntp_packet.h"
+
+typedef enum {
+    EVENT_TO_SERVANT,                       // Packet from the master reaches a servant
+    EVENT_TO_MASTER,                        // Packet from a servant reaches the master
+    EVENT_SEND_STATUS,                      // Delivery report for a packet the master sent
+    EVENT_SYNC_LATCH,                       // Servant latches its sensors after a sync beacon
+    EVENT_STREAM_FRAME,                     // Servant pushes its next stream frame
+    EVENT_NTP_REQUEST,                      // NTP request reaches the server
+    EVENT_NTP_REPLY                         // NTP reply reaches the master
+} sim_event_type;
+
+typedef struct sim_event {
+    sim_event_type type;
+    int servant;
+    bool delivered;
+    uint32_t generation;                    // EVENT_STREAM_FRAME: stale once the servant's generation moved on
+    std::vector<uint8_t> data;
+} sim_event;
+
+typedef struct sim_servant {
+    uint8_t mac[6];
+    bool logging;
+    bool streaming;
+    uint32_t periodMs;
+    uint32_t frameSeq;
+    uint32_t generation;
+    uint64_t statusUs;                      // Due time of the latest send status report (reports keep send order)
+} sim_servant;
+
+static hal_native_config config;
+static hal_native_stats stats;
+static uint64_t nowUs = 0;
+static uint32_t randomState = 1;
+static bool quiet = false;
+static bool cardPresent = true;
+static int64_t writeLimit = -1;                         // Bytes the card takes before writes fall short
+static std::multimap<uint64_t, sim_event> events;      // Equal due times keep insertion order
+static std::vector<sim_servant> servants;
+static hal_receive_cb receiveCallback = NULL;
+static hal_sent_cb sentCallback = NULL;
+static LcdFrame lcdFrame;
+static char lcdText[LCD_ROWS][LCD_COLS];                // Simulated display memory
+static uint32_t lastLcdFlush = 0;
+
+static const uint8_t broadcastMac[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+
+#define SIM_JOIN_MS             1500        // Association with the simulated access point
+#define SIM_DNS_MS              40          // Name lookup of the NTP server
+#define SIM_SERVER_IP           0x0A00000AUL    // 10.0.0.10, network byte order
+
+static int64_t rtcAdjustUs = 0;             // halRtcSetEpoch() minus the free-running RTC
+static bool radioAway = false;              // Between halNetConnect() and halNetRestore()
+static uint64_t joinedUs = 0;
+static uint64_t resolvedUs = 0;
+static bool resolving = false;
+static std::vector<std::vector<uint8_t> > datagrams;   // Received and not yet read
+
+
+static uint32_t nextRandom() {
+    // xorshift32: fast, and the same sequence on every host for a given seed
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return randomState;
+}
+
+
+static bool packetLost() {
+    if (config.lossPercent > 0 && (nextRandom() % 10000) < (uint32_t)(config.lossPercent * 100)) {
+        stats.packetsLost++;
+        return true;
+    }
+    return false;
+}
+
+
+static uint64_t airTimeUs() {
+    uint32_t jitterUs = config.jitterMs > 0 ? nextRandom() % (config.jitterMs * 1000 + 1) : 0;
+    return (uint64_t)config.latencyMs * 1000 + jitterUs;
+}
+
+
+static void schedule(uint64_t dueUs, const sim_event &event) {
+    events.insert(std::make_pair(dueUs, event));
+}
+
+
+void halNativeBegin(const hal_native_config &newConfig) {
+    config = newConfig;
+    config.servants = std::max(0, std::min(config.servants, MAX_SERVANTS));
+    config.sensorCount = std::max(0, std::min(config.sensorCount, MAX_SENSORS));
+    memset(&stats, 0, sizeof(stats));
+    randomState = config.seed != 0 ? config.seed : 1;
+    events.clear();
+    rtcAdjustUs = 0;
+    radioAway = false;
+    resolving = false;
+    datagrams.clear();
+
+    servants.assign(config.servants, sim_servant());
+    for (int i = 0; i < config.servants; i++) {
+        memset(&servants[i], 0, sizeof(sim_servant));
+        halNativeServantMac(i, servants[i].mac);
+    }
+
+    // Display freshly initialised: blank, and the frame redraws everything on its next flush
+    memset(lcdText, ' ', sizeof(lcdText));
+    halLcdClear();
+    halLcdInvalidate();
+    halStorageRemount();
+}
+
+
+void halNativeServantMac(int index, uint8_t mac[6]) {
+    // Locally administered unicast addresses, one per servant
+    const uint8_t base[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x00};
+    memcpy(mac, base, 6);
+    mac[5] = (uint8_t)(index + 1);
+}
+
+
+void halNativeSetQuiet(bool newQuiet) {
+    quiet = newQuiet;
+}
+
+
+void halNativeSetCardPresent(bool present) {
+    cardPresent = present;
+}
+
+
+void halNativeLimitWrites(int64_t bytes) {
+    writeLimit = bytes;
+}
+
+
+const hal_native_stats &halNativeStats() {
+    stats.lcdRuns = lcdFrame.stats().runs;
+    stats.lcdCells = lcdFrame.stats().cells;
+    return stats;
+}
+
+
+//MARK: Simulated servants
+static int readings(int servant, uint8_t *out, size_t size, uint8_t *flags) {
+    // Slightly different, slowly drifting values per servant and sensor
+    float values[MAX_SENSORS];
+    float drift = (float)((nowUs / 1000000) % 600) / 600.0f;
+    for (int i = 0; i < config.sensorCount; i++) {
+        values[i] = 20.0f + servant * 0.5f + i * 0.05f + drift + (int)(nextRandom() % 21 - 10) / 100.0f;
+    }
+
+    if (config.sensorCount == LEGACY_SENSOR_COUNT) {
+        *flags = 0;
+        memcpy(out, values, LEGACY_SENSOR_COUNT * sizeof(float));
+        return LEGACY_SENSOR_COUNT * sizeof(float);
+    }
+    *flags = PACKET_FLAG_SENSOR_BLOCK;
+    return (int)encodeSensorValues(out, size, values, config.sensorCount, SENSOR_ENCODING_CENTI);
+}
+
+
+static void reply(int servant, uint64_t sendUs, int32_t actionID, uint32_t seq, uint8_t flags,
+                  const uint8_t *payload, size_t len) {
+    packet_header header = {actionID, PROTOCOL_MAGIC, PROTOCOL_VERSION, flags, seq};
+    sim_event event = {EVENT_TO_MASTER, servant, true, 0, std::vector<uint8_t>(sizeof(header) + len)};
+    memcpy(event.data.data(), &header, sizeof(header));
+    memcpy(event.data.data() + sizeof(header), payload, len);
+
+    if (!packetLost()) {
+        schedule(sendUs + airTimeUs(), event);
+    }
+}
+
+
+static void replyReadings(int servant, uint64_t sendUs, int32_t actionID, uint32_t seq,
+                          const uint8_t *prefix, size_t prefixLen) {
+    uint8_t payload[RX_PACKET_MAX_LEN];
+    uint8_t flags;
+    if (prefixLen > 0) {
+        memcpy(payload, prefix, prefixLen);
+    }
+    int len = readings(servant, payload + prefixLen, sizeof(payload) - prefixLen, &flags);
+    reply(servant, sendUs, actionID, seq, flags, payload, prefixLen + len);
+}
+
+
+static void scheduleFrame(int servant) {
+    sim_event event = {EVENT_STREAM_FRAME, servant, true, servants[servant].generation, std::vector<uint8_t>()};
+    schedule(nowUs + (uint64_t)servants[servant].periodMs * 1000, event);
+}
+
+
+static void servantReceive(int servant, const std::vector<uint8_t> &data) {
+    sim_servant &unit = servants[servant];
+    packet_info info;
+    if (!parsePacket(data.data(), data.size(), &info)) {
+        return;
+    }
+    float value = 0;
+    if (info.payloadLen >= sizeof(value)) {
+        memcpy(&value, info.payload, sizeof(value));
+    }
+
+    switch (info.actionID) {
+    case 1001: {
+        float alive = 1.0f;
+        reply(servant, nowUs + 1000, 1001, info.seq, 0, (const uint8_t *)&alive, sizeof(alive));
+        break;
+    }
+    case 3001:
+        replyReadings(servant, nowUs + (uint64_t)config.processingMs * 1000, 2001, info.seq, NULL, 0);
+        break;
+    case 1002:
+    case 1003:
+        unit.logging = info.actionID == 1002;
+        break;
+    case 1004: {
+        // A repeated 1004 with the same period must not disturb the running schedule
+        uint32_t periodMs = std::max((uint32_t)value, (uint32_t)STREAM_MIN_PERIOD_MS);
+        if (!unit.streaming || periodMs != unit.periodMs) {
+            if (!unit.streaming) {
+                unit.frameSeq = 0;
+            }
+            unit.streaming = true;
+            unit.periodMs = periodMs;
+            unit.generation++;
+            scheduleFrame(servant);
+        }
+        break;
+    }
+    case 1005:
+        unit.streaming = false;
+        unit.generation++;
+        break;
+    case 1006:
+        if (data.size() >= sizeof(sync_beacon_packet)) {
+            sync_beacon_packet beacon;
+            memcpy(&beacon, data.data(), sizeof(beacon));
+            sim_event event = {EVENT_SYNC_LATCH, servant, true, 0, data};
+            schedule(nowUs + (uint64_t)beacon.sampleDelayMs * 1000, event);
+        }
+        break;
+    }
+}
+
+
+static void servantLatch(int servant, const std::vector<uint8_t> &data) {
+    // The servant only knows the beacon time and its own delay, like the firmware on the units
+    sync_beacon_packet beacon;
+    memcpy(&beacon, data.data(), sizeof(beacon));
+    uint32_t latchMs = beacon.epochMs + beacon.sampleDelayMs;
+    sync_sample_time time = {beacon.epoch + latchMs / 1000, (uint16_t)(latchMs % 1000), beacon.sampleDelayMs};
+    replyReadings(servant, nowUs + (uint64_t)config.processingMs * 1000, 2003, beacon.header.seq,
+                  (const uint8_t *)&time, sizeof(time));
+}
+
+
+//MARK: Simulated NTP server
+static uint64_t serverUnixMs() {
+    return (uint64_t)config.startEpoch * 1000 + nowUs / 1000 + config.ntpOffsetMs;
+}
+
+
+static void ntpServe(const std::vector<uint8_t> &request) {
+    ntp_timestamp origin;
+    if (!ntpParseRequest(request.data(), request.size(), &origin)) {
+        return;
+    }
+    stats.ntpRequests++;
+    ntp_timestamp now = ntpFromUnixMs(serverUnixMs());
+    sim_event reply = {EVENT_NTP_REPLY, -1, true, 0, std::vector<uint8_t>(NTP_PACKET_SIZE)};
+    ntpBuildReply(reply.data.data(), origin, now, now, 2);
+    if (!packetLost()) {
+        schedule(nowUs + airTimeUs(), reply);
+    }
+}
+
+
+static void runEvent(const sim_event &event) {
+    switch (event.type) {
+    case EVENT_TO_SERVANT:
+        servantReceive(event.servant, event.data);
+        break;
+    case EVENT_TO_MASTER:
+        stats.packetsToMaster++;
+        if (receiveCallback != NULL && !radioAway) {
+            receiveCallback(servants[event.servant].mac, event.data.data(), (int)event.data.size());
+        }
+        break;
+    case EVENT_SEND_STATUS:
+        if (sentCallback != NULL) {
+            sentCallback(event.data.data(), event.delivered);
+        }
+        break;
+    case EVENT_SYNC_LATCH:
+        servantLatch(event.servant, event.data);
+        break;
+    case EVENT_STREAM_FRAME:
+        if (servants[event.servant].streaming && event.generation == servants[event.servant].generation) {
+            stats.streamFrames++;
+            replyReadings(event.servant, nowUs, 2002, ++servants[event.servant].frameSeq, NULL, 0);
+            scheduleFrame(event.servant);
+        }
+        break;
+    case EVENT_NTP_REQUEST:
+        ntpServe(event.data);
+        break;
+    case EVENT_NTP_REPLY:
+        if (radioAway && nowUs >= joinedUs) {
+            datagrams.push_back(event.data);
+        }
+        break;
+    }
+}
+
+
+//MARK: Time
+uint32_t halMillis() {
+    return (uint32_t)(nowUs / 1000);
+}
+
+
+uint32_t halMicros() {
+    return (uint32_t)nowUs;
+}
+
+
+// Run everything that falls due up to targetUs, in time order. With stopOnReceive the clock
+// stops at the first packet delivered to the master; returns true in that case.
+static bool runUntil(uint64_t targetUs, bool stopOnReceive) {
+    while (!events.empty() && events.begin()->first <= targetUs) {
+        std::multimap<uint64_t, sim_event>::iterator next = events.begin();
+        nowUs = std::max(nowUs, next->first);
+        sim_event event = next->second;
+        events.erase(next);
+        runEvent(event);
+        if (stopOnReceive && (event.type == EVENT_TO_MASTER || (event.type == EVENT_SEND_STATUS && !event.delivered))) {
+            return true;
+        }
+    }
+    nowUs = targetUs;
+    return false;
+}
+
+
+void halDelay(uint32_t ms) {
+    runUntil(nowUs + (uint64_t)ms * 1000, false);
+}
+
+
+uint64_t halUptimeUs() {
+    return nowUs;
+}
+
+
+// The RTC runs rtcDriftPpm fast against the virtual clock (the ESP32 timer)
+static int64_t rtcUnixUs(uint64_t timerUs) {
+    return (int64_t)config.startEpoch * 1000000 + (int64_t)timerUs + (int64_t)timerUs * config.rtcDriftPpm / 1000000
+           + rtcAdjustUs;
+}
+
+
+uint32_t halRtcEpoch() {
+    return (uint32_t)(rtcUnixUs(nowUs) / 1000000);
+}
+
+
+void halRtcSetEpoch(uint32_t epoch) {
+    rtcAdjustUs += (int64_t)epoch * 1000000 - rtcUnixUs(nowUs);
+}
+
+
+uint64_t halRtcEdgeUs() {
+    if (!config.rtcSquareWave) {
+        return 0;
+    }
+    // Timer value at which the RTC started its current second
+    int64_t secondUs = rtcUnixUs(nowUs) / 1000000 * 1000000;
+    int64_t fromStartUs = secondUs - (int64_t)config.startEpoch * 1000000 - rtcAdjustUs;
+    int64_t edgeUs = fromStartUs * 1000000 / (1000000 + config.rtcDriftPpm);
+    while (edgeUs > 0 && rtcUnixUs((uint64_t)edgeUs) >= secondUs) {
+        edgeUs--;
+    }
+    while (rtcUnixUs((uint64_t)edgeUs + 1) < secondUs) {
+        edgeUs++;
+    }
+    return edgeUs > 0 ? (uint64_t)edgeUs + 1 : 0;
+}
+
+
+uint64_t halNativeRtcUnixUs() {
+    return (uint64_t)rtcUnixUs(nowUs);
+}
+
+
+//MARK: Radio
+void halRadioSetCallbacks(hal_receive_cb onReceive, hal_sent_cb onSent) {
+    receiveCallback = onReceive;
+    sentCallback = onSent;
+}
+
+
+bool halRadioWait(uint32_t timeoutMs) {
+    return runUntil(nowUs + (uint64_t)timeoutMs * 1000, true);
+}
+
+
+bool halRadioSend(const uint8_t *mac, const uint8_t *data, size_t len) {
+    if (len > RX_PACKET_MAX_LEN) {
+        return false;
+    }
+    if (radioAway) {
+        stats.offChannelSends++;            // On the access point's channel: nobody hears it
+    }
+    bool broadcast = memcmp(mac, broadcastMac, 6) == 0;
+    bool known = broadcast;
+
+    for (int i = 0; i < (int)servants.size(); i++) {
+        if (!broadcast && memcmp(mac, servants[i].mac, 6) != 0) {
+            continue;
+        }
+        known = true;
+        bool switchedOff = i >= (int)servants.size() - config.deadServants;
+        bool lost = radioAway || switchedOff;
+        if (!radioAway) {
+            stats.packetsToServants++;
+            lost = packetLost() || lost;
+        }
+        uint64_t arrivalUs = nowUs + airTimeUs();
+        if (!lost) {
+            sim_event event = {EVENT_TO_SERVANT, i, true, 0, std::vector<uint8_t>(data, data + len)};
+            schedule(arrivalUs, event);
+        }
+        if (!broadcast) {
+            // Unicast frames are acknowledged by the servant's radio, reported in send order;
+            // broadcasts always report success
+            servants[i].statusUs = std::max(arrivalUs, servants[i].statusUs);
+            sim_event status = {EVENT_SEND_STATUS, i, !lost, 0, std::vector<uint8_t>(mac, mac + 6)};
+            schedule(servants[i].statusUs, status);
+        }
+    }
+    if (broadcast) {
+        sim_event status = {EVENT_SEND_STATUS, -1, true, 0, std::vector<uint8_t>(mac, mac + 6)};
+        schedule(nowUs + (uint64_t)config.latencyMs * 1000, status);
+    }
+    return known;                           // Like esp_now_send() for a peer that was never added
+}
+
+
+//MARK: Network
+void halNetConnect(const char *ssid, const char *password) {
+    radioAway = true;
+    joinedUs = nowUs + (uint64_t)SIM_JOIN_MS * 1000;
+}
+
+
+int halNetStatus() {
+    if (!radioAway || !config.network) {
+        return HAL_NET_FAILED;
+    }
+    return nowUs >= joinedUs ? HAL_NET_READY : HAL_NET_PENDING;
+}
+
+
+void halNetResolve(const char *host) {
+    resolving = true;
+    resolvedUs = nowUs + (uint64_t)SIM_DNS_MS * 1000;
+}
+
+
+int halNetResolveStatus(uint32_t *ip) {
+    if (!resolving || halNetStatus() != HAL_NET_READY) {
+        return HAL_NET_FAILED;
+    }
+    if (nowUs < resolvedUs) {
+        return HAL_NET_PENDING;
+    }
+    *ip = SIM_SERVER_IP;
+    return HAL_NET_READY;
+}
+
+
+bool halNetSendUdp(uint32_t ip, uint16_t port, const uint8_t *data, size_t len) {
+    if (halNetStatus() != HAL_NET_READY) {
+        return false;
+    }
+    if (ip == SIM_SERVER_IP && !packetLost()) {
+        sim_event request = {EVENT_NTP_REQUEST, -1, true, 0, std::vector<uint8_t>(data, data + len)};
+        schedule(nowUs + airTimeUs(), request);
+    }
+    return true;
+}
+
+
+size_t halNetReceiveUdp(uint8_t *data, size_t len) {
+    if (datagrams.empty()) {
+        return 0;
+    }
+    size_t copied = std::min(len, datagrams.front().size());
+    memcpy(data, datagrams.front().data(), copied);
+    datagrams.erase(datagrams.begin());
+    return copied;
+}
+
+
+void halNetRestore() {
+    radioAway = false;
+    resolving = false;
+    datagrams.clear();
+}
+
+
+//MARK: LCD
+static void sendLcdRun(uint8_t col, uint8_t row, const char *text, size_t len) {
+    // The simulated display: tick marks shown as 'v'
+    for (size_t i = 0; i < len; i++) {
+        lcdText[row][col + i] = text[i] == LCD_CHAR_TICK ? 'v' : text[i];
+    }
+}
+
+
+void halLcdWrite(uint8_t col, uint8_t row, const char *text) {
+    lcdFrame.write(col, row, text);
+}
+
+
+void halLcdWriteField(uint8_t col, uint8_t row, uint8_t width, const char *text) {
+    lcdFrame.writeField(col, row, width, text);
+}
+
+
+void halLcdClear() {
+    lcdFrame.clear();
+}
+
+
+void halLcdInvalidate() {
+    lcdFrame.invalidate();
+}
+
+
+void halLcdFlush(bool immediate) {
+    if ((!immediate && halMillis() - lastLcdFlush < LCD_FLUSH_INTERVAL_MS) || !lcdFrame.dirty()) {
+        return;
+    }
+    lastLcdFlush = halMillis();
+    lcdFrame.flush(sendLcdRun);
+}
+
+
+void halNativePrintLcd(FILE *out) {
+    // What the display shows, i.e. as of the last flush
+    fprintf(out, "+%.*s+\n", LCD_COLS, "--------------------------------------------------------");
+    for (int row = 0; row < LCD_ROWS; row++) {
+        fprintf(out, "|%.*s|\n", LCD_COLS, lcdText[row]);
+    }
+    fprintf(out, "+%.*s+\n", LCD_COLS, "--------------------------------------------------------");
+}
+
+
+//MARK: SD card
+static std::string storagePath(const char *path) {
+    return std::string(config.storageRoot != NULL ? config.storageRoot : ".") + path;
+}
+
+
+bool halStorageRemount() {
+    if (!cardPresent) {
+        return false;
+    }
+    const char *root = config.storageRoot != NULL ? config.storageRoot : ".";
+    return mkdir(root, 0755) == 0 || errno == EEXIST;
+}
+
+
+bool halFileExists(const char *path) {
+    return access(storagePath(path).c_str(), F_OK) == 0;
+}
+
+
+bool halFileRename(const char *from, const char *to) {
+    return rename(storagePath(from).c_str(), storagePath(to).c_str()) == 0;
+}
+
+
+bool halFileTruncate(const char *path, uint32_t size) {
+    return cardPresent && truncate(storagePath(path).c_str(), (off_t)size) == 0;
+}
+
+
+bool halMakeDir(const char *path) {
+    return mkdir(storagePath(path).c_str(), 0755) == 0 || errno == EEXIST;
+}
+
+
+HalFile::HalFile() : file(NULL) {
+}
+
+
+bool HalFile::open(const char *path, int mode) {
+    close();
+    if (!cardPresent) {
+        return false;
+    }
+    std::string hostPath = storagePath(path);
+    if (mode == HAL_FILE_UPDATE) {
+        // "r+b" doesn't create the file, "w+b" would truncate it
+        file = fopen(hostPath.c_str(), "r+b");
+        if (file == NULL) {
+            file = fopen(hostPath.c_str(), "w+b");
+        }
+    } else {
+        file = fopen(hostPath.c_str(), mode == HAL_FILE_APPEND ? "ab" : "rb");
+    }
+    return file != NULL;
+}
+
+
+void HalFile::close() {
+    if (file != NULL) {
+        fclose(file);
+        file = NULL;
+    }
+}
+
+
+bool HalFile::isOpen() const {
+    return file != NULL;
+}
+
+
+size_t HalFile::read(uint8_t *data, size_t len) {
+    return file != NULL ? fread(data, 1, len, file) : 0;
+}
+
+
+size_t HalFile::write(const uint8_t *data, size_t len) {
+    if (file == NULL || !cardPresent) {
+        return 0;
+    }
+    if (writeLimit >= 0) {
+        // A card failing in the middle of a write: what fits is written, the rest is not
+        len = std::min(len, (size_t)writeLimit);
+        writeLimit -= len;
+    }
+    return fwrite(data, 1, len, file);
+}
+
+
+void HalFile::flush() {
+    if (file != NULL) {
+        fflush(file);
+    }
+}
+
+
+uint32_t HalFile::size() {
+    if (file == NULL) {
+        return 0;
+    }
+    long position = ftell(file);
+    fseek(file, 0, SEEK_END);
+    long end = ftell(file);
+    fseek(file, position, SEEK_SET);
+    return (uint32_t)end;
+}
+
+
+bool HalFile::seek(uint32_t position) {
+    return file != NULL && fseek(file, (long)position, SEEK_SET) == 0;
+}
+
+
+bool HalFile::preallocate(uint32_t length) {
+    // The host file system fills the new space with zeros (sparse where supported)
+    if (file == NULL) {
+        return false;
+    }
+    fflush(file);
+    return size() >= length || ftruncate(fileno(file), (off_t)length) == 0;
+}
+
+
+//MARK: System
+uint32_t halFreeHeap() {
+    return 0;                               // Not tracked on the host
+}
+
+
+uint32_t halMinFreeHeap() {
+    return 0;
+}
+
+
+void *halAllocLarge(size_t size) {
+    return malloc(size);
+}
+
+
+//MARK: Console
+void halPrintf(const char *format, ...) {
+    if (quiet) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+}
+
+
+void halPrint(const char *text) {
+    if (!quiet) {
+        fputs(text, stdout);
+    }
+}
@@ -0,0 +1,422 @@
+/*
+ * Simulation - TX Master ESP32 (native build)
+ *
+ * Runs the firmware's acquisition and logging code (acquisition.cpp,
+ * log_storage.cpp, sd_logger.cpp) on the host against the simulated
+ * servants, SD card, RTC and LCD of hal_native.cpp, and reports how long
+ * the poll cycles take. Time is virtual, so a day of cycles runs in seconds.
+ *
+ * Build and run:
+ *   pio run -e native
+ *   .pio/build/native/program --servants 8 --latency 5 --jitter 10 --loss 2 --cycles 500
+ *
+ * Options (defaults in brackets):
+ *   --mode fanout|serial|sync|stream   poll mode [fanout]
+ *   --servants N       simulated servants [4]
+ *   --sensors N        readings per servant, 9 = fixed floats, else a sensor_block [9]
+ *   --latency MS       one-way radio latency [3]
+ *   --jitter MS        extra latency, uniform 0..MS [4]
+ *   --processing MS    servant time from a 3001 request to its reply [20]
+ *   --loss PERCENT     packet loss, each direction [0]
+ *   --dead N           the last N servants are switched off (their frames are not acknowledged) [0]
+ *   --cycles N         poll cycles (stream mode: log intervals) [100]
+ *   --interval MS      log interval [LOG_INTERVAL_MS]
+ *   --timeout MS       longest reply timeout, sendTimeout of the firmware (adaptive below it) [1000]
+ *   --period MS        stream period [1000]
+ *   --seed N           random seed [1]
+ *   --sd DIR           directory that stands in for the SD card [sim_sd]
+ *   --binary           binary log instead of CSV
+ *   --segmented        log into pre-allocated segments in LOG_DIR (segmentedLogging)
+ *   --card-out S:SECONDS  pull the SD card S seconds into the run and insert it SECONDS later
+ *   --ntp-offset MS    simulated access point and NTP server, MS ahead of the RTC; syncs the time
+ *                      while the master is idle (time_sync.h)
+ *   --idle MS          idle time before logging starts [0]
+ *   --rtc-drift PPM    RTC rate against the ESP32 timer, for the timebase's drift correction [0]
+ *   --sqw              RTC second edges on RTC_SQW_PIN (else the timebase brackets them with RTC reads)
+ *   --verbose          show the firmware's Serial output
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include "config.h"
+#include "acquisition.h"
+#include "log_storage.h"
+#include "metrics.h"
+#include "lcd_frame.h"
+#include "record_format.h"
+#include "hal_native.h"
+#include "time_sync.h"
+#include "timebase.h"
+#include "console_log.h"
+
+// Settings (user variables of main.cpp)
+int sendTimeout         = 1000;
+bool fanOutPolling      = true;
+bool acceptLegacyReplies = true;
+bool streamingMode      = false;
+int streamPeriodMs      = 1000;
+bool syncSampling       = false;
+volatile bool logState  = false;
+
+#define PING_CHECK_MS           2000        // pingCheckIntervall of main.cpp
+#define FIRST_CYCLE_MS          1000        // Lets the first connection check finish, like the boot sequence
+
+static journal_memory journalMemory;        // RTC memory on the target; a process start is a cold boot
+static uint32_t loggedRecords = 0;
+static uint32_t missingRecords = 0;
+
+
+//MARK: Application hooks
+void queueLogRecord(uint32_t epoch, int servantID, const temp *t, int millis) {
+    // No storage task here: records are written straight away, through the same writer
+    log_record record = {};
+    record.epoch = epoch;
+    record.millis = millis;
+    record.servantID = servantID;
+    record.valid = (t != NULL);
+    if (t != NULL) {
+        record.data = *t;
+    }
+    if (t == NULL || t->count == 0) {
+        missingRecords++;                   // Logged as a NAN row
+    }
+    loggedRecords++;
+    record.journalSeq = sampleJournal.append(record);
+    writeLogRecord(record);
+}
+
+
+void postTemp(int targetID, const temp &t, bool isConnected) {
+    // Average of the plausible readings on row 2, like the firmware's first LCD page
+    if (targetID > SERVANTS_PER_PAGE) {
+        return;
+    }
+    char text[6];
+    float sum = 0;
+    int valid = 0;
+    for (int i = 0; i < t.count; i++) {
+        if (t.sens[i] >= -50.0 && t.sens[i] <= 100.0) {
+            sum += t.sens[i];
+            valid++;
+        }
+    }
+    if (!isConnected) {
+        snprintf(text, sizeof(text), "  -  ");
+    } else if (valid == 0) {
+        snprintf(text, sizeof(text), " --- ");
+    } else {
+        snprintf(text, sizeof(text), "%-5.1f", sum / valid);
+    }
+    halLcdWrite((targetID-1) * 5, 2, text);
+}
+
+
+void postConnections(const bool connections[]) {
+    char text[6];
+    for (int i = 0; i < peers.count() && i < SERVANTS_PER_PAGE; i++) {
+        snprintf(text, sizeof(text), "S%d:%c ", i+1, connections[i] ? LCD_CHAR_TICK : 'x');
+        halLcdWrite(i * 5, 1, text);
+    }
+}
+
+
+void reportError(const char *errorMessage, int errorNr) {
+    fprintf(stderr, "Error %d: %s\n", errorNr, errorMessage);
+}
+
+
+static void drawClock() {
+    // Row 0 like the firmware's UI task: redrawn every pass, only changed digits reach the display
+    char text[RECORD_TIMESTAMP_SIZE];
+    formatTimestamp(text, sizeof(text), halRtcEpoch(), -1);
+    halLcdWrite(0, 0, text);
+}
+
+
+static void onReceive(const uint8_t *mac, const uint8_t *data, int len) {
+    acquisitionReceive(mac, data, len);
+}
+
+
+static void onSent(const uint8_t *mac, bool delivered) {
+    acquisitionSent(mac, delivered);
+}
+
+
+//MARK: Report
+static void printCycleStats(const char *name, std::vector<uint32_t> &cycleUs) {
+    if (cycleUs.empty()) {
+        return;
+    }
+    std::sort(cycleUs.begin(), cycleUs.end());
+    uint64_t total = 0;
+    for (size_t i = 0; i < cycleUs.size(); i++) {
+        total += cycleUs[i];
+    }
+    printf("%s: %u cycles, min %.1f ms, avg %.1f ms, p50 %.1f ms, p95 %.1f ms, max %.1f ms\n", name,
+           (unsigned)cycleUs.size(), cycleUs.front() / 1000.0, total / 1000.0 / cycleUs.size(),
+           cycleUs[cycleUs.size() / 2] / 1000.0, cycleUs[cycleUs.size() * 95 / 100] / 1000.0,
+           cycleUs.back() / 1000.0);
+}
+
+
+static void printReport(std::vector<uint32_t> &cycleUs) {
+    halNativeSetQuiet(false);
+    printf("\n=== SIMULATION REPORT ===\n");
+    printCycleStats(syncSampling ? "Sync cycles" : (fanOutPolling ? "Fan-out cycles" : "Serial cycles"), cycleUs);
+
+    const hal_native_stats &radio = halNativeStats();
+    printf("Radio: %lu packets to servants, %lu to master, %lu lost\n", (unsigned long)radio.packetsToServants,
+           (unsigned long)radio.packetsToMaster, (unsigned long)radio.packetsLost);
+    const tracker_counters &requests = requestTracker.counters();
+    printf("Requests: issued %lu, answered %lu (legacy %lu), expired %lu, late %lu, duplicate %lu\n",
+           (unsigned long)requests.issued, (unsigned long)requests.accepted, (unsigned long)requests.legacy,
+           (unsigned long)requests.expired, (unsigned long)requests.late, (unsigned long)requests.duplicate);
+    printf("RX Ring: max depth %u/%u, dropped %lu, unknown %lu\n", (unsigned)rxRing.maxDepth(),
+           (unsigned)rxRing.capacity(), (unsigned long)rxRing.dropped(), (unsigned long)unknownPackets);
+    if (syncSampling) {
+        printf("Sync: %lu cycles, last skew %ld ms, max skew %lu ms\n",
+               (unsigned long)syncCycles, (long)lastSyncSkewMs, (unsigned long)maxSyncSkewMs);
+    }
+    if (streamingMode) {
+        printf("Stream: %lu frames sent, %lu logged, %lu lost, %lu duplicate, %lu stray\n",
+               (unsigned long)radio.streamFrames, (unsigned long)streamFrames, (unsigned long)streamLostFrames,
+               (unsigned long)streamDuplicateFrames, (unsigned long)streamStrayFrames);
+    }
+    printf("Log: %lu records (%lu without data) in %s\n", (unsigned long)loggedRecords, (unsigned long)missingRecords,
+           sdLogger.filePath());
+    printf("LCD: %lu cursor moves, %lu characters sent\n", (unsigned long)radio.lcdRuns, (unsigned long)radio.lcdCells);
+    const time_sync_stats &sync = timeSync.stats();
+    if (sync.attempts > 0) {
+        printf("Time sync: %lu attempts, %lu ok, %lu failed, %lu deferred; RTC %+ld s, round trip %lu ms, "
+               "radio away %lu ms; %lu NTP requests, %lu ESP-NOW sends off channel\n",
+               (unsigned long)sync.attempts, (unsigned long)sync.successes, (unsigned long)sync.failures,
+               (unsigned long)sync.deferred, (long)sync.lastCorrectionS, (unsigned long)sync.lastRttMs,
+               (unsigned long)sync.lastDurationMs, (unsigned long)radio.ntpRequests,
+               (unsigned long)radio.offChannelSends);
+    }
+    const timebase_stats &clock = timebase.stats();
+    printf("Timebase: %lu anchors (%s), %lu RTC reads, %lu steps; drift %+ld ppb measured, "
+           "error at the last anchor %+ld us (max %lu us), now %+lld us\n",
+           (unsigned long)clock.anchors, clock.squareWave ? "SQW edges" : "bracketing reads",
+           (unsigned long)clock.rtcReads, (unsigned long)clock.steps, (long)clock.driftPpb,
+           (long)clock.lastErrorUs, (unsigned long)clock.maxErrorUs,
+           (long long)(timebase.nowMs() * 1000 - halNativeRtcUnixUs()));
+    printStorageStats();
+    consoleLog.drain();
+
+    static char text[METRICS_TEXT_SIZE];
+    formatMetrics(text, sizeof(text));
+    printf("\n=== METRICS ===\n%s", text);
+    halLcdFlush(true);
+    halNativePrintLcd(stdout);
+}
+
+
+static void usage(const char *name) {
+    fprintf(stderr, "Usage: %s [--mode fanout|serial|sync|stream] [--servants N] [--sensors N] "
+                    "[--latency MS] [--jitter MS] [--processing MS] [--loss PERCENT] [--dead N] [--cycles N] "
+                    "[--interval MS] [--timeout MS] [--period MS] [--seed N] [--sd DIR] [--binary] [--segmented] "
+                    "[--card-out S:SECONDS] [--ntp-offset MS] [--idle MS] [--rtc-drift PPM] [--sqw] [--verbose]\n",
+            name);
+}
+
+
+int main(int argc, char **argv) { //MARK: Main
+    hal_native_config config = {};
+    config.servants = 4;
+    config.latencyMs = 3;
+    config.jitterMs = 4;
+    config.processingMs = 20;
+    config.lossPercent = 0;
+    config.sensorCount = LEGACY_SENSOR_COUNT;
+    config.startEpoch = 1753799415;         // 2025-07-29 14:30:15
+    config.seed = 1;
+    config.storageRoot = "sim_sd";
+
+    const char *mode = "fanout";
+    int cycles = 100;
+    uint32_t intervalMs = LOG_INTERVAL_MS;
+    bool binary = false;
+    bool segmented = false;
+    bool verbose = false;
+    unsigned long cardOutS = 0;
+    unsigned long cardOutSeconds = 0;
+    uint32_t idleMs = 0;
+
+    for (int i = 1; i < argc; i++) {
+        const char *option = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(option, "--binary") == 0) {
+            binary = true;
+            continue;
+        }
+        if (strcmp(option, "--segmented") == 0) {
+            segmented = true;
+            continue;
+        }
+        if (strcmp(option, "--sqw") == 0) {
+            config.rtcSquareWave = true;
+            continue;
+        }
+        if (strcmp(option, "--verbose") == 0) {
+            verbose = true;
+            continue;
+        }
+        if (value == NULL) {
+            usage(argv[0]);
+            return 2;
+        }
+        i++;
+        if (strcmp(option, "--mode") == 0) {
+            mode = value;
+        } else if (strcmp(option, "--servants") == 0) {
+            config.servants = atoi(value);
+        } else if (strcmp(option, "--sensors") == 0) {
+            config.sensorCount = atoi(value);
+        } else if (strcmp(option, "--latency") == 0) {
+            config.latencyMs = atoi(value);
+        } else if (strcmp(option, "--jitter") == 0) {
+            config.jitterMs = atoi(value);
+        } else if (strcmp(option, "--processing") == 0) {
+            config.processingMs = atoi(value);
+        } else if (strcmp(option, "--loss") == 0) {
+            config.lossPercent = (float)atof(value);
+        } else if (strcmp(option, "--dead") == 0) {
+            config.deadServants = atoi(value);
+        } else if (strcmp(option, "--cycles") == 0) {
+            cycles = atoi(value);
+        } else if (strcmp(option, "--interval") == 0) {
+            intervalMs = atoi(value);
+        } else if (strcmp(option, "--timeout") == 0) {
+            sendTimeout = atoi(value);
+        } else if (strcmp(option, "--period") == 0) {
+            streamPeriodMs = atoi(value);
+        } else if (strcmp(option, "--seed") == 0) {
+            config.seed = strtoul(value, NULL, 10);
+        } else if (strcmp(option, "--sd") == 0) {
+            config.storageRoot = value;
+        } else if (strcmp(option, "--ntp-offset") == 0) {
+            config.network = true;
+            config.ntpOffsetMs = atoi(value);
+        } else if (strcmp(option, "--rtc-drift") == 0) {
+            config.rtcDriftPpm = atoi(value);
+        } else if (strcmp(option, "--idle") == 0) {
+            idleMs = strtoul(value, NULL, 10);
+        } else if (strcmp(option, "--card-out") == 0) {
+            if (sscanf(value, "%lu:%lu", &cardOutS, &cardOutSeconds) != 2) {
+                usage(argv[0]);
+                return 2;
+            }
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    if (strcmp(mode, "fanout") != 0 && strcmp(mode, "serial") != 0 && strcmp(mode, "sync") != 0
+        && strcmp(mode, "stream") != 0) {
+        usage(argv[0]);
+        return 2;
+    }
+    fanOutPolling = strcmp(mode, "serial") != 0;
+    syncSampling = strcmp(mode, "sync") == 0;
+    streamingMode = strcmp(mode, "stream") == 0;
+
+    halNativeBegin(config);
+    halNativeSetQuiet(!verbose);
+    for (int i = 0; i < config.servants; i++) {
+        uint8_t mac[6];
+        halNativeServantMac(i, mac);
+        peers.add(mac);
+    }
+    halRadioSetCallbacks(onReceive, onSent);
+
+    sdLogger.reserveBacklog(SD_BACKLOG_SIZE);
+    bool opened = segmented ? openSegmentedLog(binary, halRtcEpoch())
+                            : openLogFile(binary ? BIN_FILENAME : SD_FILENAME, binary, halRtcEpoch());
+    if (!opened) {
+        fprintf(stderr, "Cannot open the log file in %s\n", config.storageRoot);
+        return 1;
+    }
+    sampleJournal.begin(&journalMemory);
+    timebase.begin(config.rtcSquareWave);
+
+    // Same schedule as the acquisition task in main.cpp, in 10 ms ticks of virtual time
+    std::vector<uint32_t> cycleUs;
+    uint32_t previousConnectStat = 0;
+    uint32_t previousCycle = 0;
+    int completed = 0;
+    refreshConnections();
+    if (config.network) {
+        time_sync_config sync = {"sim-ap", "", "ntp.sim", NTP_PORT, 0};
+        timeSync.begin(sync);
+        timeSync.request();             // Like the boot of the firmware
+    }
+    logState = idleMs == 0;
+    consoleLog.setDirect(false);        // Queued like in the firmware's tasks; printed by the drain below
+
+    while (completed < cycles) {
+        uint32_t iterationStart = halMicros();
+        uint32_t now = halMillis();
+        consoleLog.drain();
+        if (cardOutSeconds > 0) {
+            halNativeSetCardPresent(now < cardOutS * 1000 || now >= (cardOutS + cardOutSeconds) * 1000);
+        }
+
+        // The button of the firmware: logging starts after the idle time; the time sync gives the radio back first
+        bool startLogging = !logState && now >= idleMs;
+        timebase.poll();
+        timeSync.poll(!logState && !startLogging);
+        if (timeSync.ownsRadio()) {
+            halDelay(10);
+            continue;
+        }
+        if (startLogging) {
+            logState = true;
+            sendLogState(logState);
+        }
+        if (now - previousConnectStat >= PING_CHECK_MS) {
+            previousConnectStat = now;
+            refreshConnections();
+            sendLogState(logState);
+        }
+
+        bool due = logState && (completed == 0 ? now >= idleMs + FIRST_CYCLE_MS : now - previousCycle >= intervalMs);
+        if (isStreaming()) {
+            drainRxRing();      // Servants push their frames; they are logged as they are drained
+        } else if (due) {
+            uint32_t cycleStart = halMicros();
+            getAllTemps(true);
+            cycleUs.push_back(halMicros() - cycleStart);
+        }
+        if (due) {
+            previousCycle = now;
+            completed++;
+        }
+
+        pollLogFile();
+        drawClock();
+        halLcdFlush();
+        metrics.loopUs.record(halMicros() - iterationStart);
+        if (isStreaming()) {
+            halRadioWait(10);
+        } else {
+            halDelay(10);
+        }
+    }
+
+    logState = false;
+    sendLogState(logState);
+    halDelay(100);
+    drainRxRing();
+    syncLogFile();              // Synced length into the segment manifest, journal released
+    closeLogFile();             // Like the storage task once logging stopped: segment cut to its data
+    consoleLog.drain();
+
+    printReport(cycleUs);
+    return 0;
+}
@@ -0,0 +1,106 @@
+/*
+ * NTP Packet - TX Master ESP32
+ *
+ * See ntp_packet.h. Also built into tools/ntp_responder.
+ */
+
+#include <string.h>
+#include "ntp_packet.h"
+
+// Field offsets in the packet
+#define NTP_OFFSET_STRATUM      1
+#define NTP_OFFSET_POLL         2
+#define NTP_OFFSET_PRECISION    3
+#define NTP_OFFSET_REFERENCE_ID 12
+#define NTP_OFFSET_REFERENCE    16
+#define NTP_OFFSET_ORIGIN       24
+#define NTP_OFFSET_RECEIVE      32
+#define NTP_OFFSET_TRANSMIT     40
+
+
+static void putUint32(uint8_t *out, uint32_t value) {
+    out[0] = (uint8_t)(value >> 24);
+    out[1] = (uint8_t)(value >> 16);
+    out[2] = (uint8_t)(value >> 8);
+    out[3] = (uint8_t)value;
+}
+
+
+static uint32_t getUint32(const uint8_t *in) {
+    return ((uint32_t)in[0] << 24) | ((uint32_t)in[1] << 16) | ((uint32_t)in[2] << 8) | in[3];
+}
+
+
+static void putTimestamp(uint8_t *out, ntp_timestamp timestamp) {
+    putUint32(out, timestamp.seconds);
+    putUint32(out + 4, timestamp.fraction);
+}
+
+
+static ntp_timestamp getTimestamp(const uint8_t *in) {
+    ntp_timestamp timestamp = {getUint32(in), getUint32(in + 4)};
+    return timestamp;
+}
+
+
+ntp_timestamp ntpFromUnixMs(uint64_t unixMs) {
+    ntp_timestamp timestamp;
+    timestamp.seconds = (uint32_t)(unixMs / 1000 + NTP_UNIX_OFFSET);
+    timestamp.fraction = (uint32_t)(((unixMs % 1000) << 32) / 1000);
+    return timestamp;
+}
+
+
+uint64_t ntpToUnixMs(ntp_timestamp timestamp) {
+    uint64_t seconds = timestamp.seconds;
+    if (seconds < 0x80000000UL) {
+        seconds += 0x100000000ULL;          // Era 1, from 2036-02-07 on
+    }
+    return (seconds - NTP_UNIX_OFFSET) * 1000 + (((uint64_t)timestamp.fraction * 1000) >> 32);
+}
+
+
+void ntpBuildRequest(uint8_t packet[NTP_PACKET_SIZE], ntp_timestamp transmit) {
+    memset(packet, 0, NTP_PACKET_SIZE);
+    packet[0] = (NTP_VERSION << 3) | NTP_MODE_CLIENT;
+    putTimestamp(packet + NTP_OFFSET_TRANSMIT, transmit);
+}
+
+
+bool ntpParseRequest(const uint8_t *packet, size_t len, ntp_timestamp *transmit) {
+    if (len < NTP_PACKET_SIZE || (packet[0] & 0x07) != NTP_MODE_CLIENT) {
+        return false;
+    }
+    *transmit = getTimestamp(packet + NTP_OFFSET_TRANSMIT);
+    return true;
+}
+
+
+void ntpBuildReply(uint8_t packet[NTP_PACKET_SIZE], ntp_timestamp origin, ntp_timestamp receive,
+                   ntp_timestamp transmit, uint8_t stratum) {
+    memset(packet, 0, NTP_PACKET_SIZE);
+    packet[0] = (NTP_VERSION << 3) | NTP_MODE_SERVER;
+    packet[NTP_OFFSET_STRATUM] = stratum;
+    packet[NTP_OFFSET_POLL] = 4;
+    packet[NTP_OFFSET_PRECISION] = (uint8_t)-10;    // About a millisecond
+    memcpy(packet + NTP_OFFSET_REFERENCE_ID, "LOCL", 4);
+    putTimestamp(packet + NTP_OFFSET_REFERENCE, receive);
+    putTimestamp(packet + NTP_OFFSET_ORIGIN, origin);
+    putTimestamp(packet + NTP_OFFSET_RECEIVE, receive);
+    putTimestamp(packet + NTP_OFFSET_TRANSMIT, transmit);
+}
+
+
+bool ntpParseReply(const uint8_t *packet, size_t len, ntp_timestamp origin, ntp_reply *reply) {
+    if (len < NTP_PACKET_SIZE || (packet[0] & 0x07) != NTP_MODE_SERVER || (packet[0] >> 6) == NTP_LEAP_UNSYNCED) {
+        return false;
+    }
+    ntp_timestamp echoed = getTimestamp(packet + NTP_OFFSET_ORIGIN);
+    if (packet[NTP_OFFSET_STRATUM] == 0 || echoed.seconds != origin.seconds || echoed.fraction != origin.fraction) {
+        return false;
+    }
+    reply->stratum = packet[NTP_OFFSET_STRATUM];
+    reply->receive = getTimestamp(packet + NTP_OFFSET_RECEIVE);
+    reply->transmit = getTimestamp(packet + NTP_OFFSET_TRANSMIT);
+    return true;
+}
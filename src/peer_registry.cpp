@@ -0,0 +1,125 @@
+/*
+ * Peer Registry - TX Master ESP32
+ *
+ * See peer_registry.h.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "peer_registry.h"
+
+
+static int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+
+bool parseMac(const char *text, size_t len, uint8_t mac[6]) {
+    // Exactly six two-digit hex bytes separated by ':' or '-'
+    if (len != PEER_MAC_TEXT_SIZE - 1) {
+        return false;
+    }
+    for (int i = 0; i < 6; i++) {
+        int high = hexValue(text[i * 3]);
+        int low = hexValue(text[i * 3 + 1]);
+        if (high < 0 || low < 0) {
+            return false;
+        }
+        if (i < 5 && text[i * 3 + 2] != ':' && text[i * 3 + 2] != '-') {
+            return false;
+        }
+        mac[i] = (uint8_t)(high << 4 | low);
+    }
+    return true;
+}
+
+
+void formatMac(const uint8_t mac[6], char *out) {
+    snprintf(out, PEER_MAC_TEXT_SIZE, "%02X:%02X:%02X:%02X:%02X:%02X",
+             mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+}
+
+
+PeerRegistry::PeerRegistry() : entries(0) {
+    memset(macs, 0, sizeof(macs));
+}
+
+
+void PeerRegistry::clear() {
+    entries = 0;
+}
+
+
+bool PeerRegistry::add(const uint8_t mac[6]) {
+    if (entries >= MAX_SERVANTS || indexOf(mac) >= 0) {
+        return false;
+    }
+    memcpy(macs[entries], mac, 6);
+    entries++;
+    return true;
+}
+
+
+int PeerRegistry::indexOf(const uint8_t *mac) const {
+    for (int i = 0; i < entries; i++) {
+        if (memcmp(mac, macs[i], 6) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+
+int PeerRegistry::loadFromText(const char *text, size_t len) {
+    clear();
+
+    size_t pos = 0;
+    while (pos < len) {
+        size_t lineEnd = pos;
+        while (lineEnd < len && text[lineEnd] != '\n') {
+            lineEnd++;
+        }
+
+        // Strip the comment and surrounding white space
+        size_t start = pos;
+        size_t end = start;
+        while (end < lineEnd && text[end] != '#') {
+            end++;
+        }
+        while (start < end && (text[start] == ' ' || text[start] == '\t')) {
+            start++;
+        }
+        while (end > start && (text[end - 1] == ' ' || text[end - 1] == '\t' || text[end - 1] == '\r')) {
+            end--;
+        }
+
+        if (end > start) {
+            uint8_t mac[6];
+            if (!parseMac(text + start, end - start, mac)) {
+                clear();
+                return -1;
+            }
+            add(mac);   // Duplicates and entries beyond MAX_SERVANTS are ignored
+        }
+        pos = lineEnd + 1;
+    }
+    return entries;
+}
+
+
+size_t PeerRegistry::toText(char *out, size_t size) const {
+    if ((size_t)entries * PEER_MAC_TEXT_SIZE + 1 > size) {
+        return 0;
+    }
+    size_t len = 0;
+    for (int i = 0; i < entries; i++) {
+        formatMac(macs[i], out + len);
+        len += PEER_MAC_TEXT_SIZE - 1;
+        out[len++] = '\n';
+    }
+    out[len] = '\0';
+    return len;
+}
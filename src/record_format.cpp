@@ -0,0 +1,170 @@
+/*
+ * Record Formatting - TX Master ESP32
+ *
+ * See record_format.h. No heap, no printf on the common path: values are
+ * converted in fixed point (hundredths) with integer arithmetic.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "record_format.h"
+
+#define MAX_VALUE_CHARS         24          // Longest text formatFixed2 may produce
+#define MAX_FIXED_POINT         1.0e15      // Above this, hundredths no longer fit comfortably in 64 bits
+
+
+// Write an unsigned integer in decimal, returns the number of digits
+static size_t formatUnsigned(char *out, uint64_t value) {
+    char digits[20];
+    size_t count = 0;
+    do {
+        digits[count++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+
+    for (size_t i = 0; i < count; i++) {
+        out[i] = digits[count - 1 - i];
+    }
+    return count;
+}
+
+
+// Digit extraction of arduino-esp32's dtostrf(value, 4, 2) for non-negative input.
+// Only used for exact ties, where its floating point steps decide the last digit.
+static size_t formatLikeDtostrf(char *out, double number) {
+    number += 0.005;
+
+    double tenpow = 1.0;
+    int digitcount = 1;
+    double nextpow;
+    while (number >= (nextpow = 10.0 * tenpow)) {
+        tenpow = nextpow;
+        digitcount++;
+    }
+    number *= 1 + 2.220446049250313e-16;    // Same precision compensation as dtostrf (DBL_EPSILON)
+    number /= tenpow;
+
+    size_t len = 0;
+    digitcount += 2;
+    while (digitcount-- > 0) {
+        int digit = (int)number;
+        if (digit > 9) {
+            digit = 9;
+        }
+        out[len++] = (char)('0' + digit);
+        if (digitcount == 2) {
+            out[len++] = '.';
+        }
+        number -= digit;
+        number *= 10.0;
+    }
+    return len;
+}
+
+
+size_t formatFixed2(char *out, float value) {
+    if (isnan(value)) {
+        memcpy(out, "nan", 3);
+        return 3;
+    }
+    if (isinf(value)) {
+        memcpy(out, "inf", 3);  // String(float) prints "inf" for both signs
+        return 3;
+    }
+
+    double magnitude = value < 0 ? -(double)value : (double)value;
+    if (magnitude >= MAX_FIXED_POINT) {
+        // Far outside any sensor range; let the C library handle it without heap use
+        char text[64];
+        int len = snprintf(text, sizeof(text), "%.2f", (double)value);
+        if (len > MAX_VALUE_CHARS) {
+            len = MAX_VALUE_CHARS;
+        }
+        memcpy(out, text, len);
+        return len;
+    }
+
+    size_t len = 0;
+    if (value < 0) {
+        out[len++] = '-';               // dtostrf keeps the sign even if the value rounds to zero
+    }
+
+    // Exact ties (x.xx5, e.g. the DS18B20 step 24.375) come out of dtostrf rounded either way
+    // ("24.37" but "24.63"); replay its arithmetic there so logs stay byte-identical
+    double twoHundredths = magnitude * 200.0;
+    if (twoHundredths == floor(twoHundredths) && fmod(twoHundredths, 2.0) == 1.0) {
+        return len + formatLikeDtostrf(out + len, magnitude);
+    }
+
+    // Everywhere else plain rounding to hundredths gives the same digits
+    uint64_t hundredths = (uint64_t)(magnitude * 100.0 + 0.5);
+    len += formatUnsigned(out + len, hundredths / 100);
+    uint32_t fraction = (uint32_t)(hundredths % 100);
+    out[len++] = '.';
+    out[len++] = (char)('0' + fraction / 10);
+    out[len++] = (char)('0' + fraction % 10);
+    return len;
+}
+
+
+size_t formatTempRecord(char *out, size_t size, const char *timestamp, int servantID,
+                        const float *readings, int count) {
+    // The "timestamp,servant," prefix is identical for every row, build it once
+    char prefix[48];
+    size_t timestampLen = strlen(timestamp);
+    if (timestampLen > sizeof(prefix) - 16) {
+        return 0;
+    }
+    memcpy(prefix, timestamp, timestampLen);
+    size_t prefixLen = timestampLen;
+    prefix[prefixLen++] = ',';
+    if (servantID < 0) {
+        prefix[prefixLen++] = '-';
+        servantID = -servantID;
+    }
+    prefixLen += formatUnsigned(prefix + prefixLen, (uint64_t)servantID);
+    prefix[prefixLen++] = ',';
+
+    size_t pos = 0;
+    for (int sensor = 0; sensor < count; sensor++) {
+        // Prefix + sensor number + ',' + value + '\n' + terminator
+        if (pos + prefixLen + 10 + 1 + MAX_VALUE_CHARS + 2 > size) {
+            return 0;
+        }
+        memcpy(out + pos, prefix, prefixLen);
+        pos += prefixLen;
+        pos += formatUnsigned(out + pos, (uint64_t)(sensor + 1));
+        out[pos++] = ',';
+        pos += formatFixed2(out + pos, readings[sensor]);
+        out[pos++] = '\n';
+    }
+    if (pos >= size) {
+        return 0;
+    }
+    out[pos] = '\0';
+    return pos;
+}
+
+
+size_t formatNanRecord(char *out, size_t size, const char *timestamp, int servantID) {
+    int len = snprintf(out, size, "%s,%d,%d,NAN\n", timestamp, servantID, RECORD_NAN_SENSOR_NO);
+    if (len < 0 || (size_t)len >= size) {
+        return 0;
+    }
+    return len;
+}
+
+
+size_t formatTimestamp(char *out, size_t size, uint32_t epoch, int millis) {
+    time_t seconds = (time_t)epoch;
+    struct tm fields;
+    gmtime_r(&seconds, &fields);
+    size_t len = strftime(out, size, "%Y-%m-%d %H:%M:%S", &fields);
+    if (millis >= 0 && len > 0) {
+        int written = snprintf(out + len, size - len, ".%03d", millis);
+        len = written > 0 && (size_t)written < size - len ? len + written : size - 1;
+    }
+    return len;
+}
@@ -0,0 +1,128 @@
+/*
+ * Request Tracker - TX Master ESP32
+ *
+ * See request_tracker.h.
+ */
+
+#include <string.h>
+#include "request_tracker.h"
+
+
+RequestTracker::RequestTracker() : sequence(0) {
+    memset(pending, 0, sizeof(pending));
+    memset(answered, 0, sizeof(answered));
+    memset(answeredNext, 0, sizeof(answeredNext));
+    memset(&stats, 0, sizeof(stats));
+}
+
+
+uint32_t RequestTracker::nextSeq() {
+    if (++sequence == 0) {      // 0 marks a free slot, skip it on wrap-around
+        ++sequence;
+    }
+    return sequence;
+}
+
+
+uint32_t RequestTracker::issue(int servant, int32_t replyActionID, uint32_t nowUs) {
+    uint32_t seq = nextSeq();
+    track(servant, seq, replyActionID, nowUs);
+    return seq;
+}
+
+
+void RequestTracker::track(int servant, uint32_t seq, int32_t replyActionID, uint32_t nowUs) {
+    // Use a free slot, or replace the oldest request if the servant already has the maximum in flight
+    int slot = 0;
+    for (int i = 0; i < PROTOCOL_MAX_IN_FLIGHT; i++) {
+        if (pending[servant][i].seq == 0) {
+            slot = i;
+            break;
+        }
+        if ((int32_t)(pending[servant][i].sentUs - pending[servant][slot].sentUs) < 0) {
+            slot = i;
+        }
+    }
+    if (pending[servant][slot].seq != 0) {
+        stats.expired++;
+    }
+
+    pending[servant][slot].seq = seq;
+    pending[servant][slot].replyActionID = replyActionID;
+    pending[servant][slot].sentUs = nowUs;
+    stats.issued++;
+}
+
+
+void RequestTracker::complete(int servant, int slot) {
+    answered[servant][answeredNext[servant]] = pending[servant][slot].seq;
+    answeredNext[servant] = (answeredNext[servant] + 1) % TRACKER_HISTORY;
+    pending[servant][slot].seq = 0;
+    stats.accepted++;
+}
+
+
+match_result RequestTracker::match(int servant, uint32_t seq, int32_t actionID, uint32_t *sentUs) {
+    for (int i = 0; i < PROTOCOL_MAX_IN_FLIGHT; i++) {
+        if (pending[servant][i].seq == seq && seq != 0 && pending[servant][i].replyActionID == actionID) {
+            *sentUs = pending[servant][i].sentUs;
+            complete(servant, i);
+            return MATCH_ACCEPTED;
+        }
+    }
+
+    for (int i = 0; i < TRACKER_HISTORY; i++) {
+        if (answered[servant][i] == seq && seq != 0) {
+            stats.duplicate++;
+            return MATCH_DUPLICATE;
+        }
+    }
+
+    stats.late++;
+    return MATCH_LATE;
+}
+
+
+match_result RequestTracker::matchLegacy(int servant, int32_t actionID, uint32_t *seq, uint32_t *sentUs) {
+    // Without a sequence number the best guess is the oldest request that expects this action ID
+    int oldest = -1;
+    for (int i = 0; i < PROTOCOL_MAX_IN_FLIGHT; i++) {
+        if (pending[servant][i].seq != 0 && pending[servant][i].replyActionID == actionID
+            && (oldest < 0 || (int32_t)(pending[servant][i].sentUs - pending[servant][oldest].sentUs) < 0)) {
+            oldest = i;
+        }
+    }
+
+    if (oldest < 0) {
+        stats.late++;
+        return MATCH_LATE;
+    }
+
+    *seq = pending[servant][oldest].seq;
+    *sentUs = pending[servant][oldest].sentUs;
+    complete(servant, oldest);
+    stats.legacy++;
+    return MATCH_ACCEPTED;
+}
+
+
+void RequestTracker::cancel(int servant, uint32_t seq) {
+    for (int i = 0; i < PROTOCOL_MAX_IN_FLIGHT; i++) {
+        if (pending[servant][i].seq == seq && seq != 0) {
+            pending[servant][i].seq = 0;
+            stats.expired++;
+            return;
+        }
+    }
+}
+
+
+int RequestTracker::outstanding(int servant) const {
+    int count = 0;
+    for (int i = 0; i < PROTOCOL_MAX_IN_FLIGHT; i++) {
+        if (pending[servant][i].seq != 0) {
+            count++;
+        }
+    }
+    return count;
+}
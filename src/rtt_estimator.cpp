@@ -0,0 +1,96 @@
+/*
+ * RTT Estimator - TX Master ESP32
+ *
+ * See rtt_estimator.h.
+ */
+
+#include <algorithm>
+#include "rtt_estimator.h"
+
+
+RttEstimator::RttEstimator() {
+    for (int i = 0; i < MAX_SERVANTS; i++) {
+        srtt[i] = 0;
+        rttvar[i] = 0;
+        backoff[i] = 0;
+        sentFrames[i] = 0;
+        requestFrame[i] = 0;
+        lastSentMs[i] = 0;
+        reportedFrames[i].store(0, std::memory_order_relaxed);
+        failedFrame[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+
+void RttEstimator::sent(int servant, bool request, uint32_t nowMs) {
+    if (request && nowMs - lastSentMs[servant] >= RTT_REPORT_WINDOW_MS) {
+        // Every earlier frame had its window: a report still missing (lost, or late past the window)
+        // would shift the count onto this request, so numbering starts over from here
+        reportedFrames[servant].store(sentFrames[servant], std::memory_order_relaxed);
+    }
+    sentFrames[servant]++;
+    lastSentMs[servant] = nowMs;
+    if (request) {
+        requestFrame[servant] = sentFrames[servant];
+    }
+}
+
+
+void RttEstimator::notSent(int servant) {
+    // The radio refused the frame, so no report will come for it
+    if (requestFrame[servant] == sentFrames[servant]) {
+        requestFrame[servant] = 0;
+    }
+    sentFrames[servant]--;
+}
+
+
+void RttEstimator::acknowledged(int servant, bool delivered) {
+    // Reports for a servant come in send order, so the count of its reports is the number of the frame this one is for
+    uint32_t frame = reportedFrames[servant].fetch_add(1, std::memory_order_relaxed) + 1;
+    if (!delivered) {
+        failedFrame[servant].store(frame, std::memory_order_release);
+    }
+}
+
+
+bool RttEstimator::requestFailed(int servant) const {
+    if (requestFrame[servant] == 0) {
+        return false;
+    }
+    return (int32_t)(failedFrame[servant].load(std::memory_order_acquire) - requestFrame[servant]) >= 0;
+}
+
+
+void RttEstimator::sample(int servant, uint32_t rttUs) {
+    rttUs = std::max(rttUs, 1u);
+    if (srtt[servant] == 0) {
+        srtt[servant] = rttUs;
+        rttvar[servant] = rttUs / 2;
+    } else {
+        // RTTVAR first, from the deviation against the previous SRTT (alpha 1/8, beta 1/4)
+        uint32_t deviation = rttUs > srtt[servant] ? rttUs - srtt[servant] : srtt[servant] - rttUs;
+        rttvar[servant] = rttvar[servant] - rttvar[servant] / 4 + deviation / 4;
+        srtt[servant] = std::max(srtt[servant] - srtt[servant] / 8 + rttUs / 8, 1u);
+    }
+    backoff[servant] = 0;
+}
+
+
+void RttEstimator::timedOut(int servant) {
+    if (backoff[servant] < RTT_MAX_BACKOFF) {
+        backoff[servant]++;
+    }
+}
+
+
+uint32_t RttEstimator::timeoutMs(int servant, uint32_t maxMs) const {
+    if (srtt[servant] == 0) {
+        return maxMs;
+    }
+    uint64_t timeoutUs = (uint64_t)srtt[servant] + std::max(4 * (uint64_t)rttvar[servant],
+                                                            (uint64_t)RTT_GRANULARITY_MS * 1000);
+    timeoutUs <<= backoff[servant];
+    uint64_t ms = std::max((timeoutUs + 999) / 1000, (uint64_t)RTT_MIN_TIMEOUT_MS);
+    return (uint32_t)std::min(ms, (uint64_t)maxMs);
+}
@@ -0,0 +1,221 @@
+/*
+ * Sample Journal - TX Master ESP32
+ *
+ * See sample_journal.h.
+ */
+
+#include <string.h>
+#include <algorithm>
+#include "sample_journal.h"
+#include "binlog_format.h"
+
+#define JOURNAL_MAGIC           0x314E524A  // "JRN1"
+
+static_assert((JOURNAL_SIZE & (JOURNAL_SIZE - 1)) == 0, "JOURNAL_SIZE must be a power of two");
+
+typedef struct journal_entry {
+    uint16_t length;                        // Whole entry: this header, binlog_record and readings
+    uint16_t check;                         // Fletcher-16 of seq and the record
+    uint32_t seq;
+} journal_entry;
+
+#define JOURNAL_RECORD_MAX      (sizeof(binlog_record) + BINLOG_MAX_SENSORS * sizeof(float))
+
+
+static uint16_t checksum(uint32_t seq, const uint8_t *data, size_t len) {
+    uint16_t sum1 = 0;
+    uint16_t sum2 = 0;
+    for (int i = 0; i < 4; i++) {
+        sum1 = (sum1 + (uint8_t)(seq >> (8 * i))) % 255;
+        sum2 = (sum2 + sum1) % 255;
+    }
+    for (size_t i = 0; i < len; i++) {
+        sum1 = (sum1 + data[i]) % 255;
+        sum2 = (sum2 + sum1) % 255;
+    }
+    return (uint16_t)((sum2 << 8) | sum1);
+}
+
+
+// Same layout as a binary log record: fixed part and the readings the servant reported
+static size_t encodeRecord(const log_record &record, uint8_t *out) {
+    binlog_record fixed = {};
+    fixed.epoch = record.epoch;
+    fixed.millis = record.millis >= 0 ? record.millis : 0;
+    fixed.servantID = record.servantID;
+    fixed.flags = record.valid ? 0 : BINLOG_FLAG_NO_DATA;
+    if (record.millis >= 0) {
+        fixed.flags |= BINLOG_FLAG_HAS_MILLIS;
+    }
+    fixed.sensorCount = record.valid ? std::min(record.data.count, BINLOG_MAX_SENSORS) : 0;
+    memcpy(out, &fixed, sizeof(fixed));
+    memcpy(out + sizeof(fixed), record.data.sens, fixed.sensorCount * sizeof(float));
+    return sizeof(fixed) + fixed.sensorCount * sizeof(float);
+}
+
+
+static bool decodeRecord(const uint8_t *data, size_t len, log_record *record) {
+    binlog_record fixed;
+    if (len < sizeof(fixed)) {
+        return false;
+    }
+    memcpy(&fixed, data, sizeof(fixed));
+    if (fixed.sensorCount > BINLOG_MAX_SENSORS || len != sizeof(fixed) + fixed.sensorCount * sizeof(float)) {
+        return false;
+    }
+    memset(record, 0, sizeof(*record));
+    record->epoch = fixed.epoch;
+    record->millis = (fixed.flags & BINLOG_FLAG_HAS_MILLIS) ? (int16_t)fixed.millis : -1;
+    record->servantID = fixed.servantID;
+    record->valid = !(fixed.flags & BINLOG_FLAG_NO_DATA);
+    record->data.count = fixed.sensorCount;
+    memcpy(record->data.sens, data + sizeof(fixed), fixed.sensorCount * sizeof(float));
+    return true;
+}
+
+
+SampleJournal::SampleJournal() : memory(NULL) {
+}
+
+
+uint32_t SampleJournal::begin(journal_memory *memory) {
+    this->memory = memory;
+    uint32_t head = memory->head.load(std::memory_order_relaxed);
+    uint32_t tail = memory->tail.load(std::memory_order_relaxed);
+
+    // Cold boot (power on): the memory holds noise
+    if (memory->magic != JOURNAL_MAGIC || head - tail > JOURNAL_SIZE || memory->nextSeq == 0) {
+        memory->head.store(0, std::memory_order_relaxed);
+        memory->tail.store(0, std::memory_order_relaxed);
+        memory->overflows.store(0, std::memory_order_relaxed);
+        memory->nextSeq = 1;
+        memory->magic = JOURNAL_MAGIC;
+        return 0;
+    }
+
+    uint32_t entries = 0;
+    uint32_t position = start();
+    log_record record;
+    while (next(&position, &record)) {
+        entries++;
+    }
+    return entries;
+}
+
+
+uint32_t SampleJournal::append(const log_record &record) {
+    if (memory == NULL) {
+        return 0;
+    }
+    uint8_t payload[JOURNAL_RECORD_MAX];
+    size_t payloadLen = encodeRecord(record, payload);
+
+    journal_entry entry;
+    entry.length = (uint16_t)(sizeof(entry) + payloadLen);
+    uint32_t head = memory->head.load(std::memory_order_relaxed);
+    uint32_t tail = memory->tail.load(std::memory_order_acquire);
+    if (JOURNAL_SIZE - (head - tail) < entry.length) {
+        memory->overflows.fetch_add(1, std::memory_order_relaxed);
+        return 0;
+    }
+
+    entry.seq = memory->nextSeq;
+    memory->nextSeq = entry.seq + 1 != 0 ? entry.seq + 1 : 1;
+    entry.check = checksum(entry.seq, payload, payloadLen);
+    copyIn(head, &entry, sizeof(entry));
+    copyIn(head + sizeof(entry), payload, payloadLen);
+    // Publish the entry only after it is complete
+    memory->head.store(head + entry.length, std::memory_order_release);
+    return entry.seq;
+}
+
+
+void SampleJournal::release(uint32_t seq) {
+    if (memory == NULL || seq == 0) {
+        return;
+    }
+    uint32_t tail = memory->tail.load(std::memory_order_relaxed);
+    uint32_t head = memory->head.load(std::memory_order_acquire);
+    while (tail != head) {
+        journal_entry entry;
+        copyOut(tail, &entry, sizeof(entry));
+        if (entry.length < sizeof(entry) || entry.length > head - tail) {
+            tail = head;                    // Damaged; nothing after it can be trusted either
+            break;
+        }
+        if ((int32_t)(entry.seq - seq) > 0) {
+            break;
+        }
+        tail += entry.length;
+    }
+    memory->tail.store(tail, std::memory_order_release);
+}
+
+
+uint32_t SampleJournal::start() const {
+    return memory != NULL ? memory->tail.load(std::memory_order_acquire) : 0;
+}
+
+
+bool SampleJournal::next(uint32_t *position, log_record *record) const {
+    if (memory == NULL) {
+        return false;
+    }
+    uint32_t head = memory->head.load(std::memory_order_acquire);
+    if (*position == head) {
+        return false;
+    }
+
+    journal_entry entry;
+    copyOut(*position, &entry, sizeof(entry));
+    if (entry.length < sizeof(entry) + sizeof(binlog_record) || entry.length > sizeof(entry) + JOURNAL_RECORD_MAX
+        || entry.length > head - *position) {
+        return false;
+    }
+    uint8_t payload[JOURNAL_RECORD_MAX];
+    size_t payloadLen = entry.length - sizeof(entry);
+    copyOut(*position + sizeof(entry), payload, payloadLen);
+    if (checksum(entry.seq, payload, payloadLen) != entry.check || !decodeRecord(payload, payloadLen, record)) {
+        return false;
+    }
+    record->journalSeq = entry.seq;
+    *position += entry.length;
+    return true;
+}
+
+
+void SampleJournal::discard() {
+    if (memory != NULL) {
+        memory->tail.store(memory->head.load(std::memory_order_acquire), std::memory_order_release);
+    }
+}
+
+
+size_t SampleJournal::used() const {
+    if (memory == NULL) {
+        return 0;
+    }
+    return memory->head.load(std::memory_order_acquire) - memory->tail.load(std::memory_order_acquire);
+}
+
+
+uint32_t SampleJournal::overflows() const {
+    return memory != NULL ? memory->overflows.load(std::memory_order_relaxed) : 0;
+}
+
+
+void SampleJournal::copyIn(uint32_t position, const void *data, size_t len) {
+    // Entries wrap around the end of the ring
+    size_t offset = position % JOURNAL_SIZE;
+    size_t first = std::min(len, (size_t)JOURNAL_SIZE - offset);
+    memcpy(memory->data + offset, data, first);
+    memcpy(memory->data, (const uint8_t *)data + first, len - first);
+}
+
+
+void SampleJournal::copyOut(uint32_t position, void *data, size_t len) const {
+    size_t offset = position % JOURNAL_SIZE;
+    size_t first = std::min(len, (size_t)JOURNAL_SIZE - offset);
+    memcpy(data, memory->data + offset, first);
+    memcpy((uint8_t *)data + first, memory->data, len - first);
+}
@@ -0,0 +1,297 @@
+/*
+ * SD Logger - TX Master ESP32
+ *
+ * See sd_logger.h. Used by the storage task only, so no locking is needed.
+ */
+
+#include <string.h>
+#include <algorithm>
+#include "sd_logger.h"
+#include "metrics.h"
+
+
+SdLogger::SdLogger()
+    : headerLen(0), opened(false), ended(false), trimPending(false), capacity(0), filePosition(0), syncedPosition(0), used(0),
+      lastSync(0), lastReopenAttempt(0) {
+    path[0] = '\0';
+    memset(&statistics, 0, sizeof(statistics));
+}
+
+
+bool SdLogger::begin(const char *path, const void *header, size_t headerLen, uint32_t capacity, uint32_t dataEnd) {
+    strncpy(this->path, path, sizeof(this->path) - 1);
+    this->path[sizeof(this->path) - 1] = '\0';
+    this->headerLen = headerLen < sizeof(this->header) ? headerLen : sizeof(this->header);
+    memcpy(this->header, header, this->headerLen);
+    this->capacity = capacity;
+    filePosition = dataEnd;
+    syncedPosition = dataEnd;
+    used = 0;
+    lastSync = halMillis();
+    return reopen();
+}
+
+
+bool SdLogger::reserveBacklog(size_t size) {
+    if (backlog.capacity() > 0) {
+        return true;
+    }
+    uint8_t *memory = (uint8_t *)halAllocLarge(size);
+    backlog.begin(memory, size);
+    return memory != NULL;
+}
+
+
+bool SdLogger::reopen() {
+    lastReopenAttempt = halMillis();
+    ended = false;
+    trimPending = false;
+    close();
+
+    int mode = capacity > 0 ? HAL_FILE_UPDATE : HAL_FILE_APPEND;
+    if (!file.open(path, mode)) {
+        // The card may have been swapped or lost power: remount once and try again
+        if (!halStorageRemount() || !file.open(path, mode)) {
+            statistics.failures++;
+            return false;
+        }
+    }
+
+    if (capacity == 0) {
+        filePosition = file.size();
+    } else {
+        // A file shorter than the data written so far is a new one (card swapped): start it over
+        uint32_t existing = file.size();
+        if (existing < filePosition) {
+            filePosition = 0;
+            syncedPosition = 0;
+        }
+        // Allocated already unless it is new or was cut to its data by end()
+        if ((existing < capacity && !file.preallocate(capacity)) || !file.seek(filePosition)) {
+            statistics.failures++;
+            file.close();
+            return false;
+        }
+    }
+    opened = true;
+
+    // Add header if file is empty
+    if (filePosition == 0 && headerLen > 0) {
+        if (writeChunk(header, headerLen) != headerLen) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+bool SdLogger::end() {
+    if (!ended) {
+        // The backlog is written out SD_BACKLOG_DRAIN_SIZE per sync; the caller retries until it is empty
+        if (!sync() || length() != syncedPosition) {
+            return false;
+        }
+        close();
+        ended = true;
+        trimPending = capacity > 0;
+    } else if (trimPending && halMillis() - lastReopenAttempt < SD_RETRY_INTERVAL_MS) {
+        return false;                       // Don't hammer a missing card with the retries of the trim
+    }
+    if (trimPending) {
+        lastReopenAttempt = halMillis();
+        if (!halFileTruncate(path, syncedPosition)) {
+            statistics.failures++;
+            return false;
+        }
+        trimPending = false;
+    }
+    return true;
+}
+
+
+bool SdLogger::resume() {
+    return !ended || reopen();
+}
+
+
+void SdLogger::close() {
+    if (opened) {
+        file.close();
+        opened = false;
+    }
+}
+
+
+bool SdLogger::append(const char *data, size_t len) {
+    if (backlog.capacity() > 0) {
+        // Never wait for the card here: what doesn't fit queues in the backlog for poll()
+        if (backlog.used() == 0 && len <= sizeof(buffer) - used) {
+            memcpy(buffer + used, data, len);
+            used += len;
+            return true;
+        }
+        if (!backlog.push((const uint8_t *)data, len)) {
+            statistics.droppedBytes += len;
+            statistics.backlogOverflows++;
+            return false;
+        }
+        return true;
+    }
+
+    while (len > 0) {
+        size_t space = sizeof(buffer) - used;
+        if (space == 0) {
+            // Buffer full: a commit of whole blocks frees at least one block unless the card is gone
+            if (!commit(false) && used == sizeof(buffer)) {
+                statistics.droppedBytes += len;
+                return false;
+            }
+            continue;
+        }
+        size_t chunk = len < space ? len : space;
+        memcpy(buffer + used, data, chunk);
+        used += chunk;
+        data += chunk;
+        len -= chunk;
+    }
+
+    // Group commit: once less than one block of space is left, write all complete blocks in one go
+    if (sizeof(buffer) - used < SD_BLOCK_SIZE) {
+        return commit(false);
+    }
+    return true;
+}
+
+
+void SdLogger::poll() {
+    if (ended) {
+        return;
+    }
+    if (backlog.used() > 0 || sizeof(buffer) - used < SD_BLOCK_SIZE) {
+        drainBacklog();
+    }
+    if (halMillis() - lastSync >= SD_SYNC_INTERVAL_MS) {
+        sync();
+    }
+}
+
+
+bool SdLogger::sync() {
+    if (ended) {
+        return true;                        // Everything was synced by end()
+    }
+    lastSync = halMillis();
+    drainBacklog();
+    if (!commit(true)) {
+        return false;
+    }
+
+    uint32_t start = halMicros();
+    file.flush();                           // Writes the FAT and directory entry for the new file size
+    uint32_t duration = halMicros() - start;
+    syncedPosition = filePosition;
+
+    statistics.syncs++;
+    statistics.lastSyncUs = duration;
+    if (duration > statistics.maxSyncUs) {
+        statistics.maxSyncUs = duration;
+    }
+    return true;
+}
+
+
+bool SdLogger::commit(bool includePartial) {
+    if (used == 0) {
+        return true;
+    }
+    if (!opened) {
+        // Don't hammer a missing card: retry the remount at most every SD_RETRY_INTERVAL_MS
+        if (halMillis() - lastReopenAttempt < SD_RETRY_INTERVAL_MS || !reopen()) {
+            return false;
+        }
+    }
+
+    // Write up to the last block boundary of the file; the first commit after opening
+    // a file of odd size writes a short chunk that realigns all later writes
+    size_t length = used;
+    if (!includePartial) {
+        uint32_t end = ((filePosition + used) / SD_BLOCK_SIZE) * SD_BLOCK_SIZE;
+        if (end <= filePosition) {
+            return true;
+        }
+        length = end - filePosition;
+    }
+
+    // Bytes that reached the file leave the buffer even when the write fell short, so the
+    // retry after the remount doesn't write them twice
+    size_t written = writeChunk(buffer, length);
+    used -= written;
+    if (used > 0 && written > 0) {
+        memmove(buffer, buffer + written, used);
+    }
+    return written == length;
+}
+
+
+bool SdLogger::drainBacklog() {
+    // The buffered bytes are older than the backlog: their whole blocks go first
+    if (sizeof(buffer) - used < SD_BLOCK_SIZE && !commit(false)) {
+        return false;
+    }
+
+    size_t budget = SD_BACKLOG_DRAIN_SIZE;
+    while (backlog.used() > 0 && budget > 0) {
+        const uint8_t *data;
+        size_t len = std::min(backlog.peek(&data), budget);
+        if (opened && used == 0 && filePosition % SD_BLOCK_SIZE == 0 && len >= SD_BLOCK_SIZE) {
+            // Block-aligned with nothing buffered: whole blocks straight from the backlog in one write
+            len -= len % SD_BLOCK_SIZE;
+            size_t written = writeChunk(data, len);
+            backlog.pop(written);
+            budget -= written;
+            if (written != len) {
+                return false;
+            }
+            continue;
+        }
+
+        // Else through the buffer up to the next block boundary, which aligns the rest for the
+        // direct writes. While the card is gone this stops once the buffer is full.
+        size_t toBoundary = SD_BLOCK_SIZE - (filePosition + used) % SD_BLOCK_SIZE;
+        len = std::min(len, std::min(toBoundary, sizeof(buffer) - used));
+        memcpy(buffer + used, data, len);
+        used += len;
+        backlog.pop(len);
+        budget -= len;
+        if (((filePosition + used) % SD_BLOCK_SIZE == 0 || used == sizeof(buffer)) && !commit(false)) {
+            return false;
+        }
+    }
+    return backlog.used() == 0;
+}
+
+
+size_t SdLogger::writeChunk(const uint8_t *data, size_t len) {
+    uint32_t start = halMicros();
+    size_t written = file.write(data, len);
+    uint32_t duration = halMicros() - start;
+
+    statistics.lastWriteUs = duration;
+    if (duration > statistics.maxWriteUs) {
+        statistics.maxWriteUs = duration;
+    }
+    statistics.totalWriteUs += duration;
+    metrics.sdWriteUs.record(duration);
+
+    // A short write still extends the file by what it wrote; the caller keeps the rest
+    // buffered and the next commit remounts
+    statistics.bytesWritten += written;
+    filePosition += written;
+    if (written != len) {
+        statistics.failures++;
+        close();
+    } else {
+        statistics.commits++;
+    }
+    return written;
+}
@@ -0,0 +1,94 @@
+/*
+ * Status LED - TX Master ESP32
+ *
+ * See status_led.h. Firmware environments only (platformio.ini leaves this
+ * file out of the native build).
+ */
+
+#include "status_led.h"
+
+
+static uint32_t colorOf(led_pattern pattern) {
+    switch (pattern) {
+    case LED_YELLOW:
+    case LED_YELLOW_BLINK:
+        return Adafruit_NeoPixel::Color(255, 100, 0);
+    case LED_GREEN:
+    case LED_GREEN_BLINK:
+        return Adafruit_NeoPixel::Color(0, 255, 0);
+    case LED_RED:
+    case LED_RED_BLINK:
+        return Adafruit_NeoPixel::Color(255, 0, 0);
+    default:
+        return 0;
+    }
+}
+
+
+static bool patternBlinks(led_pattern pattern) {
+    return pattern == LED_GREEN_BLINK || pattern == LED_RED_BLINK || pattern == LED_YELLOW_BLINK;
+}
+
+
+StatusLed::StatusLed(uint8_t pin)
+    : strip(1, pin, NEO_GRB + NEO_KHZ800), blinkTimer(NULL), lock(NULL), currentPattern(LED_OFF),
+      currentBlinkMs(0), patternColor(0), blinkOn(false), shownColor(0), pushCount(0) {
+}
+
+
+bool StatusLed::begin() {
+    lock = xSemaphoreCreateMutex();
+    strip.begin();
+    strip.show();                           // All pixels off
+
+    esp_timer_create_args_t args = {};
+    args.callback = onBlinkTimer;
+    args.arg = this;
+    args.dispatch_method = ESP_TIMER_TASK;
+    args.name = "status_led";
+    return lock != NULL && esp_timer_create(&args, &blinkTimer) == ESP_OK;
+}
+
+
+void StatusLed::setPattern(led_pattern pattern, uint32_t blinkMs) {
+    // Called on every UI refresh with the same pattern: nothing to do then
+    if (pattern == currentPattern && (!patternBlinks(pattern) || blinkMs == currentBlinkMs)) {
+        return;
+    }
+    if (lock == NULL) {
+        return;
+    }
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+    esp_timer_stop(blinkTimer);             // Fails harmlessly if the timer wasn't running
+    currentPattern = pattern;
+    currentBlinkMs = blinkMs;
+    patternColor = colorOf(pattern);
+    blinkOn = true;                         // A new blink pattern starts with its on phase
+    push(patternColor);
+    if (patternBlinks(pattern) && blinkMs > 0) {
+        esp_timer_start_periodic(blinkTimer, (uint64_t)blinkMs * 1000);
+    }
+    xSemaphoreGive(lock);
+}
+
+
+void StatusLed::onBlinkTimer(void *arg) {
+    // esp_timer task: keeps blinking no matter what the application tasks are doing
+    StatusLed *led = (StatusLed *)arg;
+    xSemaphoreTake(led->lock, portMAX_DELAY);
+    led->blinkOn = !led->blinkOn;
+    led->push(led->blinkOn ? led->patternColor : 0);
+    xSemaphoreGive(led->lock);
+}
+
+
+void StatusLed::push(uint32_t color) {
+    if (color == shownColor) {
+        return;
+    }
+    shownColor = color;
+    strip.setPixelColor(0, color);
+    strip.show();
+    pushCount++;
+}
@@ -0,0 +1,179 @@
+/*
+ * Time Sync - TX Master ESP32
+ *
+ * See time_sync.h. Acquisition task only.
+ */
+
+#include <string.h>
+#include "time_sync.h"
+#include "timebase.h"
+#include "console_log.h"
+#include "hal.h"
+
+TimeSync timeSync;
+
+
+TimeSync::TimeSync()
+    : current(TIME_SYNC_IDLE), nextAttemptMs(0), stateSinceMs(0), radioSinceMs(0), serverIp(0), requestsSent(0),
+      serverMs(0), localMs(0) {
+    memset(&config, 0, sizeof(config));
+    memset(&requestStamp, 0, sizeof(requestStamp));
+    memset(&statistics, 0, sizeof(statistics));
+}
+
+
+void TimeSync::begin(const time_sync_config &config) {
+    this->config = config;
+    nextAttemptMs = halMillis() + NTP_SYNC_INTERVAL_MS;
+}
+
+
+void TimeSync::request() {
+    nextAttemptMs = halMillis();
+}
+
+
+void TimeSync::poll(bool idle) {
+    uint32_t now = halMillis();
+    if (config.ssid == NULL) {
+        return;
+    }
+    if (current != TIME_SYNC_IDLE && !idle) {
+        // Logging has priority: radio back at once, try again when the master is idle
+        if (ownsRadio()) {
+            restoreRadio(now);
+        }
+        current = TIME_SYNC_IDLE;
+        statistics.deferred++;
+        nextAttemptMs = now;
+        CONSOLE_INFO("NTP Time Sync:\t\t\t\tDeferred (logging started)\n");
+        return;
+    }
+
+    switch (current) {
+    case TIME_SYNC_IDLE:
+        if (idle && (int32_t)(now - nextAttemptMs) >= 0) {
+            start(now);
+        }
+        break;
+
+    case TIME_SYNC_JOINING: {
+        int status = halNetStatus();
+        if (status == HAL_NET_READY) {
+            halNetResolve(config.server);
+            current = TIME_SYNC_RESOLVING;
+            stateSinceMs = now;
+        } else if (status == HAL_NET_FAILED || now - stateSinceMs >= NTP_JOIN_TIMEOUT_MS) {
+            finish(now, false, "no WiFi");
+        }
+        break;
+    }
+
+    case TIME_SYNC_RESOLVING: {
+        int status = halNetResolveStatus(&serverIp);
+        if (status == HAL_NET_READY) {
+            requestsSent = 0;
+            sendRequest(now);
+        } else if (status == HAL_NET_FAILED || now - stateSinceMs >= NTP_DNS_TIMEOUT_MS) {
+            finish(now, false, "DNS lookup failed");
+        }
+        break;
+    }
+
+    case TIME_SYNC_REQUESTING:
+        receiveReply(now);
+        if (current == TIME_SYNC_REQUESTING && now - stateSinceMs >= NTP_REPLY_TIMEOUT_MS) {
+            if (requestsSent >= NTP_REQUESTS) {
+                finish(now, false, "no NTP reply");
+            } else {
+                sendRequest(now);
+            }
+        }
+        break;
+
+    case TIME_SYNC_SETTING: {
+        // The DS3231 restarts its second when it is written: write it on the server's second
+        uint64_t serverNowMs = serverMs + (now - localMs);
+        if (serverNowMs / 1000 != serverMs / 1000) {
+            uint32_t epoch = (uint32_t)(serverNowMs / 1000 + config.utcOffsetS);
+            statistics.lastCorrectionS = (int32_t)(epoch - timebase.epoch());
+            halRtcSetEpoch(epoch);
+            timebase.invalidate();
+            finish(now, true, NULL);
+        }
+        break;
+    }
+    }
+}
+
+
+void TimeSync::start(uint32_t now) {
+    statistics.attempts++;
+    current = TIME_SYNC_JOINING;
+    stateSinceMs = now;
+    radioSinceMs = now;
+    halNetConnect(config.ssid, config.password);
+}
+
+
+void TimeSync::sendRequest(uint32_t now) {
+    // The transmit timestamp only has to be unique: the reply echoes it and is matched by it
+    requestStamp.seconds = timebase.epoch() - config.utcOffsetS + NTP_UNIX_OFFSET;
+    requestStamp.fraction = halMicros();
+    uint8_t packet[NTP_PACKET_SIZE];
+    ntpBuildRequest(packet, requestStamp);
+    halNetSendUdp(serverIp, config.port, packet, sizeof(packet));
+    requestsSent++;
+    current = TIME_SYNC_REQUESTING;
+    stateSinceMs = now;
+}
+
+
+void TimeSync::receiveReply(uint32_t now) {
+    uint8_t packet[NTP_PACKET_SIZE + 16];
+    size_t len;
+    ntp_reply reply;
+    while ((len = halNetReceiveUdp(packet, sizeof(packet))) > 0) {
+        if (!ntpParseReply(packet, len, requestStamp, &reply)) {
+            continue;                       // Late reply to an earlier request, or not from a usable server
+        }
+        // Server time now = its transmit time plus the way back, half the round trip without its own delay
+        uint64_t receiveMs = ntpToUnixMs(reply.receive);
+        uint64_t transmitMs = ntpToUnixMs(reply.transmit);
+        uint32_t serverDelayMs = transmitMs >= receiveMs ? (uint32_t)(transmitMs - receiveMs) : 0;
+        uint32_t elapsedMs = now - stateSinceMs;
+        statistics.lastRttMs = elapsedMs > serverDelayMs ? elapsedMs - serverDelayMs : 0;
+        serverMs = transmitMs + statistics.lastRttMs / 2;
+        localMs = now;
+        restoreRadio(now);
+        current = TIME_SYNC_SETTING;
+        stateSinceMs = now;
+        return;
+    }
+}
+
+
+void TimeSync::restoreRadio(uint32_t now) {
+    halNetRestore();
+    statistics.lastDurationMs = now - radioSinceMs;
+}
+
+
+void TimeSync::finish(uint32_t now, bool success, const char *reason) {
+    if (ownsRadio()) {
+        restoreRadio(now);
+    }
+    current = TIME_SYNC_IDLE;
+    if (success) {
+        statistics.successes++;
+        statistics.lastSuccessMs = now;
+        nextAttemptMs = now + NTP_SYNC_INTERVAL_MS;
+        CONSOLE_INFO("NTP Time Sync:\t\t\t\tSuccess (RTC %+ld s, round trip %lu ms, radio away %lu ms)\n",
+                  (long)statistics.lastCorrectionS, (unsigned long)statistics.lastRttMs,
+                  (unsigned long)statistics.lastDurationMs);
+    } else {
+        statistics.failures++;
+        nextAttemptMs = now + NTP_RETRY_MS;
+        CONSOLE_WARN("NTP Time Sync:\t\t\t\tFailed (%s)\n", reason);
+    }
+}
@@ -0,0 +1,290 @@
+/*
+ * Timebase - TX Master ESP32
+ *
+ * See timebase.h.
+ */
+
+#include <stdlib.h>
+#include <algorithm>
+#include "timebase.h"
+#include "hal.h"
+
+#define EDGE_READ_WINDOW_US     900000      // Read the RTC only this soon after an SQW edge, before the next one
+#define EDGE_MAX_AGE_US         1500000     // An older edge means the square wave stopped
+#define STEP_US                 500000      // Prediction error that counts as the RTC having been set
+#define DRIFT_MAX_PPB           200000      // Rate errors beyond 200 ppm are measurement errors
+#define DRIFT_RESOLUTION_PPB    1000        // Edge uncertainty allowed per baseline length (1 ppm)
+#define EDGE_MARGIN_US          500         // Added to a predicted edge's range (I2C read latency)
+#define EDGE_DRIFT_PPM          20          // Rate error left between two anchors once the drift is corrected
+#define EDGE_RAW_DRIFT_PPM      100         // Rate error before that (timer crystal plus DS3231)
+#define EDGE_MAX_MISSES         2           // Failed brackets in a row before the edge is searched for again
+#define EDGE_LEAD_US            20000       // Start waiting for the bracket reads this soon before the first (a loop pass)
+#define SQW_PERIOD_MS           1000
+#define BEGIN_POLL_MS           2
+
+Timebase timebase;
+
+
+static uint64_t extrapolateUs(uint32_t epoch, uint64_t anchorUs, int32_t driftPpb, uint64_t timerUs) {
+    int64_t elapsedUs = (int64_t)(timerUs - anchorUs);
+    return (uint64_t)epoch * 1000000 + elapsedUs + elapsedUs * driftPpb / 1000000000;
+}
+
+
+Timebase::Timebase()
+    : sequence(0), anchorEpoch(0), anchorUsHigh(0), anchorUsLow(0), anchorDriftPpb(0), anchorUs(0),
+      anchorUncertaintyUs(0), baselineUs(0), baselineEpoch(0), baselineUncertaintyUs(0), pending(false),
+      invalidatedUs(0), searching(false), targetEpoch(0), misses(0), edgeLowUs(0), edgeHighUs(0),
+      firstReadUs(0), secondReadUs(0), readEpoch(0), readUs(0), statistics() {
+}
+
+
+bool Timebase::begin(bool squareWave) {
+    // The first SQW edge comes within a second after the pin was set up; until then the reads would bracket it
+    uint32_t start = halMillis();
+    while (squareWave && halRtcEdgeUs() == 0 && halMillis() - start < SQW_PERIOD_MS) {
+        halDelay(BEGIN_POLL_MS);
+    }
+    start = halMillis();
+    while (!valid() && halMillis() - start < 2500) {
+        poll();
+        halDelay(BEGIN_POLL_MS);
+    }
+    return valid();
+}
+
+
+void Timebase::poll() {
+    uint64_t nowUs = halUptimeUs();
+    if (valid() && !pending && nowUs - anchorUs < (uint64_t)TIMEBASE_ANCHOR_MS * 1000) {
+        return;
+    }
+    if (!anchorFromEdge(nowUs)) {
+        anchorFromReads(nowUs);
+    }
+}
+
+
+void Timebase::invalidate() {
+    pending = true;
+    invalidatedUs = halUptimeUs();
+    readEpoch = 0;
+}
+
+
+uint64_t Timebase::nowMs() const {
+    uint32_t seq;
+    uint32_t epoch;
+    uint64_t baseUs;
+    int32_t driftPpb;
+    do {
+        seq = sequence.load(std::memory_order_acquire);
+        if (seq == 0) {
+            return (uint64_t)halRtcEpoch() * 1000;      // Not anchored yet
+        }
+        epoch = anchorEpoch.load(std::memory_order_relaxed);
+        baseUs = ((uint64_t)anchorUsHigh.load(std::memory_order_relaxed) << 32)
+                 | anchorUsLow.load(std::memory_order_relaxed);
+        driftPpb = anchorDriftPpb.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+    } while ((seq & 1) || sequence.load(std::memory_order_relaxed) != seq);
+
+    // The timer is read after the anchor, so it is never older than the anchor's edge
+    return extrapolateUs(epoch, baseUs, driftPpb, halUptimeUs()) / 1000;
+}
+
+
+bool Timebase::anchorFromEdge(uint64_t nowUs) {
+    uint64_t edgeUs = halRtcEdgeUs();
+    statistics.squareWave = edgeUs != 0 && nowUs - edgeUs < EDGE_MAX_AGE_US;
+    if (!statistics.squareWave) {
+        return false;
+    }
+    // The RTC second read must be the one that started at this edge, and after any invalidate()
+    if (nowUs - edgeUs > EDGE_READ_WINDOW_US || (pending && edgeUs <= invalidatedUs)) {
+        return true;
+    }
+    uint32_t epoch = halRtcEpoch();
+    statistics.rtcReads++;
+    if (halRtcEdgeUs() != edgeUs) {
+        return true;                        // The next second started during the read
+    }
+    setAnchor(epoch, edgeUs, 0);
+    return true;
+}
+
+
+bool Timebase::anchorFromReads(uint64_t nowUs) {
+    if (valid() && !pending && !searching) {
+        return bracketPredictedEdge(nowUs);
+    }
+    // No usable prediction: read every half search gap until two reads at most TIMEBASE_SEARCH_GAP_US
+    // apart see the second change
+    if (readEpoch != 0 && nowUs - readUs < TIMEBASE_SEARCH_GAP_US / 2) {
+        return false;
+    }
+    uint32_t epoch = halRtcEpoch();
+    statistics.rtcReads++;
+    if (readEpoch != 0 && epoch == readEpoch + 1 && nowUs - readUs <= TIMEBASE_SEARCH_GAP_US) {
+        uint32_t halfGapUs = (uint32_t)(nowUs - readUs) / 2;
+        setAnchor(epoch, readUs + halfGapUs, halfGapUs);
+        return true;
+    }
+    readEpoch = epoch;
+    readUs = nowUs;
+    return false;
+}
+
+
+// Wait in the acquisition task until the timer reaches us; returns the timer value then
+static uint64_t waitUntil(uint64_t us) {
+    uint64_t nowUs;
+    while ((nowUs = halUptimeUs()) < us) {
+        halDelay(1);
+    }
+    return nowUs;
+}
+
+
+bool Timebase::bracketPredictedEdge(uint64_t nowUs) {
+    // Exactly two reads per renewal, a quarter of the edge's range before its predicted time and a quarter
+    // after it. Each read tells on which side of it the edge is, so the range at least halves. The loop
+    // polls too seldom to hit a range of a few ms, so both are taken in one poll, waiting for them.
+    if (targetEpoch == 0) {
+        predictEdge(nowUs);
+    }
+    if (nowUs + EDGE_LEAD_US < firstReadUs) {
+        return false;
+    }
+    if (nowUs > firstReadUs) {
+        predictEdge(nowUs);                 // Polled too late for the first read: the next second, no read spent
+        return false;
+    }
+    uint64_t beforeUs = waitUntil(firstReadUs);
+    uint32_t first = halRtcEpoch();
+    uint64_t firstDoneUs = halUptimeUs();
+    uint64_t secondUs = waitUntil(secondReadUs);
+    uint32_t second = halRtcEpoch();
+    uint64_t secondDoneUs = halUptimeUs();
+    statistics.rtcReads += 2;
+
+    // A read that still sees the previous second started before the edge, one that sees the new second
+    // ended after it
+    bool inRange = narrowEdge(first, beforeUs, firstDoneUs) && narrowEdge(second, secondUs, secondDoneUs);
+    if (!inRange || edgeLowUs > edgeHighUs) {
+        missedEdge(secondDoneUs);           // The edge is not where predicted
+        return false;
+    }
+    uint32_t halfRangeUs = (uint32_t)(edgeHighUs - edgeLowUs) / 2;
+    setAnchor(targetEpoch, edgeLowUs + halfRangeUs, halfRangeUs);
+    return true;
+}
+
+
+bool Timebase::narrowEdge(uint32_t epoch, uint64_t startUs, uint64_t doneUs) {
+    if (epoch + 1 == targetEpoch) {
+        edgeLowUs = std::max(edgeLowUs, startUs);
+    } else if (epoch == targetEpoch) {
+        edgeHighUs = std::min(edgeHighUs, doneUs);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+
+void Timebase::predictEdge(uint64_t nowUs) {
+    uint32_t epoch = anchorEpoch.load(std::memory_order_relaxed);
+    int32_t driftPpb = anchorDriftPpb.load(std::memory_order_relaxed);
+
+    // The next edge whose whole range is still ahead: the last anchor's uncertainty, widened by the
+    // rate error that may be left since then, and doubled for every miss
+    uint32_t rateErrorPpm = statistics.driftPpb != 0 ? EDGE_DRIFT_PPM : EDGE_RAW_DRIFT_PPM;
+    targetEpoch = (uint32_t)(extrapolateUs(epoch, anchorUs, driftPpb, nowUs) / 1000000);
+    uint64_t edgeUs;
+    uint64_t rangeUs;
+    do {
+        targetEpoch++;
+        int64_t secondsUs = (int64_t)(targetEpoch - epoch) * 1000000;
+        edgeUs = anchorUs + secondsUs - secondsUs * driftPpb / 1000000000;
+        rangeUs = (anchorUncertaintyUs + EDGE_MARGIN_US + (uint64_t)secondsUs * rateErrorPpm / 1000000) << misses;
+    } while (edgeUs < nowUs + rangeUs);
+
+    edgeLowUs = edgeUs - rangeUs;
+    edgeHighUs = edgeUs + rangeUs;
+    firstReadUs = edgeUs - rangeUs / 2;
+    secondReadUs = edgeUs + rangeUs / 2;
+}
+
+
+void Timebase::missedEdge(uint64_t nowUs) {
+    if (++misses >= EDGE_MAX_MISSES) {
+        searching = true;                   // Set behind our back, or the drift is off: find the edge again
+        targetEpoch = 0;
+    } else {
+        predictEdge(nowUs);                 // Try the next second once more, with a wider range
+    }
+}
+
+
+void Timebase::setAnchor(uint32_t epoch, uint64_t edgeUs, uint32_t uncertaintyUs) {
+    int32_t driftPpb = anchorDriftPpb.load(std::memory_order_relaxed);
+    bool restartBaseline = !valid() || pending;
+
+    if (valid() && !pending) {
+        int64_t errorUs = (int64_t)(extrapolateUs(anchorEpoch.load(std::memory_order_relaxed), anchorUs, driftPpb,
+                                                  edgeUs) - (uint64_t)epoch * 1000000);
+        if (llabs(errorUs) >= STEP_US) {
+            // Set behind our back, or a bad read: start over from this second
+            statistics.steps++;
+            statistics.maxErrorUs = 0;
+            restartBaseline = true;
+        } else {
+            statistics.lastErrorUs = (int32_t)errorUs;
+            if ((uint32_t)llabs(errorUs) > statistics.maxErrorUs) {
+                statistics.maxErrorUs = (uint32_t)llabs(errorUs);
+            }
+        }
+    }
+
+    if (restartBaseline) {
+        baselineUs = edgeUs;
+        baselineEpoch = epoch;
+        baselineUncertaintyUs = uncertaintyUs;
+    } else {
+        // Rate over the baseline, once it is long enough for the edge uncertainty; then a new baseline,
+        // so the correction follows the crystal's temperature
+        int64_t timerUs = (int64_t)(edgeUs - baselineUs);
+        uint64_t edgeErrorUs = (uint64_t)baselineUncertaintyUs + uncertaintyUs;
+        if (timerUs >= (int64_t)TIMEBASE_DRIFT_MIN_MS * 1000
+            && edgeErrorUs * 1000000000 / (uint64_t)timerUs <= DRIFT_RESOLUTION_PPB) {
+            int64_t rtcUs = (int64_t)(epoch - baselineEpoch) * 1000000;
+            int64_t measuredPpb = (rtcUs - timerUs) * 1000000000 / timerUs;
+            if (llabs(measuredPpb) <= DRIFT_MAX_PPB) {
+                driftPpb = (int32_t)measuredPpb;
+                statistics.driftPpb = driftPpb;
+            }
+            baselineUs = edgeUs;
+            baselineEpoch = epoch;
+            baselineUncertaintyUs = uncertaintyUs;
+        }
+    }
+
+    anchorUs = edgeUs;
+    anchorUncertaintyUs = uncertaintyUs;
+    pending = false;
+    searching = false;
+    targetEpoch = 0;
+    misses = 0;
+    readEpoch = 0;
+    statistics.anchors++;
+
+    uint32_t seq = sequence.load(std::memory_order_relaxed);
+    sequence.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    anchorEpoch.store(epoch, std::memory_order_relaxed);
+    anchorUsHigh.store((uint32_t)(edgeUs >> 32), std::memory_order_relaxed);
+    anchorUsLow.store((uint32_t)edgeUs, std::memory_order_relaxed);
+    anchorDriftPpb.store(driftPpb, std::memory_order_relaxed);
+    sequence.store(seq + 2, std::memory_order_release);
+}
@@ -0,0 +1,499 @@
+/*
+ * Benchmark Suite - TX Master ESP32 (native build)
+ *
+ * Host benchmarks for the three hot paths of the master, built from the same
+ * sources as the firmware against the simulated hardware of hal_native.cpp:
+ *
+ *   poll     getAllTemps() cycles for 1..19 servants in fan-out, serial and
+ *            sync mode, with and without packet loss. Reports the simulated
+ *            cycle time (radio latency, timeouts) and the host CPU time the
+ *            acquisition code itself needs per cycle.
+ *   format   CSV formatting per record (formatTempRecord for 9 and 32
+ *            sensors, the NAN row, the timestamp).
+ *   storage  log appends through writeLogRecord() and SdLogger into files
+ *            that already hold 0 MB, 100 MB and 1 GB and into a pre-allocated
+ *            segment, plus the time to open them. Host file system numbers:
+ *            they show how the writer's own cost grows, not how a FAT card
+ *            behaves.
+ *
+ * Build and run:
+ *   pio run -e native-bench
+ *   .pio/build/native-bench/program --out bench_results.csv
+ *
+ * Without PlatformIO (from the repository root):
+ *   g++ -std=gnu++17 -O2 -Iinclude -o gct_bench test/bench/bench.cpp src/native/hal_native.cpp \
+ *       src/acquisition.cpp src/log_storage.cpp src/log_segments.cpp src/sd_logger.cpp \
+ *       src/record_format.cpp src/metrics.cpp src/lcd_frame.cpp src/request_tracker.cpp \
+ *       src/liveness_tracker.cpp src/peer_registry.cpp src/sample_journal.cpp \
+ *       src/backlog_ring.cpp src/ntp_packet.cpp src/time_sync.cpp src/timebase.cpp \
+ *       src/console_log.cpp src/rtt_estimator.cpp
+ *
+ * Options:
+ *   --out FILE         results as CSV, one row per case [bench_results.csv]
+ *   --dir DIR          scratch directory for the log files [bench_sd]
+ *   --suite NAME       run only poll, format or storage
+ *   --sizes MB,MB,...  existing log sizes for the storage suite [0,100,1024]
+ *   --quick            fewer samples, storage sizes 0 and 100 MB only
+ *
+ * The CSV has the firmware version in every row, so runs of different
+ * versions can be concatenated and compared per suite and case:
+ *
+ *   firmware,suite,case,unit,samples,min,p50,p95,p99,max,mean,throughput,throughput_unit
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "config.h"
+#include "acquisition.h"
+#include "log_storage.h"
+#include "record_format.h"
+#include "hal_native.h"
+
+#define BENCH_TIMESTAMP         "2025-07-30 12:34:56"
+#define BENCH_EPOCH             1753878896  // 2025-07-30 12:34:56
+#define FORMAT_BATCH            1000        // Records per format sample (one clock read per batch)
+
+// Settings (user variables of main.cpp)
+int sendTimeout         = 1000;
+bool fanOutPolling      = true;
+bool acceptLegacyReplies = true;
+bool streamingMode      = false;
+int streamPeriodMs      = 1000;
+bool syncSampling       = false;
+volatile bool logState  = false;
+
+static FILE *results = NULL;
+static bool storeRecords = false;           // Poll suite: records are dropped, storage suite measures them
+
+typedef std::chrono::steady_clock bench_clock;
+
+
+//MARK: Application hooks
+void queueLogRecord(uint32_t epoch, int servantID, const temp *t, int millis) {
+    if (!storeRecords) {
+        return;
+    }
+    log_record record = {};
+    record.epoch = epoch;
+    record.millis = millis;
+    record.servantID = servantID;
+    record.valid = (t != NULL);
+    if (t != NULL) {
+        record.data = *t;
+    }
+    writeLogRecord(record);
+}
+
+
+void postTemp(int targetID, const temp &t, bool isConnected) {
+}
+
+
+void postConnections(const bool connections[]) {
+}
+
+
+void reportError(const char *errorMessage, int errorNr) {
+    fprintf(stderr, "Error %d: %s\n", errorNr, errorMessage);
+}
+
+
+static void onReceive(const uint8_t *mac, const uint8_t *data, int len) {
+    acquisitionReceive(mac, data, len);
+}
+
+
+static void onSent(const uint8_t *mac, bool delivered) {
+    acquisitionSent(mac, delivered);
+}
+
+
+//MARK: Results
+static double elapsedNs(bench_clock::time_point start) {
+    return std::chrono::duration<double, std::nano>(bench_clock::now() - start).count();
+}
+
+
+// Prints one line and writes one CSV row; samples are sorted in place
+static void report(const char *suite, const char *name, const char *unit, std::vector<double> &samples,
+                   double throughput, const char *throughputUnit) {
+    if (samples.empty()) {
+        return;
+    }
+    std::sort(samples.begin(), samples.end());
+    double total = 0;
+    for (size_t i = 0; i < samples.size(); i++) {
+        total += samples[i];
+    }
+    size_t n = samples.size();
+    double p50 = samples[n / 2];
+    double p95 = samples[std::min(n - 1, n * 95 / 100)];
+    double p99 = samples[std::min(n - 1, n * 99 / 100)];
+
+    printf("  %-34s %6u x  p50 %10.2f  p95 %10.2f  p99 %10.2f  max %10.2f %-3s  %12.1f %s\n", name, (unsigned)n,
+           p50, p95, p99, samples.back(), unit, throughput, throughputUnit);
+    if (results != NULL) {
+        fprintf(results, "%s,%s,%s,%s,%u,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.1f,%s\n", FIRMWARE_VERSION, suite, name,
+                unit, (unsigned)n, samples.front(), p50, p95, p99, samples.back(), total / n, throughput,
+                throughputUnit);
+    }
+}
+
+
+//MARK: Poll cycle
+static void benchPollCycle(const char *mode, int servants, float lossPercent, int cycles) {
+    hal_native_config config = {};
+    config.servants = servants;
+    config.latencyMs = 3;
+    config.jitterMs = 4;
+    config.processingMs = 20;
+    config.lossPercent = lossPercent;
+    config.sensorCount = LEGACY_SENSOR_COUNT;
+    config.startEpoch = BENCH_EPOCH;
+    config.seed = 1;
+    config.storageRoot = NULL;
+    halNativeBegin(config);
+
+    fanOutPolling = strcmp(mode, "serial") != 0;
+    syncSampling = strcmp(mode, "sync") == 0;
+    peers.clear();
+    for (int i = 0; i < servants; i++) {
+        uint8_t mac[6];
+        halNativeServantMac(i, mac);
+        peers.add(mac);
+    }
+
+    // Warm up liveness the way the boot sequence does, then poll once per log interval
+    refreshConnections();
+    halDelay(1000);
+
+    std::vector<double> cycleMs;
+    std::vector<double> cpuUs;
+    double totalCpuNs = 0;
+    for (int i = 0; i < cycles; i++) {
+        refreshConnections();
+        uint64_t virtualStart = halMicros();
+        bench_clock::time_point start = bench_clock::now();
+        getAllTemps(true);
+        double cpuNs = elapsedNs(start);
+        cycleMs.push_back((uint32_t)(halMicros() - virtualStart) / 1000.0);
+
+        // Waiting for replies is done in halRadioWait, which only moves the virtual clock;
+        // the host time left is the acquisition code plus the simulated servants
+        cpuUs.push_back(cpuNs / 1000.0);
+        totalCpuNs += cpuNs;
+        halDelay(LOG_INTERVAL_MS / 5);
+    }
+
+    char name[64];
+    snprintf(name, sizeof(name), "%s n=%d loss=%.0f%%", mode, servants, lossPercent);
+    double cycleTotal = 0;
+    for (size_t i = 0; i < cycleMs.size(); i++) {
+        cycleTotal += cycleMs[i];
+    }
+    report("poll", name, "ms", cycleMs, cycleTotal > 0 ? servants * cycles * 1000.0 / cycleTotal : 0,
+           "servants/s");
+    snprintf(name, sizeof(name), "%s n=%d loss=%.0f%% cpu", mode, servants, lossPercent);
+    report("poll", name, "us", cpuUs, totalCpuNs > 0 ? cycles * 1e9 / totalCpuNs : 0, "cycles/s");
+}
+
+
+static void runPollSuite(bool quick) {
+    printf("\n=== POLL CYCLE (simulated link: 3 ms latency, 0-4 ms jitter, 20 ms processing) ===\n");
+    const int servantCounts[] = {1, 4, 8, 16, MAX_SERVANTS};
+    const char *modes[] = {"fanout", "serial", "sync"};
+    const float losses[] = {0.0f, 5.0f};
+    int cycles = quick ? 20 : 200;
+    halNativeSetQuiet(true);
+    storeRecords = false;
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+        for (size_t l = 0; l < sizeof(losses) / sizeof(losses[0]); l++) {
+            for (size_t s = 0; s < sizeof(servantCounts) / sizeof(servantCounts[0]); s++) {
+                benchPollCycle(modes[m], servantCounts[s], losses[l], cycles);
+            }
+        }
+    }
+}
+
+
+//MARK: Formatting
+static void runFormatSuite(bool quick) {
+    printf("\n=== CSV FORMATTING (per record, %d records per sample) ===\n", FORMAT_BATCH);
+    int samples = quick ? 50 : 500;
+    static char text[RECORD_BUFFER_SIZE];
+    float readings[MAX_SENSORS];
+    for (int i = 0; i < MAX_SENSORS; i++) {
+        readings[i] = 24.375f + i * 0.0625f;
+    }
+    readings[8] = -999.0f;
+    volatile size_t sink = 0;               // Keeps the compiler from dropping the calls
+
+    const int sensorCounts[] = {LEGACY_SENSOR_COUNT, MAX_SENSORS};
+    for (size_t c = 0; c < sizeof(sensorCounts) / sizeof(sensorCounts[0]); c++) {
+        std::vector<double> perRecordNs;
+        double totalNs = 0;
+        for (int s = 0; s < samples; s++) {
+            bench_clock::time_point start = bench_clock::now();
+            for (int i = 0; i < FORMAT_BATCH; i++) {
+                sink += formatTempRecord(text, sizeof(text), BENCH_TIMESTAMP, 1 + i % 4, readings,
+                                         sensorCounts[c]);
+            }
+            double ns = elapsedNs(start);
+            perRecordNs.push_back(ns / FORMAT_BATCH);
+            totalNs += ns;
+        }
+        char name[48];
+        snprintf(name, sizeof(name), "formatTempRecord %d sensors", sensorCounts[c]);
+        report("format", name, "ns", perRecordNs, samples * (double)FORMAT_BATCH * 1e9 / totalNs, "records/s");
+    }
+
+    std::vector<double> perRecordNs;
+    double totalNs = 0;
+    for (int s = 0; s < samples; s++) {
+        bench_clock::time_point start = bench_clock::now();
+        for (int i = 0; i < FORMAT_BATCH; i++) {
+            sink += formatNanRecord(text, sizeof(text), BENCH_TIMESTAMP, 1 + i % 4);
+        }
+        double ns = elapsedNs(start);
+        perRecordNs.push_back(ns / FORMAT_BATCH);
+        totalNs += ns;
+    }
+    report("format", "formatNanRecord", "ns", perRecordNs, samples * (double)FORMAT_BATCH * 1e9 / totalNs,
+           "records/s");
+
+    perRecordNs.clear();
+    totalNs = 0;
+    char timestamp[RECORD_TIMESTAMP_SIZE];
+    for (int s = 0; s < samples; s++) {
+        bench_clock::time_point start = bench_clock::now();
+        for (int i = 0; i < FORMAT_BATCH; i++) {
+            sink += formatTimestamp(timestamp, sizeof(timestamp), BENCH_EPOCH + i, i % 1000);
+        }
+        double ns = elapsedNs(start);
+        perRecordNs.push_back(ns / FORMAT_BATCH);
+        totalNs += ns;
+    }
+    report("format", "formatTimestamp millis", "ns", perRecordNs, samples * (double)FORMAT_BATCH * 1e9 / totalNs,
+           "records/s");
+}
+
+
+//MARK: Storage
+static bool prepareLogFile(const char *dir, const char *path, uint64_t sizeBytes) {
+    // Existing log of the given size: header line, then zeros up to the size. The file is
+    // sparse where the host supports it, so a 1 GB log costs neither time nor disk space.
+    std::string hostPath = std::string(dir) + path;
+    FILE *file = fopen(hostPath.c_str(), "wb");
+    if (file == NULL) {
+        return false;
+    }
+    fputs(CSV_HEADER "\n", file);
+    fclose(file);
+    return sizeBytes == 0 || truncate(hostPath.c_str(), (off_t)sizeBytes) == 0;
+}
+
+
+// Append records like the storage task (pollLogFile() after each) and report the append time as name
+static void measureAppends(const char *name, int records) {
+    // One record per servant of a 4-servant cycle
+    log_record record = {};
+    record.epoch = BENCH_EPOCH;
+    record.millis = -1;
+    record.valid = true;
+    record.data.count = LEGACY_SENSOR_COUNT;
+    for (int i = 0; i < LEGACY_SENSOR_COUNT; i++) {
+        record.data.sens[i] = 24.375f + i * 0.0625f;
+    }
+
+    uint64_t bytesBefore = sdLogger.stats().bytesWritten;
+    std::vector<double> appendUs;
+    double totalNs = 0;
+    for (int i = 0; i < records; i++) {
+        record.servantID = 1 + i % 4;
+        if (record.servantID == 1) {
+            record.epoch += LOG_INTERVAL_MS / 1000;
+            halDelay(LOG_INTERVAL_MS);
+        }
+        bench_clock::time_point start = bench_clock::now();
+        writeLogRecord(record);
+        pollLogFile();
+        double ns = elapsedNs(start);
+        appendUs.push_back(ns / 1000.0);
+        totalNs += ns;
+    }
+    bench_clock::time_point start = bench_clock::now();
+    sdLogger.sync();
+    totalNs += elapsedNs(start);
+    double megabytes = (sdLogger.stats().bytesWritten - bytesBefore) / 1e6;
+
+    report("storage", name, "us", appendUs, megabytes / (totalNs / 1e9), "MB/s");
+}
+
+
+static void benchStorage(const char *dir, uint32_t sizeMb, int records) {
+    hal_native_config config = {};
+    config.startEpoch = BENCH_EPOCH;
+    config.seed = 1;
+    config.storageRoot = dir;
+    halNativeBegin(config);
+
+    char path[32];
+    snprintf(path, sizeof(path), "/bench_%umb.csv", (unsigned)sizeMb);
+    if (!prepareLogFile(dir, path, (uint64_t)sizeMb * 1024 * 1024)) {
+        fprintf(stderr, "Cannot create %s%s\n", dir, path);
+        return;
+    }
+
+    char name[48];
+    std::vector<double> openUs;
+    bench_clock::time_point start = bench_clock::now();
+    bool opened = openLogFile(path, false, BENCH_EPOCH);
+    openUs.push_back(elapsedNs(start) / 1000.0);
+    if (!opened) {
+        fprintf(stderr, "Cannot open %s%s\n", dir, path);
+        return;
+    }
+    snprintf(name, sizeof(name), "open %u MB log", (unsigned)sizeMb);
+    report("storage", name, "us", openUs, 1e6 / openUs[0], "opens/s");
+
+    snprintf(name, sizeof(name), "append to %u MB log", (unsigned)sizeMb);
+    measureAppends(name, records);
+
+    std::string hostPath = std::string(dir) + path;
+    unlink(hostPath.c_str());
+}
+
+
+static void removeSegments(const char *dir) {
+    std::string logDir = std::string(dir) + LOG_DIR;
+    std::string command = "rm -rf '" + logDir + "'";
+    if (system(command.c_str()) != 0) {
+        fprintf(stderr, "Cannot remove %s\n", logDir.c_str());
+    }
+}
+
+
+static void benchSegments(const char *dir, int records) {
+    // Same records into a new pre-allocated segment (segmentedLogging)
+    hal_native_config config = {};
+    config.startEpoch = BENCH_EPOCH;
+    config.seed = 1;
+    config.storageRoot = dir;
+    halNativeBegin(config);
+    removeSegments(dir);
+
+    std::vector<double> openUs;
+    bench_clock::time_point start = bench_clock::now();
+    bool opened = openSegmentedLog(false, BENCH_EPOCH);
+    openUs.push_back(elapsedNs(start) / 1000.0);
+    if (!opened) {
+        fprintf(stderr, "Cannot open a log segment in %s%s\n", dir, LOG_DIR);
+        return;
+    }
+    report("storage", "open new segment", "us", openUs, 1e6 / openUs[0], "opens/s");
+    measureAppends("append to segment", records);
+    removeSegments(dir);
+}
+
+
+static void runStorageSuite(const char *dir, const std::vector<uint32_t> &sizesMb, bool quick) {
+    printf("\n=== LOG APPEND (CSV records through writeLogRecord and SdLogger) ===\n");
+    int records = quick ? 2000 : 20000;
+    halNativeSetQuiet(true);
+    storeRecords = true;
+    for (size_t i = 0; i < sizesMb.size(); i++) {
+        benchStorage(dir, sizesMb[i], records);
+    }
+    benchSegments(dir, records);
+    storeRecords = false;
+}
+
+
+static void usage(const char *name) {
+    fprintf(stderr, "Usage: %s [--out FILE] [--dir DIR] [--suite poll|format|storage] [--sizes MB,MB,...] "
+                    "[--quick]\n", name);
+}
+
+
+int main(int argc, char **argv) { //MARK: Main
+    const char *outPath = "bench_results.csv";
+    const char *dir = "bench_sd";
+    const char *suite = NULL;
+    const char *sizes = NULL;
+    bool quick = false;
+
+    for (int i = 1; i < argc; i++) {
+        const char *option = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(option, "--quick") == 0) {
+            quick = true;
+            continue;
+        }
+        if (value == NULL) {
+            usage(argv[0]);
+            return 2;
+        }
+        i++;
+        if (strcmp(option, "--out") == 0) {
+            outPath = value;
+        } else if (strcmp(option, "--dir") == 0) {
+            dir = value;
+        } else if (strcmp(option, "--suite") == 0) {
+            suite = value;
+        } else if (strcmp(option, "--sizes") == 0) {
+            sizes = value;
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (suite != NULL && strcmp(suite, "poll") != 0 && strcmp(suite, "format") != 0
+        && strcmp(suite, "storage") != 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    std::vector<uint32_t> sizesMb;
+    if (sizes == NULL) {
+        sizes = quick ? "0,100" : "0,100,1024";
+    }
+    for (const char *p = sizes; *p != '\0';) {
+        char *end;
+        unsigned long mb = strtoul(p, &end, 10);
+        if (end == p) {
+            usage(argv[0]);
+            return 2;
+        }
+        sizesMb.push_back((uint32_t)mb);
+        p = (*end == ',') ? end + 1 : end;
+    }
+
+    results = fopen(outPath, "w");
+    if (results == NULL) {
+        fprintf(stderr, "Cannot write %s\n", outPath);
+        return 1;
+    }
+    fprintf(results, "firmware,suite,case,unit,samples,min,p50,p95,p99,max,mean,throughput,throughput_unit\n");
+    printf("Benchmark - firmware %s%s\n", FIRMWARE_VERSION, quick ? " (quick)" : "");
+
+    halRadioSetCallbacks(onReceive, onSent);
+    if (suite == NULL || strcmp(suite, "poll") == 0) {
+        runPollSuite(quick);
+    }
+    if (suite == NULL || strcmp(suite, "format") == 0) {
+        runFormatSuite(quick);
+    }
+    if (suite == NULL || strcmp(suite, "storage") == 0) {
+        runStorageSuite(dir, sizesMb, quick);
+    }
+
+    fclose(results);
+    printf("\nResults written to %s\n", outPath);
+    return 0;
+}
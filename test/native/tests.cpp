@@ -0,0 +1,856 @@
+/*
+ * Native Tests - TX Master ESP32 (native build)
+ *
+ * Host checks for the modules whose outputs can be asserted exactly, built
+ * from the same sources as the firmware against the simulated hardware of
+ * hal_native.cpp:
+ *
+ *   tracker    RequestTracker seq matching, with the servant taken from the
+ *              sender's MAC (PeerRegistry) as drainRxRing does it
+ *   rings      RxRing (SPSC) and ConsoleLog (MPSC) under concurrent
+ *              producers: order, no torn or lost messages, drop counts
+ *   journal    SampleJournal replay after a reset, release, damaged entries
+ *   segments   LogSegments manifest recovery, partial last row, lost file
+ *   format     formatFixed2 rounding (Arduino String(float) ties) and NAN,
+ *              the NAN row of a reply without readings (count 0)
+ *   sdlogger   no duplicated records after short writes, end() retrying a
+ *              failed trim
+ *   rtt        RttEstimator RTO clamping, backoff, OnDataSent matching
+ *   timebase   drift measurement with SQW, two RTC reads per renewal and a
+ *              bounded error without it
+ *
+ * Build and run:
+ *   pio run -e native-test
+ *   .pio/build/native-test/program
+ *
+ * Without PlatformIO (from the repository root):
+ *   g++ -std=gnu++17 -O2 -pthread -Iinclude -o gct_tests test/native/tests.cpp src/native/hal_native.cpp \
+ *       src/acquisition.cpp src/log_storage.cpp src/log_segments.cpp src/sd_logger.cpp \
+ *       src/record_format.cpp src/metrics.cpp src/lcd_frame.cpp src/request_tracker.cpp \
+ *       src/liveness_tracker.cpp src/peer_registry.cpp src/sample_journal.cpp \
+ *       src/backlog_ring.cpp src/ntp_packet.cpp src/time_sync.cpp src/timebase.cpp \
+ *       src/console_log.cpp src/rtt_estimator.cpp
+ *
+ * Options:
+ *   --dir DIR          scratch directory for the SD card files [test_sd]
+ *   --suite NAME       run only one of the suites above
+ *
+ * Prints every failed check with its line and ends with the totals; the exit
+ * code is 1 if any check failed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include <sys/stat.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include "config.h"
+#include "acquisition.h"
+#include "log_storage.h"
+#include "record_format.h"
+#include "request_tracker.h"
+#include "peer_registry.h"
+#include "rx_ring.h"
+#include "console_log.h"
+#include "rtt_estimator.h"
+#include "timebase.h"
+#include "hal_native.h"
+
+#define TEST_EPOCH              1753878896  // 2025-07-30 12:34:56
+#define TEST_TIMESTAMP          "2025-07-30 12:34:56"
+
+// Settings (user variables of main.cpp)
+int sendTimeout         = 1000;
+bool fanOutPolling      = true;
+bool acceptLegacyReplies = true;
+bool streamingMode      = false;
+int streamPeriodMs      = 1000;
+bool syncSampling       = false;
+volatile bool logState  = false;
+
+static int checks = 0;
+static int failures = 0;
+
+#define CHECK(condition) check((condition), #condition, __LINE__)
+#define CHECK_EQ(actual, expected) checkEqual((long long)(actual), (long long)(expected), #actual, __LINE__)
+#define CHECK_STR(actual, expected) checkText((actual), (expected), #actual, __LINE__)
+
+
+//MARK: Application hooks
+void queueLogRecord(uint32_t epoch, int servantID, const temp *t, int millis) {
+}
+
+
+void postTemp(int targetID, const temp &t, bool isConnected) {
+}
+
+
+void postConnections(const bool connections[]) {
+}
+
+
+void reportError(const char *errorMessage, int errorNr) {
+}
+
+
+//MARK: Checks
+static void check(bool passed, const char *text, int line) {
+    checks++;
+    if (!passed) {
+        failures++;
+        printf("  FAILED line %d: %s\n", line, text);
+    }
+}
+
+
+static void checkEqual(long long actual, long long expected, const char *text, int line) {
+    checks++;
+    if (actual != expected) {
+        failures++;
+        printf("  FAILED line %d: %s is %lld, expected %lld\n", line, text, actual, expected);
+    }
+}
+
+
+static void checkText(const std::string &actual, const char *expected, const char *text, int line) {
+    checks++;
+    if (actual != expected) {
+        failures++;
+        printf("  FAILED line %d: %s is \"%s\", expected \"%s\"\n", line, text, actual.c_str(), expected);
+    }
+}
+
+
+//MARK: Helpers
+static void beginHal(const char *dir) {
+    hal_native_config config = {};
+    config.startEpoch = TEST_EPOCH;
+    config.seed = 1;
+    config.storageRoot = dir;
+    halNativeBegin(config);
+    halNativeSetQuiet(true);
+}
+
+
+static std::string readHostFile(const std::string &path) {
+    std::string text;
+    FILE *file = fopen(path.c_str(), "rb");
+    if (file == NULL) {
+        return text;
+    }
+    char chunk[4096];
+    size_t len;
+    while ((len = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        text.append(chunk, len);
+    }
+    fclose(file);
+    return text;
+}
+
+
+static long hostFileSize(const std::string &path) {
+    struct stat info;
+    return stat(path.c_str(), &info) == 0 ? (long)info.st_size : -1;
+}
+
+
+static void removeHostDir(const std::string &path) {
+    std::string command = "rm -rf '" + path + "'";
+    if (system(command.c_str()) != 0) {
+        fprintf(stderr, "Cannot remove %s\n", path.c_str());
+    }
+}
+
+
+static std::string lastLine(const std::string &text) {
+    size_t end = text.size();
+    if (end > 0 && text[end - 1] == '\n') {
+        end--;
+    }
+    size_t start = text.rfind('\n', end > 0 ? end - 1 : 0);
+    start = (start == std::string::npos) ? 0 : start + 1;
+    return text.substr(start, end - start);
+}
+
+
+static std::string fixed2(float value) {
+    char text[32];
+    size_t len = formatFixed2(text, value);
+    return std::string(text, len);
+}
+
+
+static log_record makeRecord(int servantID, int count, float first) {
+    log_record record = {};
+    record.epoch = TEST_EPOCH;
+    record.millis = -1;
+    record.servantID = servantID;
+    record.valid = true;
+    record.data.count = count;
+    for (int i = 0; i < count; i++) {
+        record.data.sens[i] = first + i;
+    }
+    return record;
+}
+
+
+//MARK: Tracker
+static void testTracker() {
+    PeerRegistry registry;
+    uint8_t first[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+    uint8_t second[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x02};
+    uint8_t stranger[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x09};
+    CHECK(registry.add(first));
+    CHECK(registry.add(second));
+    CHECK(!registry.add(second));
+    CHECK_EQ(registry.indexOf(second), 1);
+    CHECK_EQ(registry.indexOf(stranger), -1);
+
+    RequestTracker tracker;
+    uint32_t sentUs = 0;
+    uint32_t seq = tracker.issue(registry.indexOf(first), ACTION_CONNECTION_TEST, 1000);
+    CHECK(seq != 0);
+    CHECK_EQ(tracker.outstanding(0), 1);
+
+    // The right seq from the wrong servant is not an answer
+    CHECK_EQ(tracker.match(registry.indexOf(second), seq, ACTION_CONNECTION_TEST, &sentUs), MATCH_LATE);
+    // Nor the right servant with another reply action
+    CHECK_EQ(tracker.match(0, seq, ACTION_TEMP_RESPONSE, &sentUs), MATCH_LATE);
+    CHECK_EQ(tracker.match(registry.indexOf(first), seq, ACTION_CONNECTION_TEST, &sentUs), MATCH_ACCEPTED);
+    CHECK_EQ(sentUs, 1000);
+    CHECK_EQ(tracker.outstanding(0), 0);
+    CHECK_EQ(tracker.match(0, seq, ACTION_CONNECTION_TEST, &sentUs), MATCH_DUPLICATE);
+
+    // Cancelled: the reply comes too late
+    uint32_t cancelled = tracker.issue(1, ACTION_TEMP_RESPONSE, 2000);
+    tracker.cancel(1, cancelled);
+    CHECK_EQ(tracker.match(1, cancelled, ACTION_TEMP_RESPONSE, &sentUs), MATCH_LATE);
+
+    // v1 replies carry no seq: the oldest outstanding request with that reply action
+    uint32_t older = tracker.issue(1, ACTION_TEMP_RESPONSE, 3000);
+    uint32_t newer = tracker.issue(1, ACTION_TEMP_RESPONSE, 4000);
+    uint32_t legacySeq = 0;
+    CHECK_EQ(tracker.matchLegacy(1, ACTION_TEMP_RESPONSE, &legacySeq, &sentUs), MATCH_ACCEPTED);
+    CHECK_EQ(legacySeq, older);
+    CHECK_EQ(sentUs, 3000);
+    CHECK_EQ(tracker.match(1, newer, ACTION_TEMP_RESPONSE, &sentUs), MATCH_ACCEPTED);
+    CHECK_EQ(tracker.matchLegacy(1, ACTION_TEMP_RESPONSE, &legacySeq, &sentUs), MATCH_LATE);
+
+    const tracker_counters &counters = tracker.counters();
+    CHECK_EQ(counters.issued, 4);
+    CHECK_EQ(counters.accepted, 3);
+    CHECK_EQ(counters.duplicate, 1);
+    CHECK_EQ(counters.expired, 1);
+    CHECK_EQ(counters.legacy, 1);
+}
+
+
+//MARK: Rings
+static RxRing<8> rxRing8;
+
+
+static void testRxRing() {
+    uint8_t mac[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+    uint8_t data[RX_PACKET_MAX_LEN + 1] = {};
+    rx_packet packet;
+
+    for (int i = 0; i < 8; i++) {
+        CHECK(rxRing8.push(mac, data, 4, i));
+    }
+    CHECK(!rxRing8.push(mac, data, 4, 8));
+    CHECK(!rxRing8.push(mac, data, RX_PACKET_MAX_LEN + 1, 9));
+    CHECK_EQ(rxRing8.dropped(), 2);
+    CHECK_EQ(rxRing8.maxDepth(), 8);
+    for (int i = 0; i < 8; i++) {
+        CHECK(rxRing8.pop(packet) && packet.arrivalUs == (uint32_t)i);
+    }
+    CHECK(!rxRing8.pop(packet));
+
+    // One producer (the radio task), one consumer: every packet that got in comes out whole and in order
+    const uint32_t count = 200000;
+    uint32_t dropsBefore = rxRing8.dropped();
+    std::thread producer([&]() {
+        uint8_t payload[16];
+        for (uint32_t i = 1; i <= count; i++) {
+            memset(payload, (uint8_t)i, sizeof(payload));
+            payload[0] = (uint8_t)(i >> 24);
+            payload[1] = (uint8_t)(i >> 16);
+            payload[2] = (uint8_t)(i >> 8);
+            payload[3] = (uint8_t)i;
+            rxRing8.push(mac, payload, sizeof(payload), i);
+        }
+    });
+    uint32_t received = 0;
+    uint32_t last = 0;
+    bool ordered = true;
+    bool intact = true;
+    while (last != count) {
+        if (!rxRing8.pop(packet)) {
+            if (received + (rxRing8.dropped() - dropsBefore) == count) {
+                break;
+            }
+            continue;
+        }
+        received++;
+        uint32_t value = ((uint32_t)packet.data[0] << 24) | ((uint32_t)packet.data[1] << 16)
+                         | ((uint32_t)packet.data[2] << 8) | packet.data[3];
+        ordered = ordered && value > last && value == packet.arrivalUs;
+        for (int i = 4; i < 16; i++) {
+            intact = intact && packet.data[i] == (uint8_t)value;
+        }
+        intact = intact && packet.len == 16;
+        last = value;
+    }
+    producer.join();
+    while (rxRing8.pop(packet)) {
+        received++;
+    }
+    CHECK(ordered);
+    CHECK(intact);
+    CHECK_EQ(received + (rxRing8.dropped() - dropsBefore), count);
+}
+
+
+static ConsoleLog testLog;
+
+
+// Drain into a string: halPrint writes to stdout while the HAL is not quiet
+static std::string drainConsole(ConsoleLog &log) {
+    fflush(stdout);
+    FILE *capture = tmpfile();
+    int saved = dup(fileno(stdout));
+    dup2(fileno(capture), fileno(stdout));
+    halNativeSetQuiet(false);
+    while (log.drain() > 0) {
+    }
+    fflush(stdout);
+    halNativeSetQuiet(true);
+    dup2(saved, fileno(stdout));
+    close(saved);
+
+    std::string text;
+    rewind(capture);
+    char chunk[4096];
+    size_t len;
+    while ((len = fread(chunk, 1, sizeof(chunk), capture)) > 0) {
+        text.append(chunk, len);
+    }
+    fclose(capture);
+    return text;
+}
+
+
+static void testConsoleLog() {
+    testLog.setDirect(false);
+    testLog.push(CONSOLE_LEVEL_WARN, "Servant %d: %s %lu %.2f\n", 3, "late", 42UL, 1.5);
+    std::string text = drainConsole(testLog);
+    CHECK(text.size() > 13 && text.substr(13) == "W Servant 3: late 42 1.50\n");    // After "[     0.000] "
+    CHECK_EQ(text[0], '[');
+
+    // Full ring: the next message is dropped and reported once
+    for (int i = 0; i < CONSOLE_SLOTS + 1; i++) {
+        testLog.push(CONSOLE_LEVEL_INFO, "%d\n", i);
+    }
+    CHECK_EQ(testLog.depth(), CONSOLE_SLOTS);
+    CHECK_EQ(testLog.dropped(), 1);
+    text = drainConsole(testLog);
+    CHECK(text.find("[console: 1 message(s) dropped]") != std::string::npos);
+    CHECK_EQ(testLog.depth(), 0);
+
+    // Several producers (tasks and callbacks), one console task: per producer, the messages that got
+    // in arrive whole and in order, and every message is either printed or counted as dropped
+    const int producers = 4;
+    const int perProducer = 20000;
+    uint32_t printedBefore = testLog.printed();
+    uint32_t droppedBefore = testLog.dropped();
+    std::atomic<int> running(producers);
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; p++) {
+        threads.push_back(std::thread([&, p]() {
+            for (int i = 0; i < perProducer; i++) {
+                testLog.push(CONSOLE_LEVEL_INFO, "P%d %d %s\n", p, i, "payload");
+            }
+            running--;
+        }));
+    }
+    std::string output;
+    while (running > 0) {
+        output += drainConsole(testLog);
+    }
+    for (size_t i = 0; i < threads.size(); i++) {
+        threads[i].join();
+    }
+    output += drainConsole(testLog);
+
+    int next[producers] = {};
+    int lines = 0;
+    bool wellFormed = true;
+    bool ordered = true;
+    size_t start = 0;
+    while (start < output.size()) {
+        size_t end = output.find('\n', start);
+        if (end == std::string::npos) {
+            wellFormed = false;
+            break;
+        }
+        std::string line = output.substr(start, end - start);
+        start = end + 1;
+        if (line.compare(0, 9, "[console:") == 0) {
+            continue;
+        }
+        int p;
+        int i;
+        char payload[16];
+        if (line.size() < 13 || sscanf(line.c_str() + 13, "I P%d %d %15s", &p, &i, payload) != 3
+            || p < 0 || p >= producers || strcmp(payload, "payload") != 0) {
+            wellFormed = false;
+            continue;
+        }
+        ordered = ordered && i >= next[p];
+        next[p] = i + 1;
+        lines++;
+    }
+    CHECK(wellFormed);
+    CHECK(ordered);
+    CHECK_EQ(lines, testLog.printed() - printedBefore);
+    CHECK_EQ((testLog.printed() - printedBefore) + (testLog.dropped() - droppedBefore), producers * perProducer);
+}
+
+
+static void testRings() {
+    testRxRing();
+    testConsoleLog();
+}
+
+
+//MARK: Journal
+static journal_memory journalMemory;        // RTC memory on the target
+static journal_memory storageJournalMemory; // Behind sampleJournal, which writeLogRecord() and syncLogFile() use
+
+
+static void testJournal() {
+    memset((void *)&journalMemory, 0xA5, sizeof(journalMemory));   // Power-on garbage
+    SampleJournal journal;
+    CHECK_EQ(journal.begin(&journalMemory), 0);
+    CHECK_EQ(journal.used(), 0);
+
+    uint32_t seqs[5];
+    for (int i = 0; i < 5; i++) {
+        seqs[i] = journal.append(makeRecord(i + 1, i == 2 ? 0 : 3, 20.0f + i));
+        CHECK(seqs[i] != 0);
+    }
+    journal.release(seqs[1]);               // The first two are on the card
+
+    // Reset: a new journal on the same memory replays the other three, in order
+    SampleJournal afterReset;
+    CHECK_EQ(afterReset.begin(&journalMemory), 3);
+    uint32_t position = afterReset.start();
+    log_record record;
+    int replayed = 0;
+    while (afterReset.next(&position, &record)) {
+        int i = replayed + 2;
+        CHECK_EQ(record.servantID, i + 1);
+        CHECK_EQ(record.journalSeq, seqs[i]);
+        CHECK_EQ(record.epoch, TEST_EPOCH);
+        CHECK_EQ(record.data.count, i == 2 ? 0 : 3);
+        if (record.data.count == 3) {
+            CHECK(record.data.sens[2] == 22.0f + i);
+        }
+        replayed++;
+    }
+    CHECK_EQ(replayed, 3);
+
+    // A damaged entry ends the replay there; discard() drops it and what follows
+    afterReset.release(seqs[4]);
+    uint32_t damaged = afterReset.append(makeRecord(7, 3, 1.0f));
+    afterReset.append(makeRecord(8, 3, 1.0f));
+    CHECK(damaged != 0);
+    journalMemory.data[(journalMemory.tail.load() + 12) % JOURNAL_SIZE] ^= 0x10;
+    SampleJournal afterDamage;
+    afterDamage.begin(&journalMemory);
+    position = afterDamage.start();
+    CHECK(!afterDamage.next(&position, &record));
+    afterDamage.discard();
+    CHECK_EQ(afterDamage.used(), 0);
+
+    // Full: records that don't fit are counted, not journaled
+    uint32_t overflowsBefore = afterDamage.overflows();
+    int appended = 0;
+    while (afterDamage.append(makeRecord(1, 9, 1.0f)) != 0 && appended < 1000) {
+        appended++;
+    }
+    CHECK(appended > 0 && appended < 1000);
+    CHECK_EQ(afterDamage.overflows(), overflowsBefore + 1);
+}
+
+
+//MARK: Segments
+static void testSegments(const std::string &dir) {
+    removeHostDir(dir + LOG_DIR);
+    beginHal(dir.c_str());
+
+    LogSegments segments;
+    CHECK(segments.begin(".csv"));
+    CHECK(!segments.hasCurrent());
+    CHECK(segments.add(TEST_EPOCH));
+    CHECK_STR(std::string(segments.segment().path), "/log/20250730-001.csv");
+    HalFile file;
+    CHECK(file.open(segments.segment().path, HAL_FILE_UPDATE));
+    file.close();
+    segments.noteRecord(TEST_EPOCH);
+    segments.noteRecord(TEST_EPOCH + 60);
+    CHECK(segments.update(1234));
+
+    // Reboot: the last row of the manifest becomes the current segment again
+    LogSegments afterReboot;
+    CHECK(afterReboot.begin(".csv"));
+    CHECK(afterReboot.hasCurrent());
+    CHECK_STR(std::string(afterReboot.segment().path), "/log/20250730-001.csv");
+    CHECK_EQ(afterReboot.segment().bytes, 1234);
+    CHECK_EQ(afterReboot.segment().firstEpoch, TEST_EPOCH);
+    CHECK_EQ(afterReboot.segment().lastEpoch, TEST_EPOCH + 60);
+    CHECK(!afterReboot.needsNew(TEST_EPOCH + 120, 1234, 100));
+    CHECK(afterReboot.needsNew(TEST_EPOCH + 86400, 1234, 100));
+    CHECK(afterReboot.needsNew(TEST_EPOCH + 120, LOG_SEGMENT_SIZE - 50, 100));
+
+    // A row cut short by a power loss is ignored, and the next segment overwrites it
+    std::string manifestPath = dir + LOG_MANIFEST_FILENAME;
+    long rowsSize = hostFileSize(manifestPath);
+    FILE *manifest = fopen(manifestPath.c_str(), "ab");
+    fputs("0002,/log/2025", manifest);
+    fclose(manifest);
+    LogSegments afterPowerLoss;
+    CHECK(afterPowerLoss.begin(".csv"));
+    CHECK_EQ(afterPowerLoss.segment().number, 1);
+    CHECK(afterPowerLoss.add(TEST_EPOCH + 3600));
+    CHECK_STR(std::string(afterPowerLoss.segment().path), "/log/20250730-002.csv");
+    CHECK_EQ(hostFileSize(manifestPath), rowsSize * 2 - (long)strlen("segment,file,first_epoch,last_epoch,bytes\n"));
+
+    // The other format, or the segment's file gone: no current segment
+    LogSegments binary;
+    CHECK(binary.begin(".bin"));
+    CHECK(!binary.hasCurrent());
+    LogSegments fileGone;
+    CHECK(fileGone.begin(".csv"));
+    CHECK(!fileGone.hasCurrent());          // 20250730-002.csv was never created
+}
+
+
+//MARK: Format
+static void testFormat(const std::string &dir) {
+    CHECK_STR(fixed2(23.5f), "23.50");
+    CHECK_STR(fixed2(-999.0f), "-999.00");
+    CHECK_STR(fixed2(0.0f), "0.00");
+    CHECK_STR(fixed2(0.125f), "0.13");      // Exact tie: dtostrf rounds up, printf would round to even
+    CHECK_STR(fixed2(1.005f), "1.00");      // 1.00499999 as a float
+    CHECK_STR(fixed2(-12.345f), "-12.35");
+    CHECK_STR(fixed2(99.995f), "100.00");
+    CHECK_STR(fixed2(-0.004f), "-0.00");
+    CHECK_STR(fixed2(NAN), "nan");
+    CHECK_STR(fixed2(INFINITY), "inf");
+    CHECK_STR(fixed2(-INFINITY), "inf");
+
+    char row[RECORD_BUFFER_SIZE];
+    float readings[2] = {21.25f, NAN};
+    CHECK(formatTempRecord(row, sizeof(row), TEST_TIMESTAMP, 4, readings, 2) > 0);
+    CHECK_STR(std::string(row), TEST_TIMESTAMP ",4,1,21.25\n" TEST_TIMESTAMP ",4,2,nan\n");
+    CHECK_EQ(formatTempRecord(row, sizeof(row), TEST_TIMESTAMP, 4, readings, 0), 0);
+    CHECK(formatNanRecord(row, sizeof(row), TEST_TIMESTAMP, 4) > 0);
+    CHECK_STR(std::string(row), TEST_TIMESTAMP ",4,123456789,NAN\n");
+
+    // A reply without readings and a servant that didn't answer are both logged as the NAN row
+    beginHal(dir.c_str());
+    unlink((dir + "/nan.csv").c_str());
+    CHECK(openLogFile("/nan.csv", false, TEST_EPOCH));
+    writeLogRecord(makeRecord(5, 0, 0.0f));
+    CHECK(syncLogFile());
+    CHECK_STR(lastLine(readHostFile(dir + "/nan.csv")), TEST_TIMESTAMP ",5,123456789,NAN");
+    log_record missing = makeRecord(6, 0, 0.0f);
+    missing.valid = false;
+    writeLogRecord(missing);
+    writeLogRecord(makeRecord(7, 1, 19.5f));
+    CHECK(closeLogFile());
+    std::string text = readHostFile(dir + "/nan.csv");
+    CHECK(text.find(TEST_TIMESTAMP ",6,123456789,NAN\n" TEST_TIMESTAMP ",7,1,19.50\n") != std::string::npos);
+}
+
+
+//MARK: SD logger
+static void testShortWrites(const std::string &dir, uint32_t capacity) {
+    // The card takes only part of a write now and then; the rest must follow, nothing twice
+    beginHal(dir.c_str());
+    unlink((dir + "/short.csv").c_str());
+    SdLogger logger;
+    CHECK(logger.begin("/short.csv", "h\n", 2, capacity));
+    char line[16];
+    for (int i = 0; i < 2000; i++) {
+        int len = snprintf(line, sizeof(line), "%05d\n", i);
+        logger.append(line, len);
+        if (i % 250 == 249) {
+            // The card takes 700 more bytes, then fails the write; the next sync reopens it
+            halNativeLimitWrites(700);
+            logger.sync();
+            halNativeLimitWrites(-1);
+            halDelay(SD_RETRY_INTERVAL_MS);
+        }
+    }
+    CHECK(logger.end());
+    CHECK(logger.stats().failures > 0);
+
+    std::string expected = "h\n";
+    for (int i = 0; i < 2000; i++) {
+        snprintf(line, sizeof(line), "%05d\n", i);
+        expected += line;
+    }
+    std::string text = readHostFile(dir + "/short.csv");
+    CHECK_EQ(text.size(), expected.size());
+    CHECK(text == expected);
+}
+
+
+static void testTrimRetry(const std::string &dir) {
+    beginHal(dir.c_str());
+    unlink((dir + "/trim.csv").c_str());
+    std::string hostPath = dir + "/trim.csv";
+    SdLogger logger;
+    CHECK(logger.begin("/trim.csv", "h\n", 2, 1 << 20));
+    CHECK_EQ(hostFileSize(hostPath), 1 << 20);
+    for (int i = 0; i < 100; i++) {
+        logger.append("0123456789abcdef\n", 17);
+    }
+    CHECK(logger.sync());
+
+    // The cut fails with the card out: ended, but the trim stays pending
+    halNativeSetCardPresent(false);
+    CHECK(!logger.end());
+    CHECK(logger.isEnded());
+    CHECK(logger.needsTrim());
+    halNativeSetCardPresent(true);
+    CHECK(!logger.end());                   // Not before SD_RETRY_INTERVAL_MS
+    halDelay(SD_RETRY_INTERVAL_MS);
+    CHECK(logger.end());
+    CHECK(!logger.needsTrim());
+    CHECK_EQ(hostFileSize(hostPath), 2 + 100 * 17);
+
+    // Resumed: allocated again, the data kept
+    CHECK(logger.resume());
+    CHECK_EQ(hostFileSize(hostPath), 1 << 20);
+    logger.append("x\n", 2);
+    CHECK(logger.end());
+    CHECK_EQ(hostFileSize(hostPath), 2 + 100 * 17 + 2);
+}
+
+
+static void testSdLogger(const std::string &dir) {
+    testShortWrites(dir, 0);
+    testShortWrites(dir, 1 << 20);
+    testTrimRetry(dir);
+}
+
+
+//MARK: RTT
+static void testRtt() {
+    RttEstimator rtt;
+    CHECK_EQ(rtt.timeoutMs(0, 1000), 1000);                 // Nothing measured: sendTimeout
+
+    // SRTT + 4 RTTVAR, at least RTT_GRANULARITY_MS over SRTT and RTT_MIN_TIMEOUT_MS in all
+    rtt.sample(0, 100000);
+    CHECK_EQ(rtt.srttUs(0), 100000);
+    CHECK_EQ(rtt.rttvarUs(0), 50000);
+    CHECK_EQ(rtt.timeoutMs(0, 1000), 300);
+    rtt.sample(0, 100000);
+    CHECK_EQ(rtt.srttUs(0), 100000);
+    CHECK_EQ(rtt.rttvarUs(0), 37500);
+    CHECK_EQ(rtt.timeoutMs(0, 1000), 250);
+
+    RttEstimator fast;
+    fast.sample(1, 1000);
+    CHECK_EQ(fast.timeoutMs(1, 1000), RTT_MIN_TIMEOUT_MS);
+    fast.sample(1, 0);                                      // Never 0, that means unmeasured
+    CHECK(fast.srttUs(1) > 0);
+
+    // Each timeout doubles it, up to RTT_MAX_BACKOFF times and never beyond sendTimeout
+    rtt.timedOut(0);
+    CHECK_EQ(rtt.timeoutMs(0, 1000), 500);
+    rtt.timedOut(0);
+    CHECK_EQ(rtt.timeoutMs(0, 1000), 1000);
+    CHECK_EQ(rtt.timeoutMs(0, 100000), 1000);
+    for (int i = 0; i < 10; i++) {
+        rtt.timedOut(0);
+    }
+    CHECK_EQ(rtt.timeoutMs(0, 100000), 250 << RTT_MAX_BACKOFF);
+    rtt.sample(0, 100000);                                  // A measured reply ends the backoff
+    CHECK(rtt.timeoutMs(0, 1000) < 300);
+
+    // OnDataSent: a failed report for the request frame, or a later one, fails the request
+    RttEstimator reports;
+    reports.sent(2, true, 0);
+    CHECK(!reports.requestFailed(2));
+    reports.acknowledged(2, true);
+    CHECK(!reports.requestFailed(2));
+    reports.sent(2, true, 1000);
+    reports.sent(2, false, 1001);
+    reports.acknowledged(2, true);
+    reports.acknowledged(2, false);
+    CHECK(reports.requestFailed(2));
+
+    // A report that never came shifts the count only until the next request after RTT_REPORT_WINDOW_MS
+    reports.sent(2, false, 2000);                           // Its report is lost
+    reports.sent(2, true, 2000 + RTT_REPORT_WINDOW_MS);
+    CHECK(!reports.requestFailed(2));
+    reports.acknowledged(2, false);
+    CHECK(reports.requestFailed(2));
+    reports.sent(2, true, 3000);
+    reports.acknowledged(2, true);
+    CHECK(!reports.requestFailed(2));
+
+    // A frame the radio refused gets no report
+    reports.sent(2, true, 4000);
+    reports.notSent(2);
+    reports.sent(2, true, 4001);
+    reports.acknowledged(2, false);
+    CHECK(reports.requestFailed(2));
+}
+
+
+//MARK: Timebase
+static void runTimebase(Timebase &clock, uint32_t seconds, int64_t *maxErrorUs) {
+    *maxErrorUs = 0;
+    uint64_t endMs = halUptimeUs() / 1000 + (uint64_t)seconds * 1000;
+    while (halUptimeUs() / 1000 < endMs) {
+        clock.poll();
+        int64_t errorUs = (int64_t)clock.nowMs() * 1000 - (int64_t)halNativeRtcUnixUs();
+        if (llabs(errorUs) > *maxErrorUs) {
+            *maxErrorUs = llabs(errorUs);
+        }
+        halDelay(10);
+    }
+}
+
+
+static void testTimebase() {
+    hal_native_config config = {};
+    config.startEpoch = TEST_EPOCH;
+    config.seed = 1;
+    config.rtcDriftPpm = 50;
+    config.rtcSquareWave = true;
+    halNativeBegin(config);
+    halNativeSetQuiet(true);
+
+    // SQW: one read per anchor, the drift measured from the second TIMEBASE_DRIFT_MIN_MS baseline on
+    Timebase squareWave;
+    CHECK(squareWave.begin(true));
+    int64_t maxErrorUs;
+    runTimebase(squareWave, TIMEBASE_DRIFT_MIN_MS / 1000 + TIMEBASE_ANCHOR_MS / 1000 * 2, &maxErrorUs);
+    const timebase_stats &edges = squareWave.stats();
+    CHECK(edges.squareWave);
+    CHECK_EQ(edges.rtcReads, edges.anchors);
+    CHECK_EQ(edges.steps, 0);
+    CHECK(llabs(edges.driftPpb - 50000) <= 100);
+    runTimebase(squareWave, TIMEBASE_ANCHOR_MS / 1000 * 3, &maxErrorUs);
+    CHECK(maxErrorUs <= 1000);                              // nowMs() truncates to the millisecond
+
+    // No SQW: the boot search, then exactly two reads per renewal; the error stays within the edge range
+    config.rtcSquareWave = false;
+    for (int drift = -50; drift <= 50; drift += 50) {
+        config.rtcDriftPpm = drift;
+        halNativeBegin(config);
+        halNativeSetQuiet(true);
+        Timebase bracketing;
+        CHECK(bracketing.begin(false));
+        uint32_t readsAtBoot = bracketing.stats().rtcReads;
+        uint32_t anchorsAtBoot = bracketing.stats().anchors;
+        runTimebase(bracketing, 3600 + TIMEBASE_ANCHOR_MS / 2000, &maxErrorUs);
+        const timebase_stats &reads = bracketing.stats();
+        CHECK(!reads.squareWave);
+        CHECK_EQ(anchorsAtBoot, 1);
+        // A renewal falls due every TIMEBASE_ANCHOR_MS and takes the next edge whose range is still ahead
+        CHECK(reads.anchors - anchorsAtBoot >= 3600 * 1000 / (TIMEBASE_ANCHOR_MS + 2000));
+        CHECK_EQ(reads.rtcReads - readsAtBoot, 2 * (reads.anchors - anchorsAtBoot));
+        CHECK_EQ(reads.steps, 0);
+        CHECK(maxErrorUs < TIMEBASE_SEARCH_GAP_US);
+    }
+
+    // Set by the time sync: anchored again, without counting a step
+    halNativeBegin(config);
+    halNativeSetQuiet(true);
+    Timebase invalidated;
+    CHECK(invalidated.begin(false));
+    halRtcSetEpoch(TEST_EPOCH + 86400);
+    invalidated.invalidate();
+    runTimebase(invalidated, 3, &maxErrorUs);
+    CHECK_EQ(invalidated.stats().steps, 0);
+    CHECK_EQ(invalidated.epoch(), halRtcEpoch());
+}
+
+
+//MARK: Main
+static void usage(const char *program) {
+    fprintf(stderr, "Usage: %s [--dir DIR] [--suite tracker|rings|journal|segments|format|sdlogger|rtt|timebase]\n",
+            program);
+}
+
+
+int main(int argc, char **argv) {
+    const char *dir = "test_sd";
+    const char *suite = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        const char *option = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (value == NULL) {
+            usage(argv[0]);
+            return 2;
+        }
+        i++;
+        if (strcmp(option, "--dir") == 0) {
+            dir = value;
+        } else if (strcmp(option, "--suite") == 0) {
+            suite = value;
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    mkdir(dir, 0755);
+    beginHal(dir);
+    sampleJournal.begin(&storageJournalMemory);
+
+    static const struct {
+        const char *name;
+        void (*run)(const std::string &dir);
+    } suites[] = {
+        {"tracker", [](const std::string &) { testTracker(); }},
+        {"rings", [](const std::string &) { testRings(); }},
+        {"journal", [](const std::string &) { testJournal(); }},
+        {"segments", testSegments},
+        {"format", testFormat},
+        {"sdlogger", testSdLogger},
+        {"rtt", [](const std::string &) { testRtt(); }},
+        {"timebase", [](const std::string &) { testTimebase(); }},
+    };
+    bool found = false;
+    for (size_t i = 0; i < sizeof(suites) / sizeof(suites[0]); i++) {
+        if (suite != NULL && strcmp(suite, suites[i].name) != 0) {
+            continue;
+        }
+        found = true;
+        int failuresBefore = failures;
+        int checksBefore = checks;
+        printf("%s\n", suites[i].name);
+        suites[i].run(dir);
+        printf("  %d checks, %d failed\n", checks - checksBefore, failures - failuresBefore);
+    }
+    if (!found) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    printf("\n%d checks, %d failed\n", checks, failures);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,191 @@
+/*
+ * binlog2csv - TX Passive Thermal GCT host tool
+ *
+ * Converts binary master logs (/data_master.bin or the .bin segments in /log,
+ * see include/binlog_format.h) into the CSV format written by the master in
+ * text mode:
+ *
+ *   timestamp,target_no,sensor_no,temperature
+ *   2025-07-29 14:30:15,1,1,23.50
+ *   2025-07-29 14:30:15,3,123456789,NAN
+ *
+ * Build (from the repository root):
+ *   g++ -std=c++17 -O2 -Iinclude -o binlog2csv tools/binlog2csv/binlog2csv.cpp src/record_format.cpp
+ *
+ * Usage:
+ *   binlog2csv data_master.bin [more.bin ...] > data_master.csv
+ *   binlog2csv -o data_master.csv data_master.bin
+ *
+ * Several input files are concatenated under a single CSV header. A segment
+ * listed in a manifest.csv next to it is read up to its recorded length; the
+ * open segment is pre-allocated and holds no records after that.
+ */
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "binlog_format.h"
+#include "record_format.h"
+
+#define CSV_HEADER              "timestamp,target_no,sensor_no,temperature"
+
+
+// Data length of a segment from the manifest.csv in its directory (see log_segments.h), -1 if not listed
+static long manifestLength(const char *path) {
+    const char *slash = strrchr(path, '/');
+    std::string directory = slash != NULL ? std::string(path, slash + 1 - path) : std::string();
+    const char *name = slash != NULL ? slash + 1 : path;
+
+    FILE *manifest = fopen((directory + "manifest.csv").c_str(), "r");
+    if (manifest == NULL) {
+        return -1;
+    }
+    long length = -1;
+    char line[128];
+    while (fgets(line, sizeof(line), manifest) != NULL) {
+        unsigned number;
+        char file[64];
+        unsigned long firstEpoch, lastEpoch, bytes;
+        if (sscanf(line, "%u,%63[^,],%lu,%lu,%lu", &number, file, &firstEpoch, &lastEpoch, &bytes) == 5) {
+            const char *listed = strrchr(file, '/');
+            if (strcmp(listed != NULL ? listed + 1 : file, name) == 0) {
+                length = (long)bytes;
+            }
+        }
+    }
+    fclose(manifest);
+    return length;
+}
+
+
+static bool convertFile(const char *path, FILE *out, unsigned long *records) {
+    FILE *in = fopen(path, "rb");
+    if (in == NULL) {
+        fprintf(stderr, "%s: cannot open file\n", path);
+        return false;
+    }
+
+    binlog_header header;
+    if (fread(&header, 1, sizeof(header), in) != sizeof(header)
+        || memcmp(header.magic, BINLOG_MAGIC, sizeof(header.magic)) != 0) {
+        fprintf(stderr, "%s: not a binary GCT log (bad magic)\n", path);
+        fclose(in);
+        return false;
+    }
+    // Version 1: fixed records with header.sensorCount readings; version 2: fixed part + own count
+    size_t fixedSize = header.version == 1 ? offsetof(binlog_record_v1, readings) : sizeof(binlog_record);
+    if ((header.version != 1 && header.version != BINLOG_VERSION) || header.valueType != BINLOG_VALUE_FLOAT32
+        || header.headerSize < sizeof(binlog_header)
+        || header.recordSize < fixedSize + (header.version == 1 ? header.sensorCount * sizeof(float) : 0)) {
+        fprintf(stderr, "%s: unsupported layout (version %u, value type %u, record %u bytes, %u sensors)\n",
+                path, header.version, header.valueType, header.recordSize, header.sensorCount);
+        fclose(in);
+        return false;
+    }
+
+    // Skip header fields added by newer writers
+    fseek(in, header.headerSize, SEEK_SET);
+    long length = manifestLength(path);
+
+    std::vector<uint8_t> raw(header.recordSize);
+    std::vector<float> readings(header.sensorCount);
+    std::vector<char> text(96 * (header.sensorCount + 1));     // One CSV row per sensor
+    char timestamp[RECORD_TIMESTAMP_SIZE];
+
+    for (;;) {
+        if (length >= 0 && ftell(in) >= length) {
+            break;                          // End of the data of a segment
+        }
+        size_t got = fread(raw.data(), 1, raw.size(), in);
+        if (got == 0) {
+            break;
+        }
+        if (got < raw.size()) {
+            // A power cut can leave a partial record at the end of the file
+            fprintf(stderr, "%s: ignoring truncated record at end of file (%zu of %u bytes)\n",
+                    path, got, header.recordSize);
+            break;
+        }
+
+        binlog_record record = {};
+        memcpy(&record, raw.data(), offsetof(binlog_record_v1, readings));     // Fields common to both versions
+        int count;
+        if (header.version == 1) {
+            count = header.sensorCount;
+            memcpy(readings.data(), raw.data() + fixedSize, count * sizeof(float));
+        } else {
+            record.sensorCount = raw[offsetof(binlog_record, sensorCount)];
+            count = record.sensorCount;
+            if (count > header.sensorCount) {
+                fprintf(stderr, "%s: corrupt record (%d readings, at most %u), stopping\n", path, count, header.sensorCount);
+                break;
+            }
+            got = fread(readings.data(), 1, count * sizeof(float), in);
+            if (got < count * sizeof(float)) {
+                fprintf(stderr, "%s: ignoring truncated record at end of file (%zu of %zu reading bytes)\n",
+                        path, got, count * sizeof(float));
+                break;
+            }
+        }
+        formatTimestamp(timestamp, sizeof(timestamp), record.epoch,
+                        (record.flags & BINLOG_FLAG_HAS_MILLIS) ? record.millis : -1);
+
+        // Same formatter as the firmware's CSV mode, so both paths produce identical text
+        if (record.flags & BINLOG_FLAG_NO_DATA) {
+            formatNanRecord(text.data(), text.size(), timestamp, record.servantID);
+        } else {
+            formatTempRecord(text.data(), text.size(), timestamp, record.servantID, readings.data(), count);
+        }
+        fputs(text.data(), out);
+        (*records)++;
+    }
+
+    fclose(in);
+    return true;
+}
+
+
+int main(int argc, char **argv) {
+    const char *outputPath = NULL;
+    std::vector<const char *> inputs;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            outputPath = argv[++i];
+        } else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+            inputs.clear();
+            break;
+        } else {
+            inputs.push_back(argv[i]);
+        }
+    }
+
+    if (inputs.empty()) {
+        fprintf(stderr, "Usage: %s [-o output.csv] input.bin [more.bin ...]\n", argv[0]);
+        return 2;
+    }
+
+    FILE *out = stdout;
+    if (outputPath != NULL && (out = fopen(outputPath, "w")) == NULL) {
+        fprintf(stderr, "%s: cannot create file\n", outputPath);
+        return 1;
+    }
+
+    fprintf(out, "%s\n", CSV_HEADER);
+
+    bool ok = true;
+    unsigned long records = 0;
+    for (const char *path : inputs) {
+        ok = convertFile(path, out, &records) && ok;
+    }
+
+    if (out != stdout) {
+        fclose(out);
+    }
+    fprintf(stderr, "Converted %lu records from %zu file(s)\n", records, inputs.size());
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,129 @@
+/*
+ * ntp_responder - TX Passive Thermal GCT host tool
+ *
+ * Minimal SNTP server for testing the master's background time sync
+ * (include/time_sync.h) on a bench network without internet access. It
+ * answers every valid client request with the host clock, optionally shifted,
+ * so a test can check how far the master moves its RTC.
+ *
+ * Build (from the repository root):
+ *   g++ -std=c++17 -O2 -Iinclude -o ntp_responder tools/ntp_responder/ntp_responder.cpp src/ntp_packet.cpp
+ *
+ * Usage:
+ *   ntp_responder [--port N] [--offset MS] [--stratum N] [--drop PERCENT]
+ *
+ *   --port N          UDP port [12300]; port 123 needs root. Point the master at it
+ *                     with NTP_SERVER "<host address>" in config.h and ntpPort = N
+ *                     in main.cpp
+ *   --offset MS       added to the host clock in every reply [0]
+ *   --stratum N       stratum of the replies [2]; 0 makes them kiss-o'-death
+ *                     replies, which the master must ignore
+ *   --drop PERCENT    ignore this share of the requests, to exercise the retries [0]
+ *
+ * Each request is logged on stderr with the client address and the time sent.
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "ntp_packet.h"
+
+#define DEFAULT_PORT            12300
+
+
+static uint64_t hostUnixMs() {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return (uint64_t)now.tv_sec * 1000 + now.tv_usec / 1000;
+}
+
+
+int main(int argc, char **argv) {
+    int port = DEFAULT_PORT;
+    long offsetMs = 0;
+    int stratum = 2;
+    int dropPercent = 0;
+
+    for (int i = 1; i < argc; i++) {
+        const char *option = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (value != NULL && strcmp(option, "--port") == 0) {
+            port = atoi(value);
+        } else if (value != NULL && strcmp(option, "--offset") == 0) {
+            offsetMs = atol(value);
+        } else if (value != NULL && strcmp(option, "--stratum") == 0) {
+            stratum = atoi(value);
+        } else if (value != NULL && strcmp(option, "--drop") == 0) {
+            dropPercent = atoi(value);
+        } else {
+            fprintf(stderr, "Usage: %s [--port N] [--offset MS] [--stratum N] [--drop PERCENT]\n", argv[0]);
+            return 2;
+        }
+        i++;
+    }
+    if (port <= 0 || port > 65535 || stratum < 0 || stratum > 15) {
+        fprintf(stderr, "%s: port must be 1..65535, stratum 0..15\n", argv[0]);
+        return 2;
+    }
+
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons((uint16_t)port);
+    if (sock < 0 || bind(sock, (struct sockaddr *)&address, sizeof(address)) != 0) {
+        perror("ntp_responder: bind");
+        return 1;
+    }
+    fprintf(stderr, "Answering NTP requests on UDP port %d (offset %+ld ms, stratum %d, drop %d%%)\n", port,
+            offsetMs, stratum, dropPercent);
+    srand((unsigned)time(NULL));
+
+    for (;;) {
+        uint8_t packet[NTP_PACKET_SIZE + 16];
+        struct sockaddr_in client;
+        socklen_t clientLen = sizeof(client);
+        ssize_t len = recvfrom(sock, packet, sizeof(packet), 0, (struct sockaddr *)&client, &clientLen);
+        if (len < 0) {
+            perror("ntp_responder: recvfrom");
+            continue;
+        }
+        ntp_timestamp receive = ntpFromUnixMs(hostUnixMs() + offsetMs);
+
+        char clientName[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &client.sin_addr, clientName, sizeof(clientName));
+        ntp_timestamp origin;
+        if (!ntpParseRequest(packet, (size_t)len, &origin)) {
+            fprintf(stderr, "%s: not an NTP client request (%zd bytes), ignored\n", clientName, len);
+            continue;
+        }
+        if (rand() % 100 < dropPercent) {
+            fprintf(stderr, "%s: request dropped\n", clientName);
+            continue;
+        }
+
+        uint64_t transmitMs = hostUnixMs() + offsetMs;
+        uint8_t reply[NTP_PACKET_SIZE];
+        ntpBuildReply(reply, origin, receive, ntpFromUnixMs(transmitMs), (uint8_t)stratum);
+        if (sendto(sock, reply, sizeof(reply), 0, (struct sockaddr *)&client, clientLen) != sizeof(reply)) {
+            perror("ntp_responder: sendto");
+            continue;
+        }
+
+        time_t seconds = (time_t)(transmitMs / 1000);
+        struct tm fields;
+        char text[32];
+        gmtime_r(&seconds, &fields);
+        strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S", &fields);
+        fprintf(stderr, "%s: answered with %s.%03u UTC\n", clientName, text, (unsigned)(transmitMs % 1000));
+    }
+}